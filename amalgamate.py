@@ -3,8 +3,8 @@ with open("src/opcodes.h", "rt", encoding='utf-8') as f:
 
 pipeline = [
 	["hash_table8.hpp", "__stl__.h", "memory.h", "str.h", "safestl.h", "builtins.h", "error.h"],
-	["obj.h", "iter.h", "parser.h", "pointer.h", "codeobject.h"],
-	["vm.h", "compiler.h", "repl.h"],
+	["obj.h", "iter.h", "parser.h", "pointer.h", "codeobject.h", "optimizer.h"],
+	["vm.h", "gc.h", "jit.h", "regvm.h", "aot.h", "compiler.h", "repl.h"],
 	["pocketpy.h"]
 ]
 
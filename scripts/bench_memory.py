@@ -0,0 +1,57 @@
+import os
+import sys
+import subprocess
+import tempfile
+
+# measures the peak memory of scripts that keep many small objects alive
+# usage: python3 scripts/bench_memory.py [git-ref], from the root of the repo
+# with a git ref, the same scripts also run on a build of that revision for comparison
+
+FLAGS = "--std=c++17 -O1 -pthread -fno-rtti"
+N = 300000
+
+WORKLOADS = {
+    "empty": "",
+    "boxed ints": f"a = [2 ** 62 + i for i in range({N})]",
+    "strings": f"a = [str(i) for i in range({N})]",
+    "tuples": f"a = [(i, i) for i in range({N})]",
+    "lists": f"a = [[] for i in range({N})]",
+    "instances": f"""
+class P:
+    def __init__(self, x):
+        self.x = x
+a = [P(i) for i in range({N})]""",
+}
+
+def build(binary, srcdir="."):
+    assert os.system(f"g++ -o {binary} {srcdir}/src/main.cpp {FLAGS}") == 0
+
+def build_ref(binary, ref):
+    with tempfile.TemporaryDirectory() as d:
+        assert os.system(f"git archive {ref} src | tar -x -C {d}") == 0
+        build(binary, d)
+
+def peak_kb(binary, code):
+    with tempfile.NamedTemporaryFile("w", suffix=".py", delete=False) as f:
+        f.write(code)
+    p = subprocess.Popen([binary, f.name], stdout=subprocess.DEVNULL)
+    _, status, usage = os.wait4(p.pid, 0)
+    os.remove(f.name)
+    assert status == 0
+    return usage.ru_maxrss
+
+if __name__ == '__main__':
+    binaries = {"tree": "./pocketpy_mem"}
+    build(binaries["tree"])
+    if len(sys.argv) > 1:
+        binaries[sys.argv[1]] = "./pocketpy_mem_base"
+        build_ref(binaries[sys.argv[1]], sys.argv[1])
+    print(f"{'':<14}" + "".join(f"{name:>16}" for name in binaries) + f"{'bytes/object':>16}")
+    base = {name: peak_kb(b, WORKLOADS["empty"]) for name, b in binaries.items()}
+    for workload, code in WORKLOADS.items():
+        if workload == "empty": continue
+        row = {name: peak_kb(b, code) - base[name] for name, b in binaries.items()}
+        per_obj = " / ".join(f"{row[name] * 1024 // N}" for name in binaries)
+        print(f"{workload:<14}" + "".join(f"{row[name]:>13} KB" for name in binaries) + f"{per_obj:>16}")
+    for b in binaries.values():
+        os.remove(b)
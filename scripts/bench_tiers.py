@@ -0,0 +1,54 @@
+import os
+import subprocess
+import tempfile
+
+# compares the stack tier with the register tier (PKPY_REGISTER_TIER) by bytecodes run and wall time
+# usage: python3 scripts/bench_tiers.py, from the root of the repo
+
+FLAGS = "--std=c++17 -O1 -pthread -fno-rtti -DPKPY_COUNT_INSTRUCTIONS"
+BINARIES = {
+    "stack": "./pocketpy_stack",
+    "register": "./pocketpy_register",
+}
+REPEAT = 5
+
+RANDOM_CODE = '''
+import random
+random.seed(7)
+s = 0
+for _ in range(20000):
+    s += random.randint(1, 100)
+L = list(range(1000))
+random.shuffle(L)
+'''
+
+def build():
+    for tier, binary in BINARIES.items():
+        extra = " -DPKPY_REGISTER_TIER" if tier == "register" else ""
+        assert os.system(f"g++ -o {binary} src/main.cpp {FLAGS}{extra}") == 0
+
+def run(binary, filepath):
+    best_time, count = None, None
+    for _ in range(REPEAT):
+        out = subprocess.run([binary, filepath], capture_output=True, text=True).stdout
+        for line in out.splitlines():
+            if line.startswith("Running time: "):
+                t = float(line.split()[2])
+                best_time = t if best_time is None else min(best_time, t)
+            elif line.startswith("Instructions: "):
+                count = int(line.split()[1])
+    return count, best_time
+
+if __name__ == '__main__':
+    build()
+    with tempfile.NamedTemporaryFile("w", suffix=".py", delete=False) as f:
+        f.write(RANDOM_CODE)
+    targets = [("tests/_prime.py", "tests/_prime.py"), ("tests/dna.py", "tests/dna.py"), ("random", f.name)]
+    print(f"{'':<18}{'stack ops':>12}{'reg ops':>12}{'ratio':>8}{'stack s':>12}{'reg s':>12}{'speedup':>9}")
+    for name, path in targets:
+        c0, t0 = run(BINARIES["stack"], path)
+        c1, t1 = run(BINARIES["register"], path)
+        print(f"{name:<18}{c0:>12}{c1:>12}{c1/c0:>8.2f}{t0:>12.6f}{t1:>12.6f}{t0/t1:>9.2f}")
+    os.remove(f.name)
+    for binary in BINARIES.values():
+        os.remove(binary)
@@ -20,10 +20,22 @@
 #include <queue>
 #include <iomanip>
 #include <memory>
+#include <map>
+#include <set>
+#include <unordered_set>
 
 #include <atomic>
+#include <mutex>
 #include <iostream>
 
+namespace pkpy {
+    // malloc() and free() for the contents of strs, lists and dicts, counted by the arena
+    // of the VM they are made in, see memory.h
+    inline void* __charged_alloc(size_t size, bool strict);
+    inline void __charged_free(void* p);
+};
+#define EMH_MALLOC(n) pkpy::__charged_alloc(n, false)
+#define EMH_FREE(p) pkpy::__charged_free(p)
 #include "hash_table8.hpp"
 
 #ifdef POCKETPY_H
@@ -38,6 +50,26 @@
 #include <thread>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#define PKPY_SSE2                   // the ASCII scan of a new str, see `pkpy::__is_ascii`
+#include <emmintrin.h>
+#endif
+
 #define PK_VERSION "0.6.2"
 
-//#define PKPY_NO_INDEX_CHECK
\ No newline at end of file
+//#define PKPY_NO_INDEX_CHECK
+//#define PKPY_TYPED_LOCALS         // keep `int`/`float` annotated locals unboxed, see `TypedLocal`
+//#define PKPY_ENABLE_JIT           // x86-64 Linux only, see jit.h
+//#define PKPY_REGISTER_TIER        // see regvm.h
+//#define PKPY_COUNT_INSTRUCTIONS
+//#define PKPY_NO_POOL              // malloc() every object, see `pkpy::MemoryPool`
+
+#ifdef PKPY_ENABLE_JIT
+#if !defined(__x86_64__) || !defined(__linux__)
+#undef PKPY_ENABLE_JIT
+#endif
+#endif
+
+#ifndef PKPY_JIT_THRESHOLD
+#define PKPY_JIT_THRESHOLD 1000     // 0 compiles every code object on its first run
+#endif
@@ -0,0 +1,338 @@
+#pragma once
+
+#include "vm.h"
+
+// An ahead-of-time transpiler from pocketpy modules to C++.
+//
+// `pocketpy --aot <filename> <module>` prints a header which rebuilds the code objects of the module
+// without parsing and runs every one of them through a C++ function. Such a function is the
+// bytecode unrolled into calls of `VM::__aot_step<op>`, the interpreter specialized to one opcode,
+// and jumps with static targets are `goto`s. Frames and their value stacks keep their layout, so
+// tracebacks are the ones of the interpreter. After the module runs, its functions and the methods
+// of its classes are bound as native functions via `bindFunc` and `bindMethod`.
+//
+// Building with -DPKPY_AOT_MODULES='"modules.h"', a header including the generated ones, links
+// them into the executable, where `import <module>` loads the transpiled module.
+
+// modules of the generated headers, copied into each VM by `__vm_init`
+inline std::map<_Str, _AotLoader>& __aot_registry(){
+    static std::map<_Str, _AotLoader> modules;
+    return modules;
+}
+
+inline _Source __aot_source(const char* source, const char* filename){
+    _Source src = pkpy::make_shared<SourceMetadata>(source, filename, EXEC_MODE);
+    // the parser records line starts while lexing, nothing is lexed here
+    for(const char* p = src->source; *p != '\0'; p++){
+        if(*p == '\n') src->lineStarts.push_back(p + 1);
+    }
+    return src;
+}
+
+inline PyVar __aot_function(VM* vm, _Str name, _Code code, std::vector<_Str> args, _Str starredArg, std::vector<std::pair<_Str, PyVar>> kwArgs){
+    _Func fn = pkpy::make_shared<Function>();
+    fn->name = name;
+    fn->code = code;
+    for(const _Str& arg : args) fn->args.push_back(_Str::intern(arg));
+    if(!starredArg.empty()) fn->starredArg = _Str::intern(starredArg);
+    for(auto& [key, value] : kwArgs){
+        const _Str& symbol = _Str::intern(key);
+        fn->kwArgs[symbol] = value;
+        fn->kwArgsOrder.push_back(symbol);
+    }
+    return vm->PyFunction(fn);
+}
+
+template<int __op>
+PyVar VM::__aot_step(Frame* frame, int ip){
+    frame->jump_abs(ip);
+    PyVar ret = __run_frame<__op>(frame);
+    if(ret != __py2py_call_signal) return ret;
+    // the python callee runs to completion before the next step
+    frame->push(__exec_pushed(callstack.back().get()));
+    return nullptr;
+}
+
+// `key` names the python function behind a native one bound by `__aot_exec`
+PyVar VM::__aot_call(const _Str& key, const pkpy::ArgList& args){
+    const PyVar* obj = _aot_functions.try_get(key);
+    if(obj == nullptr) UNREACHABLE();
+    const _Func& fn = PyFunction_AS_C(*obj);
+    PyVarDict locals;
+    int i = 0;
+    for(const auto& name : fn->args){
+        if(i >= args.size()) typeError("missing positional argument '" + name + "'");
+        locals.emplace(name, args[i++]);
+    }
+    if(!fn->starredArg.empty()){
+        PyVarList vargs;
+        while(i < args.size()) vargs.push_back(args[i++]);
+        locals.emplace(fn->starredArg, PyTuple(std::move(vargs)));
+    }else if(i < args.size()){
+        typeError("too many arguments");
+    }
+    return _exec(fn->code, (*obj)->attribs[__module__], std::move(locals));
+}
+
+void VM::__aot_exec(const _Code& code, PyVar _module, const _AotNatives& natives){
+    // the code objects are rebuilt here instead of by `compile`, their constants are a module's too
+    immortalize_consts(code);
+    _exec(code, _module, {});
+
+    auto native_of = [&](const PyVar& obj) -> const std::pair<_Str, _CppFunc>* {
+        if(!obj->is_type(_tp_function)) return nullptr;
+        auto it = natives.find(PyFunction_AS_C(obj)->code.get());
+        return it == natives.end() ? nullptr : &it->second;
+    };
+
+    std::vector<std::pair<_Str, PyVar>> attrs(_module->attribs.begin(), _module->attribs.end());
+    for(auto& [name, obj] : attrs){
+        if(auto native = native_of(obj)){
+            _aot_functions[native->first] = obj;
+            bindFunc(_module, name, native->second);
+            continue;
+        }
+        if(!obj->is_type(_tp_type)) continue;
+        _Str typeName = UNION_NAME(_module) + "." + name;
+        PyVar* type = _userTypes.try_get(typeName);
+        if(type == nullptr || *type != obj) continue;       // not a class of this module
+        std::vector<std::pair<_Str, PyVar>> methods(obj->attribs.begin(), obj->attribs.end());
+        for(auto& [fname, fn] : methods){
+            if(auto native = native_of(fn)){
+                _aot_functions[native->first] = fn;
+                bindMethod(typeName, fname, native->second);
+            }
+        }
+    }
+}
+
+class AotTranspiler {
+    VM* vm;
+    _Str module;
+    _Str ns;                                    // `module` as a C++ identifier
+    std::vector<const CodeObject*> codes;       // preorder, the module comes first
+    std::map<const CodeObject*, _Func> funcs;   // the function of each code but the module
+    _StrStream out;
+
+    static _Str __literal(const std::string& s){
+        std::string r = "\"";
+        for(unsigned char c : s){
+            if(c == '"' || c == '\\'){ r += '\\'; r += c; }
+            else if(c == '\n') r += "\\n";
+            else if(c >= 32 && c < 127) r += c;
+            else{
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\%03o", c);
+                r += buf;
+            }
+        }
+        return r + "\"";
+    }
+
+    static _Str __str(const _Str& s){
+        if(s.find('\0') == std::string::npos) return "_Str(" + __literal(s) + ")";
+        return "_Str(" + __literal(s) + ", " + std::to_string(s.size()) + ")";
+    }
+
+    int __index_of(const CodeObject* co) const {
+        return std::find(codes.begin(), codes.end(), co) - codes.begin();
+    }
+
+    void __collect(const CodeObject* co){
+        if(!co->co_inlined.empty()) throw std::runtime_error("inlined calls can't be transpiled");
+        codes.push_back(co);
+        for(const PyVar& obj : co->co_consts){
+            if(!obj->is_type(vm->_tp_function)) continue;
+            const _Func& fn = vm->PyFunction_AS_C(obj);
+            funcs[fn->code.get()] = fn;
+            __collect(fn->code.get());
+        }
+    }
+
+    // native functions can't take keyword arguments, so functions with defaults stay python ones,
+    // and so do generator functions, which must not run when called
+    bool __is_native(const CodeObject* co) const {
+        auto it = funcs.find(co);
+        return it != funcs.end() && it->second->kwArgs.empty() && !co->co_generator;
+    }
+
+    _Str __constant(const PyVar& obj){
+        if(obj == vm->None) return "vm->None";
+        if(obj == vm->True) return "vm->True";
+        if(obj == vm->False) return "vm->False";
+        if(obj->is_type(vm->_tp_int)){
+            i64 v = vm->PyInt_AS_C(obj);
+            if(v == INT64_MIN) return "vm->PyInt(INT64_MIN)";
+            return "vm->PyInt(" + std::to_string(v) + ")";
+        }
+        if(obj->is_type(vm->_tp_float)){
+            f64 v = vm->PyFloat_AS_C(obj);
+            if(std::isnan(v)) return "vm->PyFloat(NAN)";
+            if(std::isinf(v)) return v > 0 ? "vm->PyFloat(INFINITY)" : "vm->PyFloat(-INFINITY)";
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%a", v);      // exact
+            return "vm->PyFloat(" + std::string(buf) + ")";
+        }
+        if(obj->is_type(vm->_tp_str)) return "vm->PyStr(" + __str(vm->PyStr_AS_C(obj)) + ")";
+        if(obj->is_type(vm->_tp_function)){
+            const _Func& fn = vm->PyFunction_AS_C(obj);
+            _StrStream ss;
+            ss << "__aot_function(vm, " << __str(fn->name) << ", __code_" << __index_of(fn->code.get()) << "(vm, src, natives), {";
+            for(int i=0; i<fn->args.size(); i++) ss << (i ? ", " : "") << __str(fn->args[i]);
+            ss << "}, " << __str(fn->starredArg) << ", {";
+            for(int i=0; i<fn->kwArgsOrder.size(); i++){
+                const _Str& key = fn->kwArgsOrder[i];
+                ss << (i ? ", " : "") << "{" << __str(key) << ", " << __constant(fn->kwArgs[key]) << "}";
+            }
+            ss << "})";
+            return ss.str();
+        }
+        throw std::runtime_error("can't transpile a constant of type '" + UNION_NAME(vm->_tp(obj)) + "'");
+    }
+
+    void __emit_body(int k){
+        const CodeObject* co = codes[k];
+        const std::vector<Bytecode>& code = co->co_code;
+        const int n = code.size();
+
+        bool dispatch = false;
+        std::set<int> labels;
+        for(int i=0; i<n; i++){
+            const Bytecode& byte = code[i];
+            switch(byte.op){
+                case OP_JUMP_ABSOLUTE: case OP_SAFE_JUMP_ABSOLUTE: case OP_POP_JUMP_IF_FALSE:
+                case OP_JUMP_IF_TRUE_OR_POP: case OP_JUMP_IF_FALSE_OR_POP: case OP_INLINE_RETURN:
+                    labels.insert(byte.arg); break;
+                case OP_FOR_ITER: case OP_LOOP_BREAK: labels.insert(co->co_blocks[byte.block].end); break;
+                case OP_LOOP_CONTINUE: labels.insert(co->co_blocks[byte.block].start); break;
+                case OP_GOTO: case OP_INLINE_CALL: dispatch = true; break;
+            }
+        }
+        if(dispatch) for(int i=0; i<=n; i++) labels.insert(i);
+
+        out << "static PyVar __body_" << k << "(VM* vm, Frame* frame){\n";
+        for(int i=0; i<n; i++){
+            const Bytecode& byte = code[i];
+            if(labels.count(i)) out << "__L" << i << ":\n";
+            _StrStream step;
+            step << "vm->__aot_step<OP_" << OP_NAMES[byte.op] << ">(frame, " << i << ")";
+            switch(byte.op){
+                case OP_NO_OP: break;
+                case OP_JUMP_ABSOLUTE: out << "    goto __L" << byte.arg << ";\n"; break;
+                case OP_LOOP_CONTINUE: out << "    goto __L" << co->co_blocks[byte.block].start << ";\n"; break;
+                // a resumed generator frame goes on in the interpreter, see `VM::run_frame`
+                case OP_RETURN_VALUE: case OP_YIELD_VALUE: out << "    return " << step.str() << ";\n"; break;
+                case OP_SAFE_JUMP_ABSOLUTE: case OP_INLINE_RETURN:
+                    out << "    " << step.str() << "; goto __L" << byte.arg << ";\n"; break;
+                case OP_LOOP_BREAK:
+                    out << "    " << step.str() << "; goto __L" << co->co_blocks[byte.block].end << ";\n"; break;
+                case OP_POP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE_OR_POP: case OP_JUMP_IF_FALSE_OR_POP:
+                    out << "    " << step.str() << "; if(frame->next_index() != " << i+1 << ") goto __L" << byte.arg << ";\n"; break;
+                case OP_FOR_ITER:
+                    out << "    " << step.str() << "; if(frame->next_index() != " << i+1 << ") goto __L" << co->co_blocks[byte.block].end << ";\n"; break;
+                case OP_GOTO: out << "    " << step.str() << "; goto __dispatch;\n"; break;
+                case OP_INLINE_CALL:
+                    out << "    " << step.str() << "; if(frame->next_index() != " << i+1 << ") goto __dispatch;\n"; break;
+                default: out << "    " << step.str() << ";\n"; break;
+            }
+        }
+        // the interpreter runs no bytecode at the end of the code and just returns
+        if(labels.count(n)) out << "__L" << n << ":\n";
+        out << "    return vm->__aot_step<-1>(frame, " << n << ");\n";
+        if(dispatch){
+            out << "__dispatch:\n    switch(frame->next_index()){\n";
+            for(int i=0; i<=n; i++) out << "        case " << i << ": goto __L" << i << ";\n";
+            out << "    }\n    UNREACHABLE();\n";
+        }
+        out << "}\n\n";
+    }
+
+    void __emit_builder(int k){
+        static const char* SCOPES[] = {"NAME_LOCAL", "NAME_GLOBAL", "NAME_ATTR"};
+        static const char* HINTS[] = {"HINT_NONE", "HINT_INT", "HINT_FLOAT"};
+        static const char* BLOCKS[] = {"NO_BLOCK", "FOR_LOOP", "WHILE_LOOP", "CONTEXT_MANAGER", "TRY_EXCEPT"};
+        const CodeObject* co = codes[k];
+
+        out << "static _Code __code_" << k << "(VM* vm, const _Source& src, _AotNatives& natives){\n";
+        out << "    _Code co = pkpy::make_shared<CodeObject>(src, " << __str(co->name) << ");\n";
+        out << "    co->co_code = {\n";
+        for(const Bytecode& byte : co->co_code){
+            out << "        {OP_" << OP_NAMES[byte.op] << ", " << byte.arg << ", " << byte.line << ", " << byte.block << "},\n";
+        }
+        out << "    };\n";
+        if(!co->co_consts.empty()){
+            out << "    co->co_consts = {\n";
+            for(const PyVar& obj : co->co_consts) out << "        " << __constant(obj) << ",\n";
+            out << "    };\n";
+        }
+        if(!co->co_names.empty()){
+            out << "    co->co_names = {\n";
+            for(auto& [name, scope] : co->co_names) out << "        {_Str::intern(" << __str(name) << "), " << SCOPES[scope] << "},\n";
+            out << "    };\n";
+        }
+        for(const _Str& name : co->co_global_names) out << "    co->co_global_names.push_back(" << __str(name) << ");\n";
+        for(auto& [name, hint] : co->co_typed_names) out << "    co->co_typed_names.push_back({" << __str(name) << ", " << HINTS[hint] << "});\n";
+        for(const HoistedLen& h : co->co_hoisted) out << "    co->co_hoisted.push_back({" << h.slot << ", " << h.fn << ", " << h.obj << "});\n";
+        out << "    co->co_blocks = {\n";
+        for(const CodeBlock& b : co->co_blocks){
+            out << "        {" << BLOCKS[b.type] << ", {";
+            for(int i=0; i<b.id.size(); i++) out << (i ? ", " : "") << b.id[i];
+            out << "}, " << b.parent << ", " << b.start << ", " << b.end << "},\n";
+        }
+        out << "    };\n";
+        for(auto& [label, index] : co->co_labels) out << "    co->co_labels[" << __str(label) << "] = " << index << ";\n";
+        if(co->co_generator) out << "    co->co_generator = true;\n";
+        out << "    co->co_aot = &__body_" << k << ";\n";
+        if(__is_native(co)) out << "    natives[co.get()] = {" << __str(module + "#" + std::to_string(k)) << ", &__fn_" << k << "};\n";
+        out << "    return co;\n}\n\n";
+    }
+
+public:
+    AotTranspiler(VM* vm, _Str module) : vm(vm), module(module) {
+        for(char c : module) ns += isalnum((unsigned char)c) ? c : '_';
+    }
+
+    _Str transpile(const _Str& source, const _Str& filename){
+        // level 2 splices functions of this VM into their callers, they can't be written out
+        int level = vm->optimizeLevel;
+        vm->optimizeLevel = 1;
+        _Code code;
+        try{
+            code = vm->compile(source, filename, EXEC_MODE);
+        }catch(...){
+            vm->optimizeLevel = level;
+            throw;
+        }
+        vm->optimizeLevel = level;
+        __collect(code.get());
+
+        out << "// generated by `pocketpy --aot " << filename << " " << module << "`, see aot.h\n";
+        out << "#pragma once\n\n";
+        out << "namespace __aot_" << ns << " {\n\n";
+        out << "static const char* __source =\n";
+        for(size_t i=0; i<source.size();){
+            size_t j = std::min(source.find('\n', i), source.size()-1) + 1;
+            out << "    " << __literal(source.substr(i, j-i)) << "\n";
+            i = j;
+        }
+        out << "    \"\";\n\n";
+
+        for(int k=0; k<codes.size(); k++) __emit_body(k);
+        for(int k=0; k<codes.size(); k++){
+            if(!__is_native(codes[k])) continue;
+            out << "static PyVar __fn_" << k << "(VM* vm, const pkpy::ArgList& args){\n";
+            out << "    static const _Str key(" << __literal(module + "#" + std::to_string(k)) << ");\n";
+            out << "    return vm->__aot_call(key, args);\n}\n\n";
+        }
+        // functions are built by the code objects holding them, which come first
+        for(int k=codes.size()-1; k>=0; k--) __emit_builder(k);
+
+        out << "static void __load(VM* vm, PyVar mod){\n";
+        out << "    _Source src = __aot_source(__source, " << __literal(filename) << ");\n";
+        out << "    _AotNatives natives;\n";
+        out << "    vm->__aot_exec(__code_0(vm, src, natives), mod, natives);\n}\n\n";
+        out << "static const bool __registered = (__aot_registry()[" << __literal(module) << "] = &__load, true);\n\n";
+        out << "}   // namespace __aot_" << ns << "\n";
+        return out.str();
+    }
+};
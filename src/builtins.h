@@ -2,8 +2,7 @@
 
 const char* __BUILTINS_CODE = R"(
 def print(*args, sep=' ', end='\n'):
-    s = sep.join([str(i) for i in args])
-    __sys_stdout_write(s + end)
+    __sys_stdout_write(sep.join(args) + end)
 
 def round(x, ndigits=0):
     assert ndigits >= 0
@@ -23,38 +22,24 @@ def max(a, b):
 def min(a, b):
     return a < b ? a : b
 
-def sum(iterable):
-    res = 0
-    for i in iterable:
-        res += i
-    return res
-
 def map(f, iterable):
-    return [f(i) for i in iterable]
-
-def zip(a, b):
-    return [(a[i], b[i]) for i in range(min(len(a), len(b)))]
+    for i in iterable:
+        yield f(i)
 
 def reversed(iterable):
-    a = list(iterable)
-    return [a[i] for i in range(len(a)-1, -1, -1)]
+    a = iterable
+    if type(a) is not list and type(a) is not tuple:
+        a = list(a)
+    for i in range(len(a)-1, -1, -1):
+        yield a[i]
 
 def sorted(iterable, key=None, reverse=False):
-    if key is None:
-        key = lambda x: x
-    a = [key(i) for i in iterable]
     b = list(iterable)
-    for i in range(len(a)):
-        for j in range(i+1, len(a)):
-            if (a[i] > a[j]) ^ reverse:
-                a[i], a[j] = a[j], a[i]
-                b[i], b[j] = b[j], b[i]
+    b.sort(key, reverse)
     return b
 
 ##### str #####
 
-str.__mul__ = lambda self, n: ''.join([self for _ in range(n)])
-
 def __str4split(self, sep):
     if sep == "":
         return list(self)
@@ -129,6 +114,14 @@ def __list4pop(self, i=-1):
 list.pop = __list4pop
 del __list4pop
 
+def __list4sort(self, key=None, reverse=False):
+    keys = None
+    if key is not None:
+        keys = [key(i) for i in self]
+    __list_sort(self, keys, reverse)
+list.sort = __list4sort
+del __list4sort
+
 def __list4__mul__(self, n):
     a = []
     for i in range(n):
@@ -163,11 +156,9 @@ def __iterable4__contains__(self, item):
         if i == item:
             return True
     return False
-list.__contains__ = __iterable4__contains__
 tuple.__contains__ = __iterable4__contains__
 del __iterable4__contains__
 
-list.__new__ = lambda obj: [i for i in obj]
 
 # https://github.com/python/cpython/blob/main/Objects/dictobject.c
 class dict:
@@ -403,7 +394,7 @@ class set:
     def __repr__(self):
         if len(self) == 0:
             return 'set()'
-        return '{'+ ', '.join(self._a.keys()) + '}'
+        return '{'+ ', '.join([repr(i) for i in self._a.keys()]) + '}'
     
     def __iter__(self):
         return self._a.keys().__iter__()
@@ -445,6 +436,114 @@ path.join = __path4join
 del __path4join
 )";
 
+const char* __WEAKREF_CODE = R"(
+import _weakref
+
+ref = _weakref.ref
+getweakrefcount = _weakref.getweakrefcount
+
+# an entry goes away with its value, each value is held by a ref which knows its key
+class WeakValueDictionary:
+    def __init__(self):
+        self._d = {}
+
+    def _remove(self, r):
+        if r.key in self._d and self._d[r.key] is r:
+            del self._d[r.key]
+
+    def __setitem__(self, key, value):
+        r = ref(value, self._remove)
+        r.key = key
+        self._d[key] = r
+
+    def __getitem__(self, key):
+        value = self._d[key]()
+        if value is None:
+            raise KeyError(key)
+        return value
+
+    def get(self, key, default=None):
+        if key not in self._d:
+            return default
+        value = self._d[key]()
+        if value is None:
+            return default
+        return value
+
+    def __delitem__(self, key):
+        del self._d[key]
+
+    def __contains__(self, key):
+        return key in self._d and self._d[key]() is not None
+
+    def __len__(self):
+        return len(self._d)
+
+    def items(self):
+        a = []
+        for k, r in self._d.items():
+            value = r()
+            if value is not None:
+                a.append((k, value))
+        return a
+
+    def keys(self):
+        return [kv[0] for kv in self.items()]
+
+    def values(self):
+        return [kv[1] for kv in self.items()]
+
+    def __iter__(self):
+        return self.keys().__iter__()
+
+# an entry goes away with its key, the keys are compared by identity
+class WeakKeyDictionary:
+    def __init__(self):
+        self._d = {}
+
+    def _remove(self, r):
+        if r in self._d:
+            del self._d[r]
+
+    def __setitem__(self, key, value):
+        self._d[ref(key, self._remove)] = value
+
+    def __getitem__(self, key):
+        return self._d[ref(key)]
+
+    def get(self, key, default=None):
+        r = ref(key)
+        if r not in self._d:
+            return default
+        return self._d[r]
+
+    def __delitem__(self, key):
+        del self._d[ref(key)]
+
+    def __contains__(self, key):
+        return ref(key) in self._d
+
+    def __len__(self):
+        return len(self._d)
+
+    def items(self):
+        a = []
+        for r, value in self._d.items():
+            key = r()
+            if key is not None:
+                a.append((key, value))
+        return a
+
+    def keys(self):
+        return [kv[0] for kv in self.items()]
+
+    def values(self):
+        return [kv[1] for kv in self.items()]
+
+    def __iter__(self):
+        return self.keys().__iter__()
+)";
+
 const char* __RANDOM_CODE = R"(
 import time as _time
 
@@ -21,8 +21,68 @@ struct Bytecode{
     int arg;
     int line;
     uint16_t block;     // the block id of this bytecode
+    uint16_t inlined = 0;   // 1 + index in co_inlined if it was spliced from a callee
 };
 
+enum TypeHint {
+    HINT_NONE = 0,
+    HINT_INT,
+    HINT_FLOAT,
+};
+
+union UnboxedValue {
+    i64 _int;
+    f64 _float;
+};
+
+// a local annotated as `int` or `float`. A value of another type is kept boxed instead,
+// so the annotation never changes what the code does
+struct TypedLocal {
+    UnboxedValue value;
+    PyVar boxed;
+    bool bound = false;
+};
+
+// a call site which the callee was spliced into, see `IROptimizer::inline_calls`
+struct InlinedCall {
+    PyVar fn;       // `co_names[name]` must still be bound to it, otherwise the call deoptimizes
+    int name;
+    int argc;
+    int line;       // line of the call site
+    _Code code;     // the callee, for tracebacks
+    int end = -1;   // index after the spliced body
+};
+
+// `len(obj)` hoisted out of a loop, see `IROptimizer::hoist_loop_invariants`
+struct HoistedLen {
+    int slot;       // the typed local holding the length, -1 if the guard failed
+    int fn;         // `len` in co_names
+    int obj;        // `obj` in co_names
+};
+
+// the inline cache of an attribute name of a code object, keyed by the shape of the instance
+// loads and stores keep separate entries, so `self.x = self.x + 1` hits both, see `VM::getattr_cached`
+struct AttrCache {
+    uint32_t load_shape = 0;        // `Shape::id`, 0 matches nothing
+    int load_index = -1;
+    uint32_t store_shape = 0;
+    int store_index = -1;
+    Shape* store_next = nullptr;    // set if the store adds the attribute, then it follows this transition
+};
+
+#ifdef PKPY_ENABLE_JIT
+struct JitCode;
+#endif
+
+#ifdef PKPY_REGISTER_TIER
+struct RegCode;
+#endif
+
+// the body of a code object transpiled to C++ by `pocketpy --aot`, see aot.h
+typedef PyVar (*_AotFn)(VM*, Frame*);
+typedef void (*_AotLoader)(VM*, PyVar);     // runs a transpiled module in the given module object
+typedef std::map<const CodeObject*, std::pair<_Str, _CppFunc>> _AotNatives;
+
 _Str pad(const _Str& s, const int n){
     if(s.size() >= n) return s.substr(0, n);
     return s + std::string(n - s.size(), ' ');
@@ -75,6 +135,22 @@ struct CodeObject {
     PyVarList co_consts;
     std::vector<std::pair<_Str, NameScope>> co_names;
     std::vector<_Str> co_global_names;
+    std::vector<std::pair<_Str, TypeHint>> co_typed_names;     // unboxed locals, see `Frame::f_unboxed`
+    std::vector<HoistedLen> co_hoisted;
+    std::vector<AttrCache> co_attr_caches;  // by index in co_names, grown on demand
+    std::vector<InlinedCall> co_inlined;
+    _AotFn co_aot = nullptr;                // runs the whole frame natively if set
+    bool co_generator = false;              // calls return a `Generator`, which runs the frame lazily
+
+#ifdef PKPY_REGISTER_TIER
+    bool co_reg_tried = false;
+    std::shared_ptr<RegCode> co_reg;        // see regvm.h
+#endif
+
+#ifdef PKPY_ENABLE_JIT
+    int co_hotness = 0;                     // calls and loop back-edges so far
+    std::shared_ptr<JitCode> co_jit;        // native code, see jit.h
+#endif
 
     std::vector<CodeBlock> co_blocks = { CodeBlock{NO_BLOCK, {}, -1} };
 
@@ -118,6 +194,7 @@ struct CodeObject {
     }
 
     int add_name(_Str name, NameScope scope){
+        if(!name.is_interned() && src->mode == EXEC_MODE) name = _Str::intern(name);
         if(scope == NAME_LOCAL && std::find(co_global_names.begin(), co_global_names.end(), name) != co_global_names.end()){
             scope = NAME_GLOBAL;
         }
@@ -129,24 +206,47 @@ struct CodeObject {
         return co_names.size() - 1;
     }
 
+    inline AttrCache* attr_cache(int name){
+        if(co_attr_caches.size() <= name) co_attr_caches.resize(co_names.size());
+        return &co_attr_caches[name];
+    }
+
+    int add_typed_name(_Str name, TypeHint hint){
+        co_typed_names.push_back(std::make_pair(name, hint));
+        return co_typed_names.size() - 1;
+    }
+
+    int find_typed_name(const _Str& name) const {
+        for(int i=0; i<co_typed_names.size(); i++){
+            if(co_typed_names[i].first == name) return i;
+        }
+        return -1;
+    }
+
     int add_const(PyVar v){
         co_consts.push_back(v);
         return co_consts.size() - 1;
     }
 
+    // the operand is consumed as a value, so there is no need to build a ref
+    static void __deref_load(Bytecode& bc){
+        if(bc.op == OP_LOAD_NAME_REF) bc.op = OP_LOAD_NAME;
+        else if(bc.op == OP_LOAD_TYPED_LOCAL_REF) bc.op = OP_LOAD_TYPED_LOCAL;
+    }
+
     void optimize_level_1(){
         for(int i=0; i<co_code.size(); i++){
             if(co_code[i].op >= OP_BINARY_OP && co_code[i].op <= OP_CONTAINS_OP){
                 for(int j=0; j<2; j++){
                     Bytecode& bc = co_code[i-j-1];
                     if(bc.op >= OP_LOAD_CONST && bc.op <= OP_LOAD_NAME_REF){
-                        if(bc.op == OP_LOAD_NAME_REF){
-                            bc.op = OP_LOAD_NAME;
-                        }
+                        __deref_load(bc);
                     }else{
                         break;
                     }
                 }
+            }else if(co_code[i].op == OP_STORE_TYPED_LOCAL || co_code[i].op == OP_RETURN_VALUE || co_code[i].op == OP_YIELD_VALUE){
+                if(i >= 1) __deref_load(co_code[i-1]);
             }else if(co_code[i].op == OP_CALL){
                 int ARGC = co_code[i].arg & 0xFFFF;
                 int KWARGC = (co_code[i].arg >> 16) & 0xFFFF;
@@ -154,9 +254,7 @@ struct CodeObject {
                 for(int j=0; j<ARGC+1; j++){
                     Bytecode& bc = co_code[i-j-1];
                     if(bc.op >= OP_LOAD_CONST && bc.op <= OP_LOAD_NAME_REF){
-                        if(bc.op == OP_LOAD_NAME_REF){
-                            bc.op = OP_LOAD_NAME;
-                        }
+                        __deref_load(bc);
                     }else{
                         break;
                     }
@@ -165,8 +263,11 @@ struct CodeObject {
         }
     }
 
+    void optimize_level_2();        // see optimizer.h
+
     void optimize(int level=1){
         optimize_level_1();
+        if(level >= 2) optimize_level_2();
     }
 };
 
@@ -179,12 +280,27 @@ public:
     const _Code code;
     PyVar _module;
     PyVarDict f_locals;
+    std::vector<TypedLocal> f_unboxed;      // indexed by `co_typed_names`
+    PyVar f_ctor_self;                      // set on `__init__` frames, their caller gets it instead of None
 
-    inline PyVarDict f_locals_copy() const { return f_locals; }
-    inline PyVarDict& f_globals(){ return _module->attribs; }
+    inline PyVarDict f_locals_copy(VM* vm) const;
+    inline PyVarDict& f_globals(){ return _module->attribs.dict(); }
+
+    // frames come and go with every call, so they share the pool of objects
+    static void* operator new(size_t size){ return pkpy::__pool.alloc(size); }
+    static void operator delete(void* p, size_t size){ pkpy::__pool.dealloc(p, size); }
 
     Frame(const _Code code, PyVar _module, PyVarDict&& locals)
-        : code(code), _module(_module), f_locals(std::move(locals)) {
+        : code(code), _module(_module), f_locals(std::move(locals)), f_unboxed(code->co_typed_names.size()) {
+    }
+
+    // what a suspended generator holds on to, see `Generator::gc_traverse`
+    void gc_traverse(const pkpy::_GCVisitor& v) const {
+        for(const PyVar& val : s_data) v(val);
+        for(const auto& [_, val] : f_locals) v(val);
+        for(const TypedLocal& t : f_unboxed) v(t.boxed);
+        v(_module);
+        v(f_ctor_self);
     }
 
     inline const Bytecode& next_bytecode() {
@@ -194,12 +310,17 @@ public:
     }
 
     _Str curr_snapshot(){
-        int line = code->co_code[ip].line;
-        return code->src->snapshot(line);
+        const Bytecode& byte = code->co_code[ip];
+        if(byte.inlined == 0) return code->src->snapshot(byte.line);
+        // report the call site and then the callee, as if it had its own frame
+        const InlinedCall& ic = code->co_inlined[byte.inlined-1];
+        return code->src->snapshot(ic.line) + ic.code->src->snapshot(byte.line);
     }
 
     inline int stack_size() const{ return s_data.size(); }
     inline bool has_next_bytecode() const{ return next_ip < code->co_code.size(); }
+    inline int next_index() const{ return next_ip; }
+    inline void set_ip(int i){ ip = i; next_ip = i + 1; }
 
     inline PyVar pop(){
         if(s_data.empty()) throw std::runtime_error("s_data.empty() is true");
@@ -25,6 +25,11 @@ public:
     int lexingCnt = 0;
     VM* vm;
 
+    // static type of the value produced by the last emitted bytecode
+    TypeHint _exprHint = HINT_NONE;
+    const CodeObject* _exprHintCode = nullptr;
+    int _exprHintIndex = -1;
+
     emhash8::HashMap<_TokenType, GrammarRule> rules;
 
     _Code co() {
@@ -35,6 +40,11 @@ public:
         return parser->src->mode;
     }
 
+    // the interactive and eval paths stay single-pass
+    int optimizeLevel() {
+        return mode() == EXEC_MODE ? vm->optimizeLevel : 1;
+    }
+
     Compiler(VM* vm, const char* source, _Str filename, CompileMode mode){
         this->vm = vm;
         this->parser = std::make_unique<Parser>(
@@ -163,6 +173,11 @@ public:
         if(type == F_STRING){
             parser->setNextToken(TK("@fstr"), vm->PyStr(s));
         }else{
+            // a literal of a module spelled like a name is most likely a key or an attribute name.
+            // The interned table is never freed, so values from eval and json input stay out of it
+            bool is_name = mode() == EXEC_MODE && !s.empty() && !isdigit((unsigned char)s[0]);
+            for(char c : s) is_name = is_name && (isalnum((unsigned char)c) || c == '_');
+            if(is_name) s = _Str::intern(s);
             parser->setNextToken(TK("@str"), vm->PyStr(s));
         }
     }
@@ -373,18 +388,20 @@ public:
         PyVar value = parser->prev.value;
         int index = co()->add_const(value);
         emit(OP_LOAD_CONST, index);
+        if(value->is_type(vm->_tp_int)) setExprHint(HINT_INT);
+        else if(value->is_type(vm->_tp_float)) setExprHint(HINT_FLOAT);
     }
 
     void exprFString() {
         static const std::regex pattern(R"(\{(.*?)\})");
         PyVar value = parser->prev.value;
         _Str s = vm->PyStr_AS_C(value);
-        std::sregex_iterator begin(s.begin(), s.end(), pattern);
-        std::sregex_iterator end;
+        std::cregex_iterator begin(s.begin(), s.end(), pattern);
+        std::cregex_iterator end;
         int size = 0;
         int i = 0;
         for(auto it = begin; it != end; it++) {
-            std::smatch m = *it;
+            std::cmatch m = *it;
             if (i < m.position()) {
                 std::string literal = s.substr(i, m.position() - i);
                 emit(OP_LOAD_CONST, co()->add_const(vm->PyStr(literal)));
@@ -415,34 +432,46 @@ public:
         this->codes.push(func->code);
         EXPR_TUPLE();
         emit(OP_RETURN_VALUE);
-        func->code->optimize();
+        func->code->optimize(optimizeLevel());
         this->codes.pop();
         emit(OP_LOAD_LAMBDA, co()->add_const(vm->PyFunction(func)));
     }
 
     void exprAssign() {
         _TokenType op = parser->prev.type;
+        // the target is a typed local, store it directly without building a ref
+        int typed = -1;
+        if(co()->co_code.back().op == OP_LOAD_TYPED_LOCAL_REF) typed = co()->co_code.back().arg;
+
         if(op == TK("=")) {     // a = (expr)
+            if(typed >= 0) co()->co_code.pop_back();
             EXPR_TUPLE();
-            emit(OP_STORE_REF);
+            if(typed >= 0) emit(OP_STORE_TYPED_LOCAL, typed);
+            else emit(OP_STORE_REF);
         }else{                  // a += (expr) -> a = a + (expr)
-            // TODO: optimization is needed for inplace operators
-            emit(OP_DUP_TOP);
+            TypeHint lhs = HINT_NONE;
+            if(typed >= 0){
+                co()->co_code.back().op = OP_LOAD_TYPED_LOCAL;
+                lhs = co()->co_typed_names[typed].second;
+            }else{
+                emit(OP_DUP_TOP);
+            }
             EXPR();
+            TypeHint rhs = exprHint();
             switch (op) {
-                case TK("+="):      emit(OP_BINARY_OP, 0);  break;
-                case TK("-="):      emit(OP_BINARY_OP, 1);  break;
-                case TK("*="):      emit(OP_BINARY_OP, 2);  break;
-                case TK("/="):      emit(OP_BINARY_OP, 3);  break;
-                case TK("//="):     emit(OP_BINARY_OP, 4);  break;
-
-                case TK("%="):      emit(OP_BINARY_OP, 5);  break;
-                case TK("&="):      emit(OP_BITWISE_OP, 2);  break;
-                case TK("|="):      emit(OP_BITWISE_OP, 3);  break;
-                case TK("^="):      emit(OP_BITWISE_OP, 4);  break;
+                case TK("+="):      emitBinaryOp(TK("+"), lhs, rhs);    break;
+                case TK("-="):      emitBinaryOp(TK("-"), lhs, rhs);    break;
+                case TK("*="):      emitBinaryOp(TK("*"), lhs, rhs);    break;
+                case TK("/="):      emitBinaryOp(TK("/"), lhs, rhs);    break;
+                case TK("//="):     emitBinaryOp(TK("//"), lhs, rhs);   break;
+                case TK("%="):      emitBinaryOp(TK("%"), lhs, rhs);    break;
+                case TK("&="):      emitBinaryOp(TK("&"), lhs, rhs);    break;
+                case TK("|="):      emitBinaryOp(TK("|"), lhs, rhs);    break;
+                case TK("^="):      emitBinaryOp(TK("^"), lhs, rhs);    break;
                 default: UNREACHABLE();
             }
-            emit(OP_STORE_REF);
+            if(typed >= 0) emit(OP_STORE_TYPED_LOCAL, typed);
+            else emit(OP_STORE_REF);
         }
     }
 
@@ -459,12 +488,14 @@ public:
         int patch = emit(OP_JUMP_IF_TRUE_OR_POP);
         parsePrecedence(PREC_LOGICAL_OR);
         patch_jump(patch);
+        setExprHint(HINT_NONE);
     }
 
     void exprAnd() {
         int patch = emit(OP_JUMP_IF_FALSE_OR_POP);
         parsePrecedence(PREC_LOGICAL_AND);
         patch_jump(patch);
+        setExprHint(HINT_NONE);
     }
 
     void exprTernary() {
@@ -475,12 +506,40 @@ public:
         patch_jump(patch);
         EXPR();         // if false
         patch_jump(patch2);
+        setExprHint(HINT_NONE);
     }
 
     void exprBinaryOp() {
         _TokenType op = parser->prev.type;
+        TypeHint lhs = exprHint();
         parsePrecedence((Precedence)(rules[op].precedence + 1));
+        emitBinaryOp(op, lhs, exprHint());
+    }
 
+    // use the specialized opcodes if both operands are statically typed numbers
+    void emitBinaryOp(_TokenType op, TypeHint lhs, TypeHint rhs) {
+        if(lhs != HINT_NONE && rhs != HINT_NONE){
+            bool both_int = lhs == HINT_INT && rhs == HINT_INT;
+            switch (op) {
+                case TK("+"):   emit(both_int ? OP_BINARY_OP_INT : OP_BINARY_OP_FLOAT, 0); break;
+                case TK("-"):   emit(both_int ? OP_BINARY_OP_INT : OP_BINARY_OP_FLOAT, 1); break;
+                case TK("*"):   emit(both_int ? OP_BINARY_OP_INT : OP_BINARY_OP_FLOAT, 2); break;
+                case TK("/"):   emit(OP_BINARY_OP_FLOAT, 3); setExprHint(HINT_FLOAT); return;
+                case TK("//"):  if(!both_int) goto __GENERIC; emit(OP_BINARY_OP_INT, 4); break;
+                case TK("%"):   if(!both_int) goto __GENERIC; emit(OP_BINARY_OP_INT, 5); break;
+
+                case TK("<"):   emit(OP_COMPARE_OP_NUM, 0);    return;
+                case TK("<="):  emit(OP_COMPARE_OP_NUM, 1);    return;
+                case TK("=="):  emit(OP_COMPARE_OP_NUM, 2);    return;
+                case TK("!="):  emit(OP_COMPARE_OP_NUM, 3);    return;
+                case TK(">"):   emit(OP_COMPARE_OP_NUM, 4);    return;
+                case TK(">="):  emit(OP_COMPARE_OP_NUM, 5);    return;
+                default: goto __GENERIC;
+            }
+            setExprHint(both_int ? HINT_INT : HINT_FLOAT);
+            return;
+        }
+__GENERIC:
         switch (op) {
             case TK("+"):   emit(OP_BINARY_OP, 0);  break;
             case TK("-"):   emit(OP_BINARY_OP, 1);  break;
@@ -514,9 +573,10 @@ public:
         _TokenType op = parser->prev.type;
         matchNewLines();
         parsePrecedence((Precedence)(PREC_UNARY + 1));
+        TypeHint hint = exprHint();
 
         switch (op) {
-            case TK("-"):     emit(OP_UNARY_NEGATIVE); break;
+            case TK("-"):     emit(OP_UNARY_NEGATIVE); setExprHint(hint); break;
             case TK("not"):   emit(OP_UNARY_NOT);      break;
             case TK("*"):     syntaxError("cannot use '*' as unary operator"); break;
             default: UNREACHABLE();
@@ -525,11 +585,69 @@ public:
 
     void exprGrouping() {
         matchNewLines(mode()==SINGLE_MODE);
-        EXPR_TUPLE();
+        if(__isGeneratorAhead()) exprGenerator();
+        else EXPR_TUPLE();
         matchNewLines(mode()==SINGLE_MODE);
         consume(TK(")"));
     }
 
+    // whether the parentheses just opened hold a generator expression, that is, a `for`
+    // comes before any top-level ',' or the closing ')'
+    bool __isGeneratorAhead() const {
+        const char* p = parser->curr.start;
+        int depth = 0;
+        while(*p != '\0'){
+            char c = *p;
+            if(c == '\'' || c == '"'){
+                bool triple = p[1] == c && p[2] == c;
+                p += triple ? 3 : 1;
+                while(*p != '\0'){
+                    if(*p == '\\' && p[1] != '\0'){ p += 2; continue; }
+                    if(triple ? (p[0] == c && p[1] == c && p[2] == c) : *p == c) break;
+                    p++;
+                }
+                if(*p == '\0') return false;
+                p += triple ? 3 : 1;
+            }else if(c == '#'){
+                while(*p != '\0' && *p != '\n') p++;
+            }else if(c == '(' || c == '[' || c == '{'){
+                depth++; p++;
+            }else if(c == ')' || c == ']' || c == '}'){
+                if(depth-- == 0) return false;
+                p++;
+            }else if(c == ',' && depth == 0){
+                return false;
+            }else if(isalpha((unsigned char)c) || c == '_'){
+                const char* begin = p;
+                while(isalnum((unsigned char)*p) || *p == '_') p++;
+                if(depth == 0 && p - begin == 3 && strncmp(begin, "for", 3) == 0) return true;
+            }else{
+                p++;
+            }
+        }
+        return false;
+    }
+
+    // `(expr for vars in iterable)` gets a code object of its own, run lazily by a generator
+    void exprGenerator() {
+        _Func func = pkpy::make_shared<Function>();
+        func->name = "<genexpr>";
+        func->code = pkpy::make_shared<CodeObject>(parser->src, func->name);
+        func->code->co_generator = true;
+        this->codes.push(func->code);
+        int _patch = emit(OP_NO_OP);
+        int _body_start = co()->co_code.size();
+        EXPR();
+        matchNewLines(mode()==SINGLE_MODE);
+        consume(TK("for"));
+        __compileComprehension(_patch, _body_start, OP_YIELD_VALUE);
+        emit(OP_LOAD_NONE);
+        emit(OP_RETURN_VALUE);
+        func->code->optimize(optimizeLevel());
+        this->codes.pop();
+        emit(OP_BUILD_GENERATOR, co()->add_const(vm->PyFunction(func)));
+    }
+
     void exprList() {
         int _patch = emit(OP_NO_OP);
         int _body_start = co()->co_code.size();
@@ -547,11 +665,19 @@ public:
         return;
 
 __LISTCOMP:
+        __compileComprehension(_patch, _body_start, OP_LIST_APPEND);
+        matchNewLines(mode()==SINGLE_MODE);
+        consume(TK("]"));
+    }
+
+    // the element, compiled at `_body_start`, is skipped by the bytecode at `_patch` until the loop
+    // runs it, and each element is then consumed by `op`, either LIST_APPEND or YIELD_VALUE
+    void __compileComprehension(int _patch, int _body_start, Opcode op) {
         int _body_end_return = emit(OP_JUMP_ABSOLUTE, -1);
         int _body_end = co()->co_code.size();
         co()->co_code[_patch].op = OP_JUMP_ABSOLUTE;
         co()->co_code[_patch].arg = _body_end;
-        emit(OP_BUILD_LIST, 0);
+        if(op == OP_LIST_APPEND) emit(OP_BUILD_LIST, 0);
         EXPR_FOR_VARS();consume(TK("in"));EXPR_TUPLE();
         matchNewLines(mode()==SINGLE_MODE);
         
@@ -574,18 +700,16 @@ __LISTCOMP:
             int ifpatch = emit(OP_POP_JUMP_IF_FALSE);
             emit(OP_JUMP_ABSOLUTE, _body_start);
             patch_jump(_body_end_return);
-            emit(OP_LIST_APPEND);
+            emit(op);
             patch_jump(ifpatch);
         }else{
             emit(OP_JUMP_ABSOLUTE, _body_start);
             patch_jump(_body_end_return);
-            emit(OP_LIST_APPEND);
+            emit(op);
         }
 
         emit(OP_LOOP_CONTINUE, -1, true);
         co()->__exitBlock();
-        matchNewLines(mode()==SINGLE_MODE);
-        consume(TK("]"));
     }
 
     void exprMap() {
@@ -613,6 +737,14 @@ __LISTCOMP:
     void exprCall() {
         int ARGC = 0;
         int KWARGC = 0;
+        matchNewLines(mode()==SINGLE_MODE);
+        if(__isGeneratorAhead()){       // f(x for x in a)
+            exprGenerator();
+            matchNewLines(mode()==SINGLE_MODE);
+            consume(TK(")"));
+            emit(OP_CALL, 1);
+            return;
+        }
         do {
             matchNewLines(mode()==SINGLE_MODE);
             if (peek() == TK(")")) break;
@@ -636,6 +768,12 @@ __LISTCOMP:
 
     void exprName() {
         Token tkname = parser->prev;
+        int typed = codes.size()>1 ? co()->find_typed_name(tkname.str()) : -1;
+        if(typed >= 0){
+            emit(OP_LOAD_TYPED_LOCAL_REF, typed);
+            setExprHint(co()->co_typed_names[typed].second);
+            return;
+        }
         int index = co()->add_name(
             tkname.str(),
             codes.size()>1 ? NAME_LOCAL : NAME_GLOBAL
@@ -701,6 +839,46 @@ __LISTCOMP:
         return i;
     }
 
+    inline void setExprHint(TypeHint hint) {
+        _exprHint = hint;
+        _exprHintCode = co().get();
+        _exprHintIndex = co()->co_code.size();
+    }
+
+    // the hint is valid only if nothing was emitted after it
+    inline TypeHint exprHint() {
+        if(_exprHintCode != co().get() || _exprHintIndex != co()->co_code.size()) return HINT_NONE;
+        return _exprHint;
+    }
+
+    TypeHint toTypeHint(const _Str& name) {
+        if(name == "int") return HINT_INT;
+        if(name == "float") return HINT_FLOAT;
+        return HINT_NONE;
+    }
+
+    // returns the index in `co_typed_names`, or -1 if the local stays boxed
+    int declareTypedLocal(_Code code, const _Str& name, TypeHint hint) {
+#ifndef PKPY_TYPED_LOCALS
+        return -1;
+#else
+        int index = code->find_typed_name(name);
+        if(index >= 0){
+            if(code->co_typed_names[index].second != hint) syntaxError("conflicting type hints for '" + name + "'");
+            return index;
+        }
+        if(hint == HINT_NONE) return -1;
+        // a name which is already used as a boxed local or a global cannot be typed
+        for(const auto& p : code->co_names){
+            if(p.first == name && p.second != NAME_ATTR) return -1;
+        }
+        for(const auto& g : code->co_global_names){
+            if(g == name) return -1;
+        }
+        return code->add_typed_name(name, hint);
+#endif
+    }
+
     inline void patch_jump(int addr_index) {
         int target = co()->co_code.size();
         co()->co_code[addr_index].arg = target;
@@ -867,6 +1045,17 @@ __LISTCOMP:
                 consumeEndStatement();
             }
             emit(OP_RETURN_VALUE);
+        } else if (match(TK("yield"))) {
+            if (codes.size() == 1)
+                syntaxError("'yield' outside function");
+            co()->co_generator = true;
+            if(matchEndStatement()){
+                emit(OP_LOAD_NONE);
+            }else{
+                EXPR_TUPLE();
+                consumeEndStatement();
+            }
+            emit(OP_YIELD_VALUE);
         } else if (match(TK("if"))) {
             compileIfStatement();
         } else if (match(TK("while"))) {
@@ -929,18 +1118,42 @@ __LISTCOMP:
             consumeEndStatement();
         } else if(match(TK("pass"))){
             consumeEndStatement();
+        } else if(peek() == TK("@id") && peek_next() == TK(":")){
+            compileAnnotatedAssign();
         } else {
             EXPR_ANY();
             consumeEndStatement();
             // If last op is not an assignment, pop the result.
             uint8_t lastOp = co()->co_code.back().op;
-            if( lastOp!=OP_STORE_NAME_REF && lastOp!=OP_STORE_REF){
+            if( lastOp!=OP_STORE_NAME_REF && lastOp!=OP_STORE_REF && lastOp!=OP_STORE_TYPED_LOCAL){
                 if(mode()==SINGLE_MODE && parser->indents.top()==0) emit(OP_PRINT_EXPR);
                 emit(OP_POP_TOP);
             }
         }
     }
 
+    // x: int = 0
+    void compileAnnotatedAssign(){
+        consume(TK("@id"));
+        Token tkname = parser->prev;
+        consume(TK(":"));
+        consume(TK("@id"));
+        int typed = -1;
+        if(codes.size() > 1) typed = declareTypedLocal(co(), tkname.str(), toTypeHint(parser->prev.str()));
+        if(match(TK("="))){
+            if(typed >= 0){
+                EXPR_TUPLE();
+                emit(OP_STORE_TYPED_LOCAL, typed);
+            }else{
+                int index = co()->add_name(tkname.str(), codes.size()>1 ? NAME_LOCAL : NAME_GLOBAL);
+                emit(OP_LOAD_NAME_REF, index);
+                EXPR_TUPLE();
+                emit(OP_STORE_REF);
+            }
+        }
+        consumeEndStatement();
+    }
+
     void compileClass(){
         consume(TK("@id"));
         int clsNameIdx = co()->add_name(parser->prev.str(), NAME_GLOBAL);
@@ -977,9 +1190,14 @@ __LISTCOMP:
             if(func->hasName(name)) syntaxError("duplicate argument name");
 
             // eat type hints
-            if(enableTypeHints && match(TK(":"))) consume(TK("@id"));
+            TypeHint hint = HINT_NONE;
+            if(enableTypeHints && match(TK(":"))){
+                consume(TK("@id"));
+                hint = toTypeHint(parser->prev.str());
+            }
 
             if(state == 0 && peek() == TK("=")) state = 2;
+            if(hint != HINT_NONE && (state == 0 || state == 2)) declareTypedLocal(func->code, name, hint);
 
             switch (state)
             {
@@ -1007,6 +1225,7 @@ __LISTCOMP:
         _Func func = pkpy::make_shared<Function>();
         consume(TK("@id"));
         func->name = parser->prev.str();
+        func->code = pkpy::make_shared<CodeObject>(parser->src, func->name);
 
         if (match(TK("(")) && !match(TK(")"))) {
             __compileFunctionArgs(func, true);
@@ -1016,10 +1235,9 @@ __LISTCOMP:
         // eat type hints
         if(match(TK("->"))) consume(TK("@id"));
 
-        func->code = pkpy::make_shared<CodeObject>(parser->src, func->name);
         this->codes.push(func->code);
         compileBlockBody();
-        func->code->optimize();
+        func->code->optimize(optimizeLevel());
         this->codes.pop();
         emit(OP_LOAD_CONST, co()->add_const(vm->PyFunction(func)));
         if(!isCompilingClass) emit(OP_STORE_FUNCTION);
@@ -1087,10 +1305,65 @@ __LISTCOMP:
             compileTopLevelStatement();
             matchNewLines();
         }
-        code->optimize();
+        code->optimize(optimizeLevel());
+        if(optimizeLevel() >= 2) inlineCalls(code);
         return code;
     }
 
+    // splices small functions of this module and of builtins into their call sites
+    void inlineCalls(const _Code& code){
+        std::map<_Str, int> defs;
+        std::map<_Str, PyVar> fns;
+        for(int i=1; i<code->co_code.size(); i++){
+            const Bytecode& bc = code->co_code[i];
+            if(bc.op != OP_STORE_FUNCTION || code->co_code[i-1].op != OP_LOAD_CONST) continue;
+            PyVar fn = code->co_consts[code->co_code[i-1].arg];
+            const _Str& name = vm->PyFunction_AS_C(fn)->name;
+            defs[name]++;
+            fns[name] = fn;
+        }
+
+        std::map<_Str, InlineCandidate> candidates;
+        std::map<_Str, std::set<_Str>> free_names;
+        auto consider = [&](const _Str& name, const PyVar& fn, bool same_module){
+            const _Func& func = vm->PyFunction_AS_C(fn);
+            std::set<_Str> names;
+            if(!IROptimizer::free_names_of(*func, names)) return;
+            // free names resolve in the module of the caller
+            if(!same_module && !names.empty()) return;
+            candidates[name] = InlineCandidate{fn, func};
+            free_names[name] = std::move(names);
+        };
+        for(auto& kv : defs) if(kv.second == 1) consider(kv.first, fns[kv.first], true);
+        for(auto& kv : vm->builtins->attribs){
+            if(defs.count(kv.first) || !kv.second->is_type(vm->_tp_function)) continue;
+            consider(kv.first, kv.second, false);
+        }
+        // a callee must not reach other functions of this module, so the code
+        // being spliced never changes and functions never hold each other
+        for(auto it = candidates.begin(); it != candidates.end();){
+            bool leaf = true;
+            for(const _Str& name : free_names[it->first]) leaf &= defs.count(name) == 0 && candidates.count(name) == 0;
+            if(leaf) ++it;
+            else it = candidates.erase(it);
+        }
+        if(candidates.empty()) return;
+
+        std::vector<PyVar> pending;
+        for(const PyVar& obj : code->co_consts){
+            if(obj->is_type(vm->_tp_function)) pending.push_back(obj);
+        }
+        while(!pending.empty()){
+            PyVar obj = pending.back();
+            pending.pop_back();
+            const _Func& func = vm->PyFunction_AS_C(obj);
+            for(const PyVar& c : func->code->co_consts){
+                if(c->is_type(vm->_tp_function)) pending.push_back(c);
+            }
+            IROptimizer(func->code.get()).inline_calls(candidates, free_names, *func);
+        }
+    }
+
     /***** Error Reporter *****/
     _Str getLineSnapshot(){
         int lineno = parser->curr.line;
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "vm.h"
+
+// what each tracked layout references, a function or an iterator shared by several objects
+// is skipped, then whatever it references counts as referenced from outside
+template<typename T>
+inline void gc_traverse_value(const T&, const pkpy::_GCVisitor&) {}
+inline void gc_traverse_value(const PyVar& obj, const pkpy::_GCVisitor& v){ v(obj); }
+inline void gc_traverse_value(const _BoundedMethod& m, const pkpy::_GCVisitor& v){ v(m.obj); v(m.method); }
+inline void gc_traverse_value(const _WeakRef& r, const pkpy::_GCVisitor& v){ v(r.callback); }
+
+inline void gc_traverse_value(const PyVarList& list, const pkpy::_GCVisitor& v){
+    for(const PyVar& obj : list) v(obj);
+}
+
+// the constants and inlined callees of a code object belong to the function holding it alone
+inline void gc_traverse_value(const _Func& fn, const pkpy::_GCVisitor& v){
+    if(fn.use_count() != 1) return;
+    for(const auto& [_, obj] : fn->kwArgs) v(obj);
+    if(fn->code.use_count() != 1) return;
+    for(const PyVar& obj : fn->code->co_consts) v(obj);
+    for(const InlinedCall& call : fn->code->co_inlined) v(call.fn);
+}
+
+inline void gc_traverse_value(const _Iterator& it, const pkpy::_GCVisitor& v){
+    if(it.use_count() == 1) it->gc_traverse(v);
+}
+
+template<typename T>
+inline void gc_traverse_object(const Py_<T>& obj, const pkpy::_GCVisitor& v){ gc_traverse_value(obj._valueT, v); }
+
+// an int, a float or a str list references nothing tracked, and items shared by several
+// lists are skipped like a shared function
+inline void gc_traverse_object(const Py_<_List>& list, const pkpy::_GCVisitor& v){
+    if(pkpy::__object_bits(&list) != LIST_OBJECT || list._valueT.use_count() != 1) return;
+    gc_traverse_value(*list._valueT, v);
+}
+
+inline void gc_traverse_object(const PyTupleObject& t, const pkpy::_GCVisitor& v){
+    for(const PyVar& obj : t) v(obj);
+}
+
+inline void gc_traverse_object(const PyTypeObject& t, const pkpy::_GCVisitor& v){
+    for(const PyVar& slot : t.slots) v(slot);
+    v(t.ctor_new);
+}
+
+// drops the references of an unreachable object, the values are moved out first
+// so nothing sees a half-destroyed container
+template<typename T>
+inline void gc_clear_value(T&) {}
+inline void gc_clear_value(PyVar& obj){ obj.reset(); }
+inline void gc_clear_value(_BoundedMethod& m){ m.obj.reset(); m.method.reset(); }
+inline void gc_clear_value(_WeakRef& r){ r.callback.reset(); }
+inline void gc_clear_value(PyVarList& list){ PyVarList dropped = std::move(list); }
+
+inline void gc_clear_value(_Func& fn){
+    if(fn.use_count() != 1) return;
+    PyVarDict dropped = std::move(fn->kwArgs);
+    if(fn->code.use_count() != 1) return;
+    PyVarList consts = std::move(fn->code->co_consts);
+    for(InlinedCall& call : fn->code->co_inlined) call.fn.reset();
+}
+
+inline void gc_clear_value(_Iterator& it){
+    if(it.use_count() == 1) it->gc_clear();
+}
+
+inline void gc_clear_value(_List& list){
+    if(list.use_count() == 1) gc_clear_value(*list);
+}
+
+template<typename T>
+inline void gc_clear_object(Py_<T>& obj){ gc_clear_value(obj._valueT); }
+
+inline void gc_clear_object(PyTupleObject& t){
+    PyVarList dropped(t.size());
+    for(int i=0; i<t.size(); i++) dropped[i] = std::move(t[i]);
+}
+
+inline void gc_clear_object(PyTypeObject& t){
+    for(PyVar& slot : t.slots) slot.reset();
+    t.ctor_new.reset();
+    t.slots_epoch = -1;
+}
+
+template<typename U>
+void pkpy::__gc_traverse(void* p, const pkpy::_GCVisitor& v){
+    const U* obj = (const U*)p;
+    v(obj->_type);
+    obj->attribs.gc_traverse(v);
+    gc_traverse_object(*obj, v);
+}
+
+template<typename U>
+void pkpy::__gc_clear(void* p){
+    U* obj = (U*)p;
+    obj->attribs.clear();
+    gc_clear_object(*obj);
+}
+
+namespace pkpy {
+    const int GC_COLLECTING = 1 << 30;      // marks in the layout word of a block
+    const int GC_REACHABLE = 1 << 29;
+
+    inline void __gc_splice(GCHead* from, GCHead* to){
+        if(from->next == from) return;
+        from->next->prev = to->prev;
+        to->prev->next = from->next;
+        from->prev->next = to;
+        to->prev = from->prev;
+        from->next = from->prev = from;
+    }
+
+    inline void __gc_traverse_block(int* p, const _GCVisitor& v){
+        __layouts[p[1] & LAYOUT_MASK].traverse(p + 2, v);
+    }
+
+    // collects the generations up to `gen` by trial deletion. References between the objects
+    // of those generations are subtracted from their counts, so an object left above zero is
+    // referenced from outside and keeps alive whatever it reaches. The rest is garbage.
+    // Returns the number of objects collected.
+    inline int gc_collect(int gen){
+        GCState& st = __gc_state();
+        if(st.collecting) return 0;
+        __drain_frees(0);       // a queued block holds a reference nothing else accounts for
+        st.collecting = true;
+        GCHead* list = &st.gens[gen];
+        for(int i=0; i<gen; i++) __gc_splice(&st.gens[i], list);
+
+        std::vector<int*> blocks;
+        for(GCHead* h = list->next; h != list; h = h->next){
+            int* p = h->block();
+            p[1] |= GC_COLLECTING;
+            blocks.push_back(p);
+        }
+
+        _GCVisitor subtract{[](int* p, void*){ if(p[1] & GC_COLLECTING) p[0]--; }, nullptr};
+        for(int* p : blocks) __gc_traverse_block(p, subtract);
+
+        std::vector<int*> stack;
+        for(int* p : blocks){
+            if(p[0] > 0){ p[1] |= GC_REACHABLE; stack.push_back(p); }
+        }
+        _GCVisitor mark{[](int* p, void* ctx){
+            if((p[1] & GC_COLLECTING) && !(p[1] & GC_REACHABLE)){
+                p[1] |= GC_REACHABLE;
+                ((std::vector<int*>*)ctx)->push_back(p);
+            }
+        }, &stack};
+        while(!stack.empty()){
+            int* p = stack.back();
+            stack.pop_back();
+            __gc_traverse_block(p, mark);
+        }
+
+        _GCVisitor restore{[](int* p, void*){ if(p[1] & GC_COLLECTING) p[0]++; }, nullptr};
+        for(int* p : blocks) __gc_traverse_block(p, restore);
+
+        // survivors get older, the garbage is held until all of it is cleared
+        GCHead* older = &st.gens[std::min(gen + 1, GCState::N_GENS - 1)];
+        std::vector<shared_ptr<PyObject>> garbage;
+        for(int* p : blocks){
+            bool reachable = p[1] & GC_REACHABLE;
+            p[1] &= ~(GC_COLLECTING | GC_REACHABLE);
+            if(reachable){
+                if(older == list) continue;
+                GCHead* h = (GCHead*)p - 1;
+                h->unlink();
+                h->link(older);
+            }else{
+                p[0]++;
+                garbage.emplace_back(p);
+            }
+        }
+        for(auto& obj : garbage){
+            int* p = (int*)obj.bits();
+            __layouts[p[1] & LAYOUT_MASK].clear(p + 2);
+        }
+
+        for(int i=0; i<=gen; i++) st.counts[i] = 0;
+        if(gen + 1 < GCState::N_GENS) st.counts[gen + 1]++;
+        st.stats[gen].collections++;
+        st.stats[gen].collected += garbage.size();
+        int collected = garbage.size();
+        garbage.clear();
+        st.collecting = false;
+        return collected;
+    }
+
+    // the oldest generation over its threshold, with the younger ones
+    inline int gc_collect_auto(){
+        GCState& st = __gc_state();
+        for(int i=GCState::N_GENS-1; i>0; i--){
+            if(st.counts[i] > st.thresholds[i]) return gc_collect(i);
+        }
+        return gc_collect(0);
+    }
+};
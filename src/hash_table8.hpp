@@ -36,6 +36,11 @@
 #include <iterator>
 #include <algorithm>
 
+#ifndef EMH_MALLOC
+    #define EMH_MALLOC(n) malloc(n)
+    #define EMH_FREE(p) free(p)
+#endif
+
 #ifdef EMH_KEY
     #undef  EMH_KEY
     #undef  EMH_VAL
@@ -282,7 +287,7 @@ public:
             return *this;
 
         if (rhs.load_factor() < EMH_MIN_LOAD_FACTOR) {
-            clear(); free(_pairs); _pairs = nullptr;
+            clear(); EMH_FREE(_pairs); _pairs = nullptr;
             rehash(rhs._num_filled + 2);
             for (auto it = rhs.begin(); it != rhs.end(); ++it)
                 insert_unique(it->first, it->second);
@@ -292,7 +297,7 @@ public:
         clearkv();
 
         if (_num_buckets != rhs._num_buckets) {
-            free(_pairs); free(_index);
+            EMH_FREE(_pairs); EMH_FREE(_index);
             _index = alloc_index(rhs._num_buckets);
             _pairs = alloc_bucket((size_type)(rhs._num_buckets * rhs.max_load_factor()) + 4);
         }
@@ -330,8 +335,8 @@ public:
     ~HashMap() noexcept
     {
         clearkv();
-        free(_pairs);
-        free(_index);
+        EMH_FREE(_pairs);
+        EMH_FREE(_index);
     }
 
     void clone(const HashMap& rhs)
@@ -1066,13 +1071,13 @@ public:
 
     static value_type* alloc_bucket(size_type num_buckets)
     {
-        auto new_pairs = (char*)malloc((uint64_t)num_buckets * sizeof(value_type));
+        auto new_pairs = (char*)EMH_MALLOC((uint64_t)num_buckets * sizeof(value_type));
         return (value_type *)(new_pairs);
     }
 
     static Index* alloc_index(size_type num_buckets)
     {
-        auto new_index = (char*)malloc((uint64_t)(EAD + num_buckets) * sizeof(Index));
+        auto new_index = (char*)EMH_MALLOC((uint64_t)(EAD + num_buckets) * sizeof(Index));
         return (Index *)(new_index);
     }
 
@@ -1112,7 +1117,7 @@ public:
 
     void rebuild(size_type num_buckets) noexcept
     {
-        free(_index);
+        EMH_FREE(_index);
         auto new_pairs = (value_type*)alloc_bucket((size_type)(num_buckets * max_load_factor()) + 4);
         if (is_copy_trivially()) {
             memcpy((char*)new_pairs, (char*)_pairs, _num_filled * sizeof(value_type));
@@ -1123,7 +1128,7 @@ public:
                     _pairs[slot].~value_type();
             }
         }
-        free(_pairs);
+        EMH_FREE(_pairs);
         _pairs = new_pairs;
         _index = (Index*)alloc_index (num_buckets);
 
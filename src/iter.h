@@ -23,27 +23,43 @@ public:
     PyVar next() override;
 };
 
+// the items are looked up through the list each time, a change to it may swap them for a copy
 class VectorIterator : public BaseIterator {
 private:
     size_t index = 0;
-    const PyVarList* vec;
 public:
-    VectorIterator(VM* vm, PyVar _ref) : BaseIterator(vm, _ref) {
-        vec = &UNION_GET(PyVarList, _ref);
+    VectorIterator(VM* vm, PyVar _ref) : BaseIterator(vm, _ref) {}
+
+    bool hasNext(){
+        return index < UNION_GET(_List, _ref)->size();
+    }
+
+    PyVar next(){
+        return UNION_GET(_List, _ref)->operator[](index++);
+    }
+};
+
+class TupleIterator : public BaseIterator {
+private:
+    int index = 0;
+    const PyTupleObject* tuple;
+public:
+    TupleIterator(VM* vm, PyVar _ref) : BaseIterator(vm, _ref) {
+        tuple = (const PyTupleObject*)_ref.get();
     }
 
     bool hasNext(){
-        return index < vec->size();
+        return index < tuple->size();
     }
 
     PyVar next(){
-        return vec->operator[](index++);
+        return tuple->data()[index++];
     }
 };
 
 class StringIterator : public BaseIterator {
 private:
-    int index = 0;
+    size_t pos = 0;         // the byte offset of the next character
     _Str str;
 public:
     StringIterator(VM* vm, PyVar _ref) : BaseIterator(vm, _ref) {
@@ -51,8 +67,45 @@ public:
     }
 
     bool hasNext(){
-        return index < str.u8_length();
+        return pos < str.size();
     }
 
     PyVar next();
 };
+
+// pairs up the items of two iterators and stops at the shorter one, see `zip`
+class ZipIterator : public BaseIterator {
+private:
+    PyVar a, b;
+public:
+    ZipIterator(VM* vm, PyVar a, PyVar b) : BaseIterator(vm, nullptr), a(a), b(b) {}
+
+    bool hasNext() override;
+    PyVar next() override;
+
+    void gc_traverse(const pkpy::_GCVisitor& v) override { v(a); v(b); }
+    void gc_clear() override { a.reset(); b.reset(); }
+};
+
+// a suspended frame of a generator function or a generator expression, see `VM::__resume`
+class Generator : public BaseIterator {
+private:
+    std::unique_ptr<Frame> frame;
+    PyVar value;
+    enum { NEED_VALUE, HAS_VALUE, DONE } state = NEED_VALUE;
+public:
+    Generator(VM* vm, std::unique_ptr<Frame>&& frame) : BaseIterator(vm, nullptr), frame(std::move(frame)) {}
+
+    bool hasNext() override;
+    PyVar next() override;
+
+    void gc_traverse(const pkpy::_GCVisitor& v) override {
+        if(frame != nullptr) frame->gc_traverse(v);
+        v(value);
+    }
+    void gc_clear() override {
+        frame.reset();
+        value.reset();
+        state = DONE;
+    }
+};
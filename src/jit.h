@@ -0,0 +1,193 @@
+#pragma once
+
+#include "vm.h"
+
+// A baseline template JIT for x86-64 Linux, enabled by PKPY_ENABLE_JIT.
+//
+// A code object becomes hot after PKPY_JIT_THRESHOLD calls and loop back-edges. It is then
+// compiled into one native stub per bytecode. Each stub calls `VM::__jit_step<op>`, the interpreter
+// specialized to that opcode, so the frame and its value stack keep their layout. Jumps with static
+// targets are native jumps, everything else goes through `JitCode::table`.
+// The table maps every bytecode index to its stub, so a frame can enter the native code at any
+// point: after a python call returns, or from the interpreter in the middle of a loop (OSR).
+//
+// Building with -DPKPY_ENABLE_JIT -DPKPY_JIT_THRESHOLD=0 runs everything through the JIT.
+
+#ifdef PKPY_ENABLE_JIT
+
+#include <sys/mman.h>
+
+struct JitContext {
+    PyVar ret;
+    std::exception_ptr error;   // errors can't unwind through native frames
+};
+
+// rdi = vm, rsi = frame, rdx = ctx, ecx = index of the bytecode
+// returns the next index, -1 when `ctx->ret` is set or -2 when `ctx->error` is set
+typedef int (*__JitFn)(VM*, Frame*, JitContext*, int);
+
+struct JitCode {
+    uint8_t* mem = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t*> table;    // stub of each bytecode, plus one for the end of the code
+
+    __JitFn entry() const { return (__JitFn)mem; }
+
+    ~JitCode(){
+        if(mem != nullptr) munmap(mem, size);
+    }
+};
+
+template<int __op>
+int VM::__jit_step(VM* vm, Frame* frame, JitContext* ctx, int ip){
+    try{
+        frame->jump_abs(ip);
+        PyVar ret = vm->__run_frame<__op>(frame);
+        if(ret == nullptr) return frame->next_index();
+        ctx->ret = std::move(ret);
+        return -1;
+    }catch(...){
+        ctx->error = std::current_exception();
+        return -2;
+    }
+}
+
+class JitAssembler {
+    std::vector<uint8_t> buf;
+    std::vector<int> stubs;                         // offset of each stub
+    std::vector<std::pair<int, int>> fixups;        // (offset of a rel32, target stub)
+    int dispatch = -1;
+    int exit = -1;
+
+    static const int DISPATCH = -1;
+    static const int EXIT = -2;
+
+    void emit(std::initializer_list<uint8_t> bytes){ buf.insert(buf.end(), bytes); }
+
+    void emit32(int32_t v){
+        uint8_t b[4]; memcpy(b, &v, 4);
+        buf.insert(buf.end(), b, b+4);
+    }
+
+    void emit64(uint64_t v){
+        uint8_t b[8]; memcpy(b, &v, 8);
+        buf.insert(buf.end(), b, b+8);
+    }
+
+    // `opcode` is one of jmp (e9) or jcc (0f 8x), followed by a rel32 to `target`
+    void emit_jump(std::initializer_list<uint8_t> opcode, int target){
+        emit(opcode);
+        fixups.push_back({(int)buf.size(), target});
+        emit32(0);
+    }
+
+    void emit_call(void* helper, int ip){
+        emit({0x48, 0x89, 0xdf});               // mov rdi, rbx
+        emit({0x4c, 0x89, 0xe6});               // mov rsi, r12
+        emit({0x4c, 0x89, 0xea});               // mov rdx, r13
+        emit({0xb9}); emit32(ip);               // mov ecx, ip
+        emit({0x48, 0xb8}); emit64((uint64_t)helper);   // movabs rax, helper
+        emit({0xff, 0xd0});                     // call rax
+    }
+
+    void emit_cmp_je(int value, int target){
+        emit({0x3d}); emit32(value);            // cmp eax, value
+        emit_jump({0x0f, 0x84}, target);        // je target
+    }
+
+    int __offset_of(int target) const {
+        if(target == DISPATCH) return dispatch;
+        if(target == EXIT) return exit;
+        return stubs[target];
+    }
+
+public:
+    std::shared_ptr<JitCode> compile(const CodeObject* co, void* const* helpers, void* end_helper){
+        const std::vector<Bytecode>& code = co->co_code;
+        auto jit = std::make_shared<JitCode>();
+        jit->table.resize(code.size() + 1);
+
+        // prologue, the three pushes keep rsp 16-byte aligned for the calls
+        emit({0x53});                           // push rbx
+        emit({0x41, 0x54});                     // push r12
+        emit({0x41, 0x55});                     // push r13
+        emit({0x48, 0x89, 0xfb});               // mov rbx, rdi
+        emit({0x49, 0x89, 0xf4});               // mov r12, rsi
+        emit({0x49, 0x89, 0xd5});               // mov r13, rdx
+        emit({0x89, 0xc8});                     // mov eax, ecx
+
+        dispatch = buf.size();
+        emit({0x85, 0xc0});                     // test eax, eax
+        emit_jump({0x0f, 0x88}, EXIT);          // js exit
+        emit({0x48, 0xb9}); emit64((uint64_t)jit->table.data());  // movabs rcx, table
+        emit({0xff, 0x24, 0xc1});               // jmp [rcx + rax*8]
+
+        exit = buf.size();
+        emit({0x41, 0x5d});                     // pop r13
+        emit({0x41, 0x5c});                     // pop r12
+        emit({0x5b});                           // pop rbx
+        emit({0xc3});                           // ret
+
+        for(int i=0; i<code.size(); i++){
+            const Bytecode& byte = code[i];
+            stubs.push_back(buf.size());
+            switch(byte.op){
+                case OP_NO_OP: break;
+                case OP_JUMP_ABSOLUTE: emit_jump({0xe9}, byte.arg); break;
+                case OP_LOOP_CONTINUE: emit_jump({0xe9}, co->co_blocks[byte.block].start); break;
+                default: {
+                    emit_call(helpers[byte.op], i);
+                    int target = -1;
+                    switch(byte.op){
+                        case OP_POP_JUMP_IF_FALSE: case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+                            target = byte.arg; break;
+                        case OP_FOR_ITER: case OP_LOOP_BREAK:
+                            target = co->co_blocks[byte.block].end; break;
+                    }
+                    if(target >= 0 && target <= code.size()) emit_cmp_je(target, target);
+                    emit({0x3d}); emit32(i+1);          // cmp eax, i+1
+                    emit_jump({0x0f, 0x85}, DISPATCH);  // jne dispatch
+                } break;
+            }
+        }
+        // the end of the code checks the stack and returns
+        stubs.push_back(buf.size());
+        emit_call(end_helper, code.size());
+        emit_jump({0xe9}, DISPATCH);
+
+        for(auto& [at, target] : fixups){
+            int32_t rel = __offset_of(target) - (at + 4);
+            memcpy(&buf[at], &rel, 4);
+        }
+
+        jit->size = buf.size();
+        void* mem = mmap(nullptr, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(mem == MAP_FAILED) return nullptr;
+        jit->mem = (uint8_t*)mem;
+        memcpy(jit->mem, buf.data(), buf.size());
+        if(mprotect(jit->mem, jit->size, PROT_READ | PROT_EXEC) != 0) return nullptr;
+        for(int i=0; i<stubs.size(); i++) jit->table[i] = jit->mem + stubs[i];
+        return jit;
+    }
+};
+
+void VM::__jit_compile(CodeObject* code){
+    static void* const helpers[] = {
+        #define OPCODE(name) (void*)&VM::__jit_step<OP_##name>,
+        #include "opcodes.h"
+        #undef OPCODE
+    };
+    // the interpreter runs no bytecode at the end of the code and just returns
+    code->co_jit = JitAssembler().compile(code, helpers, (void*)&VM::__jit_step<-1>);
+    // never retry a code object that failed to compile
+    if(code->co_jit == nullptr) code->co_hotness = INT32_MIN;
+}
+
+PyVar VM::__jit_run(Frame* frame){
+    JitContext ctx;
+    int status = frame->code->co_jit->entry()(this, frame, &ctx, frame->next_index());
+    if(status == -2) std::rethrow_exception(ctx.error);
+    return ctx.ret;
+}
+
+#endif
@@ -3,6 +3,10 @@
 
 #include "pocketpy.h"
 
+#ifdef PKPY_AOT_MODULES
+#include PKPY_AOT_MODULES
+#endif
+
 #define PK_DEBUG_TIME
 //#define PK_DEBUG_THREADED
 
@@ -95,13 +99,57 @@ int main(int argc, char** argv){
             vm->exec(src.c_str(), filename, EXEC_MODE);
         });
 #endif
+#ifdef PKPY_COUNT_INSTRUCTIONS
+        std::cout << "Instructions: " << vm->_instructions << std::endl;
+#endif
+
+        pkpy_delete(vm);
+        return 0;
+    }
+
+    if(argc == 4 && std::string(argv[1]) == "--arena"){
+        std::string filename = argv[3];
+        std::ifstream file(filename);
+        if(!file.is_open()){
+            std::cerr << "File not found: " << filename << std::endl;
+            return 1;
+        }
+        std::string src((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
 
+        VM* vm = pkpy_new_vm_with_arena(true, std::stoll(argv[2]));
+        int code = vm->exec(src.c_str(), filename, EXEC_MODE) == nullptr ? 1 : 0;
+        std::cout << "Peak memory: " << vm->arena()->peak << " bytes" << std::endl;
+        pkpy_delete(vm);
+        return code;
+    }
+
+    if(argc == 4 && std::string(argv[1]) == "--aot"){
+        std::string filename = argv[2];
+        std::ifstream file(filename);
+        if(!file.is_open()){
+            std::cerr << "File not found: " << filename << std::endl;
+            return 1;
+        }
+        std::string src((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        VM* vm = pkpy_new_vm(true);
+        try{
+            std::cout << AotTranspiler(vm, argv[3]).transpile(src, filename);
+        }catch(const _Error& e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }catch(const std::exception& e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
         pkpy_delete(vm);
         return 0;
     }
 
 __HELP:
     std::cout << "Usage: pocketpy [filename]" << std::endl;
+    std::cout << "       pocketpy --arena <bytes> <filename>" << std::endl;
+    std::cout << "       pocketpy --aot <filename> <module>" << std::endl;
     return 0;
 }
 
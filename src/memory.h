@@ -2,14 +2,487 @@
 
 #include "__stl__.h"
 
+struct PyObject;
+inline PyObject* __tagged_object(uintptr_t bits);    // see obj.h
+
 namespace pkpy{
+    // small ints, most floats, None and bools live in the pointer word of a `shared_ptr<PyObject>`
+    // and are never allocated or counted. Blocks from malloc() leave the low two bits 0.
+    const uintptr_t TAG_MASK = 0b11;
+    const uintptr_t TAG_INT = 0b01;         // a 62-bit int, see `VM::PyInt`
+    const uintptr_t TAG_FLOAT = 0b10;       // a float with a 9-bit exponent, see `VM::PyFloat`
+    const uintptr_t TAG_SPECIAL = 0b11;
+    const uintptr_t TAGGED_NONE = 0b0011;
+    const uintptr_t TAGGED_FALSE = 0b0111;
+    const uintptr_t TAGGED_TRUE = 0b1011;
+
+    // a count no references ever reach, blocks at or above it are immortal: they are never
+    // counted nor freed, see `ImmortalSet`
+    const int IMMORTAL = 1 << 29;
+
+    // blocks up to `MAX_POOLED` bytes come from free lists of 16-byte size classes, carved out of
+    // 64KB slabs. Each thread has its own lists, so a VM allocates without a lock from its thread.
+    // Slabs are never given back, the free lists of a finished thread are left to the next one.
+    struct PoolStats {
+        int64_t allocs = 0;         // blocks handed out, from the pool or malloc()
+        int64_t frees = 0;
+        int64_t large = 0;          // blocks too big for a size class, they use malloc()
+        int64_t slab_bytes = 0;
+        int64_t by_class[16] = {};  // blocks handed out by size class, 16 bytes apart
+        int64_t deferred = 0;       // releases queued instead of run, see `FreeQueue`
+    };
+
+    // releasing the last reference to a big structure releases everything it holds, one `~T()`
+    // inside another. Past `MAX_DEPTH` nested releases, or `budget` releases in one go, blocks wait
+    // in a queue instead, each owing one decrement, which safepoints drain `budget` at a time.
+    // A list longer than the budget queues its items rather than releasing them itself.
+    struct FreeQueue {
+        static const int MAX_DEPTH = 64;
+        static const int MIN_DEFERRED_ITEMS = 256;     // shorter lists never look at the budget
+        int budget = 4096;          // 0 for no limit, only depth defers then
+        int depth = 0;
+        int work = 0;               // releases since the outermost one began
+        std::vector<int*> blocks;
+    };
+
+    inline void __drain_frees(int budget);      // see below
+
+    // raised by an arena past its quota, a script sees it as a MemoryError, see `VM::exec`
+    struct MemoryError : std::runtime_error {
+        using std::runtime_error::runtime_error;
+    };
+
+    inline std::atomic<uint64_t> __arena_serials{0};
+
+    // an opt-in region of memory a VM allocates all its blocks from, see `VM(bool, size_t)`.
+    // It is carved like the pool, small blocks by size class and bigger ones by powers of two, each
+    // with its own free list. A freed block goes back to its arena whichever one is current, and
+    // deleting the arena gives all of it back in one go. Past `quota` bytes in use, allocating throws.
+    // The contents of strs, lists and dicts are malloc'd but count as in use, see `__charged_alloc`
+    class Arena {
+        static const int GRANULARITY = 16;
+        static const int N_CLASSES = 16;
+        static const int N_LARGE = 48;
+
+        struct FreeBlock { FreeBlock* next; };
+        FreeBlock* small_lists[N_CLASSES] = {};
+        FreeBlock* large_lists[N_LARGE] = {};
+        char* base;
+        char* top;                  // the rest has never been handed out
+        char* end;
+
+        inline FreeBlock** list_of(size_t size, size_t& bytes){
+            if(size <= GRANULARITY * N_CLASSES){
+                int c = (size - 1) / GRANULARITY;
+                bytes = (c + 1) * GRANULARITY;
+                return &small_lists[c];
+            }
+            int k = 9;
+            while(((size_t)1 << k) < size) k++;
+            bytes = (size_t)1 << k;
+            return &large_lists[k];
+        }
+
+    public:
+        static const int MAX_ARENAS = 64;
+        const uint64_t serial = ++__arena_serials;      // never reused, unlike the address
+        size_t used = 0;
+        size_t peak = 0;
+        size_t quota;
+
+        Arena(size_t capacity) : quota(capacity) {
+            base = top = (char*)malloc(capacity);
+            if(base == nullptr) throw std::bad_alloc();
+            end = base + capacity;
+        }
+        ~Arena(){ free(base); }
+
+        inline size_t capacity() const { return end - base; }
+        inline bool owns(const void* p) const { return p >= base && p < end; }
+
+        inline void* alloc(size_t size){
+            size_t bytes;
+            FreeBlock** list = list_of(size, bytes);
+            if(used + bytes > quota) throw MemoryError("memory quota of " + std::to_string(quota) + " bytes exceeded");
+            void* p;
+            if(*list != nullptr){
+                p = *list;
+                *list = (*list)->next;
+            }else{
+                if(bytes > (size_t)(end - top)) throw MemoryError("arena of " + std::to_string(capacity()) + " bytes exhausted");
+                p = top;
+                top += bytes;
+            }
+            used += bytes;
+            if(used > peak) peak = used;
+            return p;
+        }
+
+        // counts `bytes` malloc'd elsewhere, only a `strict` charge may throw
+        inline void charge(size_t bytes, bool strict){
+            if(strict && used + bytes > quota) throw MemoryError("memory quota of " + std::to_string(quota) + " bytes exceeded");
+            used += bytes;
+            if(used > peak) peak = used;
+        }
+        inline void discharge(size_t bytes){ used -= bytes; }
+
+        inline void dealloc(void* p, size_t size){
+            size_t bytes;
+            FreeBlock** list = list_of(size, bytes);
+            FreeBlock* b = (FreeBlock*)p;
+            b->next = *list;
+            *list = b;
+            used -= bytes;
+        }
+    };
+
+    // the live arenas of all threads, so a block finds its own wherever it is freed
+    inline std::atomic<Arena*> __arenas[Arena::MAX_ARENAS];
+    inline std::atomic<int> __arenas_live{0};
+
+    inline Arena* __arena_of(const void* p){
+        for(int i=0; i<Arena::MAX_ARENAS; i++){
+            Arena* a = __arenas[i].load(std::memory_order_acquire);
+            if(a != nullptr && a->owns(p)) return a;
+        }
+        return nullptr;
+    }
+
+    struct GCState;
+    struct WeakTable;
+
+    class MemoryPool {
+        static const int GRANULARITY = 16;
+        static const int N_CLASSES = 16;
+        static const int SLAB_SIZE = 64 * 1024;
+
+        struct FreeBlock { FreeBlock* next; };
+        FreeBlock* free_lists[N_CLASSES] = {};
+
+        inline static std::mutex __orphans_lock;
+        inline static FreeBlock* __orphans[N_CLASSES] = {};
+
+        void refill(int c){
+            {
+                std::lock_guard<std::mutex> lock(__orphans_lock);
+                if(__orphans[c] != nullptr){
+                    std::swap(free_lists[c], __orphans[c]);
+                    return;
+                }
+            }
+            int size = (c + 1) * GRANULARITY;
+            char* slab = (char*)malloc(SLAB_SIZE);
+            for(int i = SLAB_SIZE / size - 1; i >= 0; i--){
+                FreeBlock* b = (FreeBlock*)(slab + i * size);
+                b->next = free_lists[c];
+                free_lists[c] = b;
+            }
+            stats.slab_bytes += SLAB_SIZE;
+        }
+
+    public:
+        static const int MAX_POOLED = GRANULARITY * N_CLASSES;
+        PoolStats stats;
+        FreeQueue frees;
+        Arena* arena = nullptr;         // where blocks come from instead, see `ArenaScope`
+        GCState* gc = nullptr;          // the collector and weak references of the current VM,
+        WeakTable* weak = nullptr;      // nullptr for those of the thread, see `HeapScope`
+
+        inline void* alloc(size_t size){
+            if(arena != nullptr){
+                void* p = arena->alloc(size);
+                stats.allocs++;
+                if(size <= MAX_POOLED) stats.by_class[(size - 1) / GRANULARITY]++;
+                else stats.large++;
+                return p;
+            }
+            stats.allocs++;
+#ifndef PKPY_NO_POOL
+            if(size <= MAX_POOLED){
+                int c = (size - 1) / GRANULARITY;
+                if(free_lists[c] == nullptr) refill(c);
+                FreeBlock* b = free_lists[c];
+                free_lists[c] = b->next;
+                stats.by_class[c]++;
+                return b;
+            }
+#endif
+            stats.large++;
+            return malloc(size);
+        }
+
+        inline void dealloc(void* p, size_t size){
+            stats.frees++;
+            if(__arenas_live.load(std::memory_order_relaxed) != 0){
+                Arena* a = (arena != nullptr && arena->owns(p)) ? arena : __arena_of(p);
+                if(a != nullptr){ a->dealloc(p, size); return; }
+            }
+#ifndef PKPY_NO_POOL
+            if(size <= MAX_POOLED){
+                int c = (size - 1) / GRANULARITY;
+                FreeBlock* b = (FreeBlock*)p;
+                b->next = free_lists[c];
+                free_lists[c] = b;
+                return;
+            }
+#endif
+            free(p);
+        }
+
+        ~MemoryPool(){
+            __drain_frees(0);
+            std::lock_guard<std::mutex> lock(__orphans_lock);
+            for(int c=0; c<N_CLASSES; c++){
+                while(free_lists[c] != nullptr){
+                    FreeBlock* b = free_lists[c];
+                    free_lists[c] = b->next;
+                    b->next = __orphans[c];
+                    __orphans[c] = b;
+                }
+            }
+        }
+    };
+
+    inline thread_local MemoryPool __pool;
+
+    // in front of every charged block, the arena is looked up by serial as it may be gone
+    struct ChargeHeader {
+        uint64_t serial;            // 0 if no arena was current
+        size_t size;
+    };
+
+    inline void* __charged_alloc(size_t size, bool strict){
+        Arena* arena = __pool.arena;
+        if(arena != nullptr) arena->charge(size, strict);
+        ChargeHeader* h = (ChargeHeader*)malloc(sizeof(ChargeHeader) + size);
+        if(h == nullptr){
+            if(arena != nullptr) arena->discharge(size);
+            if(strict) throw std::bad_alloc();
+            return nullptr;
+        }
+        h->serial = arena != nullptr ? arena->serial : 0;
+        h->size = size;
+        return h + 1;
+    }
+
+    inline void __charged_free(void* p){
+        if(p == nullptr) return;
+        ChargeHeader* h = (ChargeHeader*)p - 1;
+        if(h->serial != 0 && __arenas_live.load(std::memory_order_relaxed) != 0){
+            for(int i=0; i<Arena::MAX_ARENAS; i++){
+                Arena* a = __arenas[i].load(std::memory_order_acquire);
+                if(a != nullptr && a->serial == h->serial){ a->discharge(h->size); break; }
+            }
+        }
+        free(h);
+    }
+
+    // for the items of a `PyVarList`
+    template <typename T>
+    struct charged_allocator {
+        using value_type = T;
+        charged_allocator() = default;
+        template <typename U> charged_allocator(const charged_allocator<U>&) {}
+        T* allocate(size_t n){ return (T*)__charged_alloc(n * sizeof(T), true); }
+        void deallocate(T* p, size_t){ __charged_free(p); }
+        template <typename U> bool operator==(const charged_allocator<U>&) const { return true; }
+        template <typename U> bool operator!=(const charged_allocator<U>&) const { return false; }
+    };
+
+    // objects which may reference others are linked into the lists of the cycle collector,
+    // by a head in front of their block, see gc.h
+    struct GCHead {
+        GCHead* next;
+        GCHead* prev;
+
+        inline void link(GCHead* list){
+            next = list->next; prev = list;
+            list->next->prev = this; list->next = this;
+        }
+        inline void unlink(){
+            prev->next = next; next->prev = prev;
+        }
+        inline int* block() { return (int*)(this + 1); }
+    };
+
+    struct GCGenStats {
+        int64_t collections = 0;
+        int64_t collected = 0;
+    };
+
+    // the collector of a VM, or of a thread for objects made outside any VM. The lists are
+    // detached when it goes, an object released later unlinks itself from no list
+    struct GCState {
+        static const int N_GENS = 3;
+        GCHead* gens = new GCHead[N_GENS];
+        int thresholds[N_GENS] = {700, 10, 10};
+        int counts[N_GENS] = {0, 0, 0};     // new objects, then collections of the younger generation
+        bool enabled = true;
+        bool collecting = false;
+        GCGenStats stats[N_GENS];
+
+        GCState(){
+            for(int i=0; i<N_GENS; i++) gens[i].next = gens[i].prev = &gens[i];
+        }
+        GCState(const GCState&) = delete;
+        GCState& operator=(const GCState&) = delete;
+
+        ~GCState(){
+            for(int i=0; i<N_GENS; i++){
+                for(GCHead* h = gens[i].next; h != &gens[i]; ){
+                    GCHead* next = h->next;
+                    h->next = h->prev = h;
+                    h = next;
+                }
+            }
+            delete[] gens;
+        }
+
+        inline bool should_collect() const {
+            return enabled && !collecting && thresholds[0] > 0 && counts[0] > thresholds[0];
+        }
+    };
+
+    inline thread_local GCState __gc;
+
+    inline GCState& __gc_state(){
+        GCState* gc = __pool.gc;
+        return gc != nullptr ? *gc : __gc;
+    }
+
+    inline int gc_collect_auto();       // see gc.h
+    inline int gc_collect(int gen);
+
+    struct _GCVisitor;
+
+    // objects carry no vtable, a block remembers how to destroy and release what it holds instead
+    struct _BlockLayout {
+        void (*dtor)(void*);
+        size_t size;
+        void (*traverse)(void*, const _GCVisitor&);     // only for objects with a `GCHead`
+        void (*clear)(void*);
+        size_t (*var_size)(const void*);                // the bytes after a variable-length object
+    };
+    const int MAX_LAYOUTS = 256;
+    const int LAYOUT_MASK = 0xffff;         // the collector keeps its marks above, see gc.h
+    const int OBJECT_BITS_SHIFT = 16;       // 8 bits above the layout id belong to the object itself
+    const int WEAKLY_REFERENCED = 1 << 28;  // the block has a `WeakSlot`
+    inline _BlockLayout __layouts[MAX_LAYOUTS];
+    inline std::atomic<int> __layouts_count{0};
+
+    template <typename U>
+    void __destroy(void* p){ ((U*)p)->~U(); }
+
+    // the bits an object keeps in the layout word of its block, in front of it
+    inline int __object_bits(const void* obj){
+        return (((const int*)obj)[-1] >> OBJECT_BITS_SHIFT) & 0xff;
+    }
+    inline void __set_object_bits(void* obj, int bits){
+        int& word = ((int*)obj)[-1];
+        word = (word & ~(0xff << OBJECT_BITS_SHIFT)) | (bits << OBJECT_BITS_SHIFT);
+    }
+
+    // defined by the collector for every layout of `PyObject` which is tracked, see gc.h
+    template <typename U> void __gc_traverse(void* p, const _GCVisitor& v);
+    template <typename U> void __gc_clear(void* p);
+    template <typename U> inline constexpr bool __gc_tracked = false;
+
+    // a variable-length object is followed by `U::var_size()` more bytes in its block
+    template <typename U> inline constexpr bool __var_sized = false;
+    template <typename U> size_t __var_size(const void* p){ return ((const U*)p)->var_size(); }
+
+    template <typename U, bool GC>
+    int __layout_id(){
+        static const int id = [](){
+            int i = __layouts_count++;
+            if(i >= MAX_LAYOUTS) throw std::runtime_error("too many object layouts");
+            if constexpr(GC){
+                __layouts[i] = {&__destroy<U>, sizeof(GCHead) + sizeof(int) * 2 + sizeof(U), &__gc_traverse<U>, &__gc_clear<U>, nullptr};
+            }else{
+                __layouts[i] = {&__destroy<U>, sizeof(int) * 2 + sizeof(U), nullptr, nullptr, nullptr};
+            }
+            if constexpr(__var_sized<U>) __layouts[i].var_size = &__var_size<U>;
+            return i;
+        }();
+        return id;
+    }
+
+    // a block is `{int counter; int layout_id;}` followed by the object, 8 bytes in all,
+    // and by `var_size` more bytes if the object has a variable length
+    template <typename U, bool GC, typename... Args>
+    inline int* __new_block(size_t var_size, Args&&... args){
+        int* p;
+        if constexpr(GC){
+            GCHead* head = (GCHead*)__pool.alloc(sizeof(GCHead) + sizeof(int) * 2 + sizeof(U) + var_size);
+            GCState& gc = __gc_state();
+            head->link(&gc.gens[0]);
+            gc.counts[0]++;
+            p = head->block();
+        }else{
+            p = (int*)__pool.alloc(sizeof(int) * 2 + sizeof(U) + var_size);
+        }
+        p[0] = 1;
+        p[1] = __layout_id<U, GC>();
+        new(p+2) U(std::forward<Args>(args)...);
+        return p;
+    }
+
+    inline void __weak_clear(int* p);       // see below
+
+    inline void __release_block(int* p){
+        if(p[1] & WEAKLY_REFERENCED) __weak_clear(p);
+        const _BlockLayout& layout = __layouts[p[1] & LAYOUT_MASK];
+        size_t size = layout.size;
+        if(layout.var_size != nullptr) size += layout.var_size(p + 2);
+        layout.dtor(p + 2);
+        if(layout.traverse != nullptr){
+            GCHead* head = (GCHead*)p - 1;
+            head->unlink();
+            __pool.dealloc(head, size);
+        }else{
+            __pool.dealloc(p, size);
+        }
+    }
+
+    inline void __free_block(int* p){
+        MemoryPool& pool = __pool;
+        FreeQueue& q = pool.frees;
+        if(q.depth >= FreeQueue::MAX_DEPTH || (q.budget > 0 && q.work >= q.budget)){
+            p[0] = 1;
+            q.blocks.push_back(p);
+            pool.stats.deferred++;
+            return;
+        }
+        q.depth++; q.work++;
+        __release_block(p);
+        if(--q.depth == 0) q.work = 0;
+    }
+
+    // pays the decrements of queued blocks until `budget` of them, and the releases they cause,
+    // are done, or all of them for a budget of 0. What is released past the budget is queued again.
+    inline void __drain_frees(int budget){
+        FreeQueue& q = __pool.frees;
+        if(q.blocks.empty() || q.depth > 0) return;
+        int saved = q.budget;
+        q.budget = budget;
+        q.depth = 1;
+        while(!q.blocks.empty() && (budget <= 0 || q.work < budget)){
+            int* p = q.blocks.back();
+            q.blocks.pop_back();
+            q.work++;
+            if(--p[0] == 0) __release_block(p);
+        }
+        q.depth = q.work = 0;
+        q.budget = saved;
+    }
+
     template <typename T>
     class shared_ptr {
         int* counter = nullptr;
 
-#define _t() ((T*)(counter + 1))
-#define _inc_counter() if(counter) ++(*counter)
-#define _dec_counter() if(counter && --(*counter) == 0){ _t()->~T(); free(counter); }
+#define _t() ((T*)(counter + 2))
+#define _inc_counter() if(is_counted()) ++(*counter)
+#define _dec_counter() if(is_counted() && --(*counter) == 0) __free_block(counter)
 
     public:
         shared_ptr() {}
@@ -59,16 +532,42 @@ namespace pkpy{
         }
 
         T& operator*() const {
-            return *_t();
+            return *get();
         }
         T* operator->() const {
-            return _t();
+            return get();
         }
+        // a tagged value has no object, it gets a shared stand-in which only knows its type
         T* get() const {
+            if constexpr(std::is_same_v<T, PyObject>){
+                if(is_tagged()) return __tagged_object(bits());
+            }
             return _t();
         }
         int use_count() const {
-            return counter ? *counter : 0;
+            return is_heap() ? *counter : 0;
+        }
+        // gives up the reference without releasing it, the caller owes the decrement
+        int* detach(){
+            int* p = counter;
+            counter = nullptr;
+            return p;
+        }
+
+        static shared_ptr from_bits(uintptr_t bits){ return shared_ptr((int*)bits); }
+        // one more reference to a block only known by its address
+        static shared_ptr share(int* block){
+            shared_ptr p(block);
+            if(p.is_counted()) ++(*block);
+            return p;
+        }
+        inline uintptr_t bits() const { return (uintptr_t)counter; }
+        inline bool is_tagged() const { return ((uintptr_t)counter & TAG_MASK) != 0; }
+        inline bool is_heap() const { return counter != nullptr && !is_tagged(); }
+        // only objects are ever immortal, other blocks skip the check
+        inline bool is_counted() const {
+            if constexpr(std::is_same_v<T, PyObject>) return is_heap() && *counter < IMMORTAL;
+            else return is_heap();
         }
         void reset(){
             _dec_counter();
@@ -83,17 +582,245 @@ namespace pkpy{
     template <typename T, typename U, typename... Args>
     shared_ptr<T> make_shared(Args&&... args) {
         static_assert(std::is_base_of<T, U>::value, "U must be derived from T");
-        int* p = (int*)malloc(sizeof(int) + sizeof(U));
-        *p = 1;
-        new(p+1) U(std::forward<Args>(args)...);
-        return shared_ptr<T>(p);
+        constexpr bool gc = std::is_same_v<T, PyObject> && __gc_tracked<U>;
+        return shared_ptr<T>(__new_block<U, gc>(0, std::forward<Args>(args)...));
+    }
+
+    // `U` has a variable length, `var_size` more bytes follow it, see `__var_sized`
+    template <typename T, typename U, typename... Args>
+    shared_ptr<T> make_var_shared(size_t var_size, Args&&... args) {
+        static_assert(__var_sized<U>, "U must have a variable length");
+        constexpr bool gc = std::is_same_v<T, PyObject> && __gc_tracked<U>;
+        return shared_ptr<T>(__new_block<U, gc>(var_size, std::forward<Args>(args)...));
     }
 
     template <typename T, typename... Args>
     shared_ptr<T> make_shared(Args&&... args) {
-        int* p = (int*)malloc(sizeof(int) + sizeof(T));
-        *p = 1;
-        new(p+1) T(std::forward<Args>(args)...);
-        return shared_ptr<T>(p);
+        return shared_ptr<T>(__new_block<T, false>(0, std::forward<Args>(args)...));
+    }
+
+    // what the weak references to a block share. It loses the block when the block is released,
+    // by whichever VM or thread releases it
+    struct WeakSlot {
+        int* block;
+        std::vector<void*> watchers;        // the weak references with a callback, see `_WeakRef`
+        WeakSlot(int* block) : block(block) {}
+    };
+
+    struct WeakTable;
+    inline std::mutex __weak_tables_lock;
+    inline std::vector<WeakTable*> __weak_tables;
+
+    // the slots a VM made by block, and the released ones whose callbacks are yet to run there.
+    // The tables are listed, for a block released outside the VM holding its slot
+    struct WeakTable {
+        emhash8::HashMap<int*, shared_ptr<WeakSlot>> slots;
+        std::vector<shared_ptr<WeakSlot>> released;
+
+        WeakTable(){
+            std::lock_guard<std::mutex> lock(__weak_tables_lock);
+            __weak_tables.push_back(this);
+        }
+        WeakTable(const WeakTable&) = delete;
+        WeakTable& operator=(const WeakTable&) = delete;
+
+        ~WeakTable(){
+            std::lock_guard<std::mutex> lock(__weak_tables_lock);
+            __weak_tables.erase(std::find(__weak_tables.begin(), __weak_tables.end(), this));
+        }
+
+        // the blocks outlive the table, their weak references see them gone
+        void drop(){
+            for(auto& [p, slot] : slots) slot->block = nullptr;
+            slots.clear();
+            released.clear();
+        }
+    };
+
+    inline thread_local WeakTable __weak;
+
+    inline WeakTable& __weak_table(){
+        WeakTable* t = __pool.weak;
+        return t != nullptr ? *t : __weak;
+    }
+
+    // the slot of a weakly referenced block, in the current table unless it was made elsewhere
+    inline shared_ptr<WeakSlot>* __weak_find(int* p, WeakTable*& owner){
+        owner = &__weak_table();
+        shared_ptr<WeakSlot>* it = owner->slots.try_get(p);
+        if(it != nullptr) return it;
+        std::lock_guard<std::mutex> lock(__weak_tables_lock);
+        for(WeakTable* t : __weak_tables){
+            if(t == owner) continue;
+            it = t->slots.try_get(p);
+            if(it != nullptr){ owner = t; return it; }
+        }
+        return nullptr;
+    }
+
+    inline shared_ptr<WeakSlot> __weak_slot(int* p){
+        WeakTable* owner;
+        if(p[1] & WEAKLY_REFERENCED){
+            shared_ptr<WeakSlot>* it = __weak_find(p, owner);
+            if(it != nullptr) return *it;
+        }
+        p[1] |= WEAKLY_REFERENCED;
+        shared_ptr<WeakSlot> slot = make_shared<WeakSlot>(p);
+        __weak_table().slots.insert_unique(p, slot);
+        return slot;
+    }
+
+    inline void __weak_clear(int* p){
+        p[1] &= ~WEAKLY_REFERENCED;
+        WeakTable* owner;
+        shared_ptr<WeakSlot>* it = __weak_find(p, owner);
+        if(it == nullptr) return;
+        shared_ptr<WeakSlot> slot = std::move(*it);
+        owner->slots.erase(p);
+        slot->block = nullptr;
+        if(!slot->watchers.empty()) owner->released.push_back(std::move(slot));
+    }
+
+    // makes `arena` where this thread allocates from, nullptr for the pool, until the scope ends
+    struct ArenaScope {
+        Arena* saved;
+        ArenaScope(Arena* arena) : saved(__pool.arena) { __pool.arena = arena; }
+        ~ArenaScope(){ __pool.arena = saved; }
+    };
+
+    inline Arena* __new_arena(size_t capacity){
+        Arena* arena = new Arena(capacity);
+        for(int i=0; i<Arena::MAX_ARENAS; i++){
+            Arena* expected = nullptr;
+            if(__arenas[i].compare_exchange_strong(expected, arena)){
+                __arenas_live++;
+                return arena;
+            }
+        }
+        delete arena;
+        throw std::runtime_error("too many arenas");
+    }
+
+    // gives an arena back at once. Whatever in it is still linked into the current collector,
+    // garbage the collector missed or immortals, is unlinked first
+    inline void __delete_arena(Arena* arena){
+        ArenaScope scope(arena);
+        __drain_frees(0);
+        GCState& gc = __gc_state();
+        for(int i=0; i<GCState::N_GENS; i++){
+            GCHead* list = &gc.gens[i];
+            for(GCHead* h = list->next; h != list; ){
+                GCHead* next = h->next;
+                if(arena->owns(h)) h->unlink();
+                h = next;
+            }
+        }
+        for(int i=0; i<Arena::MAX_ARENAS; i++){
+            Arena* expected = arena;
+            if(__arenas[i].compare_exchange_strong(expected, nullptr)){
+                __arenas_live--;
+                break;
+            }
+        }
+        delete arena;
+    }
+
+    // the memory of a VM: its arena if it has one, its collector and its weak references. They are
+    // current whenever the VM runs, on whichever thread, see `HeapScope`. It is the first member
+    // of the VM, so it goes last, once the rest of the VM was destroyed with it current
+    struct Heap {
+        Arena* arena = nullptr;
+        GCState gc;
+        WeakTable weak;
+
+        Arena* saved_arena = nullptr;
+        GCState* saved_gc = nullptr;
+        WeakTable* saved_weak = nullptr;
+        bool entered = false;
+
+        // current for the rest of its life, see `VM::~VM`
+        void enter(){
+            saved_arena = __pool.arena; saved_gc = __pool.gc; saved_weak = __pool.weak;
+            __pool.arena = arena; __pool.gc = &gc; __pool.weak = &weak;
+            entered = true;
+        }
+
+        ~Heap(){
+            __drain_frees(0);
+            weak.drop();
+            if(arena != nullptr) __delete_arena(arena);
+            if(!entered) return;
+            __pool.arena = saved_arena; __pool.gc = saved_gc; __pool.weak = saved_weak;
+        }
+    };
+
+    // makes `heap` the memory of this thread until the scope ends
+    struct HeapScope {
+        Arena* arena;
+        GCState* gc;
+        WeakTable* weak;
+        HeapScope(Heap& heap) : arena(__pool.arena), gc(__pool.gc), weak(__pool.weak) {
+            __pool.arena = heap.arena; __pool.gc = &heap.gc; __pool.weak = &heap.weak;
+        }
+        ~HeapScope(){ __pool.arena = arena; __pool.gc = gc; __pool.weak = weak; }
+    };
+
+    template <typename T>
+    void __defer_items(shared_ptr<T>* items, size_t n){
+        MemoryPool& pool = __pool;
+        FreeQueue& q = pool.frees;
+        if(q.budget == 0 || n <= (size_t)q.budget) return;
+        q.blocks.reserve(q.blocks.size() + n);
+        for(size_t i=0; i<n; i++){
+            if(!items[i].is_heap()) continue;
+            q.blocks.push_back(items[i].detach());
+            pool.stats.deferred++;
+        }
     }
+
+    // the immortal objects of a vm, destroyed after the rest of it. Their blocks are kept until a
+    // full collection freed the cycles they held, whose objects still read the counts there
+    class ImmortalSet {
+        std::vector<int*> blocks;
+    public:
+        // an immortal object is also left out of the collector, it is never garbage
+        void add(const shared_ptr<PyObject>& obj){
+            if(!obj.is_heap() || obj.use_count() >= IMMORTAL) return;
+            int* p = (int*)obj.bits();
+            p[0] = IMMORTAL * 2;
+            if(__layouts[p[1] & LAYOUT_MASK].traverse != nullptr){
+                GCHead* head = (GCHead*)p - 1;
+                head->unlink();
+                head->next = head->prev = head;
+            }
+            blocks.push_back(p);
+        }
+
+        ~ImmortalSet(){
+            std::vector<size_t> sizes(blocks.size());
+            for(size_t i=0; i<blocks.size(); i++){
+                int* p = blocks[i];
+                if(p[1] & WEAKLY_REFERENCED) __weak_clear(p);
+                const _BlockLayout& layout = __layouts[p[1] & LAYOUT_MASK];
+                sizes[i] = layout.size + (layout.var_size != nullptr ? layout.var_size(p + 2) : 0);
+                layout.dtor(p + 2);
+            }
+            gc_collect(GCState::N_GENS - 1);
+            for(size_t i=0; i<blocks.size(); i++){
+                int* p = blocks[i];
+                if(__layouts[p[1] & LAYOUT_MASK].traverse != nullptr) __pool.dealloc((GCHead*)p - 1, sizes[i]);
+                else __pool.dealloc(p, sizes[i]);
+            }
+        }
+    };
+
+    // passes the block of each heap object referenced by the one being traversed
+    struct _GCVisitor {
+        void (*fn)(int* block, void* ctx);
+        void* ctx;
+
+        inline void operator()(const shared_ptr<PyObject>& p) const {
+            if(p.is_heap()) fn((int*)p.bits(), ctx);
+        }
+    };
 };
\ No newline at end of file
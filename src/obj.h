@@ -62,30 +62,306 @@ public:
     PyVarRef var;
     BaseIterator(VM* vm, PyVar _ref) : vm(vm), _ref(_ref) {}
     virtual ~BaseIterator() = default;
+
+    // what the cycle collector sees of an iterator, see gc.h
+    virtual void gc_traverse(const pkpy::_GCVisitor& v){ v(_ref); v(var); }
+    virtual void gc_clear(){ _ref.reset(); var.reset(); }
 };
 
 typedef pkpy::shared_ptr<Function> _Func;
 typedef pkpy::shared_ptr<BaseIterator> _Iterator;
+// the items of a list, shared by its copies until one of them changes, see `VM::PyList_AS_MUT`
+typedef pkpy::shared_ptr<PyVarList> _List;
+
+// a `weakref.ref`. One with a callback is a watcher of its slot from the time it has an object
+// until it is destroyed, so the slot can find it once the referent is released
+struct _WeakRef {
+    pkpy::shared_ptr<pkpy::WeakSlot> slot;
+    PyVar callback;
+    PyObject* owner = nullptr;
+
+    ~_WeakRef(){
+        if(owner == nullptr) return;
+        std::vector<void*>& w = slot->watchers;
+        w.erase(std::remove(w.begin(), w.end(), (void*)owner), w.end());
+    }
+};
+
+// the layout of the attributes of user instances, see `PyAttribs`
+// instances of a class which got the same attributes in the same order share a shape,
+// adding an attribute follows a transition to a child shape, and the shapes of a class form a tree
+struct Shape {
+    static const int MAX_ATTRS = 32;        // more attributes than this fall back to a dict
+    static const int MAX_SHAPES = 128;      // so does a class whose instances disagree too much
+    inline static std::atomic<uint32_t> __next_id{1};
+
+    const uint32_t id;                      // never reused, inline caches are keyed by it
+    Shape* const root;
+    int tree_size = 1;                      // shapes under `root`, counted on the root only
+    std::vector<_Str> keys;                 // the attributes, in order of their index
+    emhash8::HashMap<_Str, int> indices;
+    emhash8::HashMap<_Str, Shape*> transitions;
+
+    Shape(Shape* root=nullptr) : id(__next_id++), root(root != nullptr ? root : this) {}
+    Shape(const Shape&) = delete;
+    ~Shape(){ for(auto& [_, child] : transitions) delete child; }
+
+    inline int size() const { return keys.size(); }
+    inline int index_of(const _Str& key) const {
+        const int* i = indices.try_get(key);
+        return i != nullptr ? *i : -1;
+    }
+
+    // the shape with `key` added, nullptr if the instance should use a dict instead
+    Shape* add(const _Str& key){
+        Shape** child = transitions.try_get(key);
+        if(child != nullptr) return *child;
+        if(size() >= MAX_ATTRS || root->tree_size >= MAX_SHAPES) return nullptr;
+        Shape* s = new Shape(root);
+        s->keys = keys;
+        s->keys.push_back(key);
+        s->indices = indices;
+        s->indices[key] = size();
+        transitions[key] = s;
+        root->tree_size++;
+        return s;
+    }
+};
+
+struct ShapedAttribs {
+    Shape* shape;
+    std::vector<PyVar> values;      // `values[i]` is the attribute `shape->keys[i]`
+};
+
+// the attributes of an object, in one word which is either
+// - null, ints, strings, lists and refs seldom get any attribute
+// - a `PyVarDict*`, allocated by the first write
+// - a `ShapedAttribs*` with the low bit set, for user instances, see `init_shape`
+class PyAttribs {
+    uintptr_t _p = 0;
+    inline static PyVarDict _empty;     // stands in for a missing dict, never written
+
+    inline bool is_shaped() const { return _p & 1; }
+    inline ShapedAttribs* _shaped() const { return (ShapedAttribs*)(_p & ~(uintptr_t)1); }
+    inline PyVarDict* _dict() const { return (PyVarDict*)_p; }
+
+public:
+    PyAttribs() = default;
+    PyAttribs(const PyAttribs&) = delete;
+    PyAttribs& operator=(const PyAttribs&) = delete;
+    ~PyAttribs(){
+        if(is_shaped()) delete _shaped();
+        else delete _dict();
+    }
+
+    // starts an attribute-less instance at the root shape of its class
+    void init_shape(Shape* root, int capacity){
+        ShapedAttribs* s = new ShapedAttribs{root, {}};
+        s->values.reserve(capacity);
+        _p = (uintptr_t)s | 1;
+    }
+
+    // nullptr unless the attributes are laid out by a shape
+    inline Shape* shape() const { return is_shaped() ? _shaped()->shape : nullptr; }
+    inline PyVar& value_at(int i) const { return _shaped()->values[i]; }
+
+    // follows a transition of the current shape, `next` must be `shape()->add(key)`
+    inline void append(Shape* next, PyVar&& val){
+        ShapedAttribs* s = _shaped();
+        s->shape = next;
+        s->values.push_back(std::move(val));
+    }
+
+    // the attributes as a dict, a shaped instance is converted for good
+    PyVarDict& dict(){
+        if(is_shaped()){
+            ShapedAttribs* s = _shaped();
+            PyVarDict* d = new PyVarDict();
+            for(int i=0; i<s->shape->size(); i++) (*d)[s->shape->keys[i]] = std::move(s->values[i]);
+            delete s;
+            _p = (uintptr_t)d;
+        }else if(_p == 0){
+            _p = (uintptr_t)new PyVarDict();
+        }
+        return *_dict();
+    }
+
+    PyVar* try_get(const _Str& key){
+        if(is_shaped()){
+            int i = _shaped()->shape->index_of(key);
+            return i >= 0 ? &_shaped()->values[i] : nullptr;
+        }
+        return _p != 0 ? _dict()->try_get(key) : nullptr;
+    }
+
+    void set(const _Str& key, PyVar val){
+        if(is_shaped()){
+            ShapedAttribs* s = _shaped();
+            int i = s->shape->index_of(key);
+            if(i >= 0){ s->values[i] = std::move(val); return; }
+            Shape* next = s->shape->add(key);
+            if(next != nullptr){ append(next, std::move(val)); return; }
+        }
+        dict()[key] = std::move(val);
+    }
+
+    PyVar& operator[](const _Str& key){
+        PyVar* val = try_get(key);
+        if(val != nullptr) return *val;
+        set(key, nullptr);
+        return *try_get(key);
+    }
+
+    void gc_traverse(const pkpy::_GCVisitor& v) const {
+        if(is_shaped()){
+            for(const PyVar& val : _shaped()->values) v(val);
+        }else if(_p != 0){
+            for(const auto& [_, val] : *_dict()) v(val);
+        }
+    }
+
+    void clear(){
+        if(is_shaped()) delete _shaped();
+        else delete _dict();
+        _p = 0;
+    }
+
+    std::vector<_Str> keys(){
+        if(is_shaped()) return _shaped()->shape->keys;
+        std::vector<_Str> ret;
+        for(auto& [k, _] : *this) ret.push_back(k);
+        return ret;
+    }
+
+    // iterate over modules and types, a shaped instance would be converted
+    PyVarDict::iterator begin(){ return _p != 0 ? dict().begin() : _empty.begin(); }
+    PyVarDict::iterator end(){ return _p != 0 ? dict().end() : _empty.end(); }
+};
 
 struct PyObject {
-    PyVar _type;
-    PyVarDict attribs;
+    PyVar _type;            // use `VM::_tp`, tagged values keep their kind here instead
+    PyAttribs attribs;
 
-    inline bool is_type(const PyVar& type) const noexcept{ return this->_type == type; }
-    inline virtual void* value() = 0;
+    inline bool is_type(const PyVar& type) const noexcept;
 
     PyObject(const PyVar& type) : _type(type) {}
-    virtual ~PyObject() = default;
 };
 
+// the value always follows the header, see `VM::PyRef_AS_C`
 template <typename T>
 struct Py_ : PyObject {
     T _valueT;
 
     Py_(T val, const PyVar& type) : PyObject(type), _valueT(val) {}
-    virtual void* value() override { return &_valueT; }
 };
 
+// dunder methods that the VM calls without a lookup by name, see `VM::call_slot`
+// binary and compare slots follow `BINARY_SPECIAL_METHODS` and `CMP_SPECIAL_METHODS`
+enum TypeSlot {
+    SLOT_ADD, SLOT_SUB, SLOT_MUL, SLOT_TRUEDIV, SLOT_FLOORDIV, SLOT_MOD, SLOT_POW,
+    SLOT_LT, SLOT_LE, SLOT_EQ, SLOT_NE, SLOT_GT, SLOT_GE,
+    SLOT_LEN, SLOT_GETITEM, SLOT_SETITEM, SLOT_CONTAINS, SLOT_ITER, SLOT_HASH, SLOT_REPR, SLOT_BOOL,
+    SLOT_INIT,
+    __SLOT_COUNT
+};
+
+// interned like the names in str.h, their hashes are there before any VM shares them
+const _Str SLOT_NAMES[] = {
+    _Str::intern("__add__"), _Str::intern("__sub__"), _Str::intern("__mul__"), _Str::intern("__truediv__"),
+    _Str::intern("__floordiv__"), _Str::intern("__mod__"), _Str::intern("__pow__"),
+    _Str::intern("__lt__"), _Str::intern("__le__"), _Str::intern("__eq__"),
+    _Str::intern("__ne__"), _Str::intern("__gt__"), _Str::intern("__ge__"),
+    _Str::intern("__len__"), _Str::intern("__getitem__"), _Str::intern("__setitem__"), _Str::intern("__contains__"),
+    _Str::intern("__iter__"), _Str::intern("__hash__"), _Str::intern("__repr__"), _Str::intern("__bool__"),
+    _Str::intern("__init__"),
+};
+
+// every type object, so its slots can be filled without a side table
+struct PyTypeObject : Py_<i64> {
+    int slots_epoch = -1;           // `VM::_slots_epoch` when `slots` were filled
+    PyVar slots[__SLOT_COUNT];      // resolved along the bases, nullptr if missing
+    PyVar ctor_new;                 // `__new__` of the type itself, which replaces `__init__`
+    int ctor_attribs = 0;           // capacity for the attributes of new instances
+    std::unique_ptr<Shape> shape;   // the root shape of instances, created with the first one
+    uintptr_t tagged = 0;           // the `TaggedKind` of the type's tagged values, if any
+
+    PyTypeObject(i64 val, const PyVar& type) : Py_<i64>(val, type) {}
+};
+
+// a tuple keeps its items in its own block, right after it, so building one is a single allocation
+struct PyTupleObject : PyObject {
+    int n;
+
+    PyTupleObject(const PyVar& type, int n) : PyObject(type), n(n) {
+        for(int i=0; i<n; i++) new(data() + i) PyVar();
+    }
+    PyTupleObject(const PyTupleObject&) = delete;
+
+    ~PyTupleObject(){
+        if(n > pkpy::FreeQueue::MIN_DEFERRED_ITEMS) pkpy::__defer_items(data(), n);
+        for(int i=0; i<n; i++) data()[i].~PyVar();
+    }
+
+    inline PyVar* data() { return (PyVar*)(this + 1); }
+    inline const PyVar* data() const { return (const PyVar*)(this + 1); }
+    inline size_t var_size() const { return sizeof(PyVar) * n; }
+    inline int size() const { return n; }
+
+    inline PyVar* begin() { return data(); }
+    inline PyVar* end() { return data() + n; }
+    inline const PyVar* begin() const { return data(); }
+    inline const PyVar* end() const { return data() + n; }
+
+    inline const PyVar& operator[](size_t i) const {
+#ifndef PKPY_NO_INDEX_CHECK
+        if(i >= (size_t)n) throw std::out_of_range("tuple index out of range, " + std::to_string(i) + " not in [0, " + std::to_string(n) + ")");
+#endif
+        return data()[i];
+    }
+    inline PyVar& operator[](size_t i) { return (PyVar&)std::as_const(*this)[i]; }
+};
+
+template<> inline constexpr bool pkpy::__var_sized<PyTupleObject> = true;
+
+// what every item of a list is known to be, kept by each mutation of the list in the bits of
+// its block, see `VM::__list_stored`. The items of an int or a float list are all tagged, so
+// they sit unboxed in the buffer and a scan reads them without touching any object
+enum ListStrategy { LIST_EMPTY, LIST_INT, LIST_FLOAT, LIST_STR, LIST_OBJECT };
+
+// objects whose layout may hold references are tracked by the cycle collector, see gc.h
+// refs are not, they are short-lived and never stored by objects
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<i64>> = true;      // instances and modules
+template<> inline constexpr bool pkpy::__gc_tracked<PyTypeObject> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<_List>> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<PyTupleObject> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<PyVar>> = true;    // super
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<_Func>> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<_BoundedMethod>> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<_Iterator>> = true;
+template<> inline constexpr bool pkpy::__gc_tracked<Py_<_WeakRef>> = true;
+
+enum TaggedKind { KIND_INT = 1, KIND_FLOAT, KIND_NONE, KIND_BOOL, __KIND_COUNT };
+
+// the stand-in behind `->` of a tagged value, its `_type` is a tagged int holding the kind
+struct PyTaggedObject : PyObject {
+    PyTaggedObject(uintptr_t kind) : PyObject(PyVar::from_bits((kind << 2) | pkpy::TAG_INT)) {}
+};
+
+inline PyTaggedObject __tagged_objects[__KIND_COUNT] = {0, KIND_INT, KIND_FLOAT, KIND_NONE, KIND_BOOL};
+
+inline PyObject* __tagged_object(uintptr_t bits){
+    switch(bits & pkpy::TAG_MASK){
+        case pkpy::TAG_INT: return &__tagged_objects[KIND_INT];
+        case pkpy::TAG_FLOAT: return &__tagged_objects[KIND_FLOAT];
+    }
+    return &__tagged_objects[bits == pkpy::TAGGED_NONE ? KIND_NONE : KIND_BOOL];
+}
+
+inline bool PyObject::is_type(const PyVar& type) const noexcept{
+    if(_type == type) return true;
+    return _type.is_tagged() && ((const PyTypeObject*)type.get())->tagged == (_type.bits() >> 2);
+}
+
 #define UNION_GET(T, obj) (((Py_<T>*)((obj).get()))->_valueT)
 #define UNION_NAME(obj) UNION_GET(_Str, (obj)->attribs[__name__])
-#define UNION_TP_NAME(obj) UNION_GET(_Str, (obj)->_type->attribs[__name__])
\ No newline at end of file
+#define UNION_TP_NAME(obj) UNION_NAME(_tp(obj))
\ No newline at end of file
@@ -6,10 +6,16 @@ OPCODE(PRINT_EXPR)
 OPCODE(POP_TOP)
 OPCODE(DUP_TOP)
 OPCODE(CALL)
+OPCODE(INLINE_CALL)
 OPCODE(RETURN_VALUE)
+OPCODE(YIELD_VALUE)
+OPCODE(INLINE_RETURN)
 
 OPCODE(BINARY_OP)
+OPCODE(BINARY_OP_INT)
+OPCODE(BINARY_OP_FLOAT)
 OPCODE(COMPARE_OP)
+OPCODE(COMPARE_OP_NUM)
 OPCODE(BITWISE_OP)
 OPCODE(IS_OP)
 OPCODE(CONTAINS_OP)
@@ -21,6 +27,7 @@ OPCODE(BUILD_LIST)
 OPCODE(BUILD_MAP)
 OPCODE(BUILD_SET)
 OPCODE(BUILD_SLICE)
+OPCODE(BUILD_GENERATOR)
 
 OPCODE(LIST_APPEND)
 
@@ -46,6 +53,9 @@ OPCODE(LOAD_EVAL_FN)
 OPCODE(LOAD_LAMBDA)
 OPCODE(LOAD_ELLIPSIS)
 OPCODE(LOAD_NAME)
+OPCODE(LOAD_TYPED_LOCAL)
+OPCODE(LOAD_TYPED_LOCAL_REF)
+OPCODE(LOAD_HOISTED_LEN)
 OPCODE(LOAD_NAME_REF)
 
 OPCODE(ASSERT)
@@ -56,6 +66,8 @@ OPCODE(BUILD_CLASS)
 OPCODE(BUILD_ATTR_REF)
 OPCODE(BUILD_INDEX_REF)
 OPCODE(STORE_NAME_REF)
+OPCODE(STORE_TYPED_LOCAL)
+OPCODE(HOIST_LEN)
 OPCODE(STORE_REF)
 OPCODE(DELETE_REF)
 
@@ -0,0 +1,729 @@
+#pragma once
+
+#include "codeobject.h"
+
+// Optimize level 2 lifts `co_code` into basic blocks, where each stack value is
+// named by the bytecode which pushed it (SSA-ish values within a block),
+// rewrites it and lowers it back into `co_code`.
+// SINGLE_MODE and EVAL_MODE stay on the single-pass path, see `Compiler::optimizeLevel`.
+
+struct BasicBlock {
+    int start;              // start index in co_code, inclusive
+    int end;                // end index in co_code, exclusive
+    std::vector<int> succ;  // successors in `IROptimizer::blocks`
+};
+
+// a function which may be spliced into its call sites, see `Compiler::inlineCalls`
+struct InlineCandidate {
+    PyVar fn;
+    _Func func;
+};
+
+struct IRValue {
+    int def = -1;           // the bytecode which pushed this value, -1 if it comes from another block
+    int vn = -1;            // value number, see `eliminate_common_subexprs`
+};
+
+class IROptimizer {
+    CodeObject* co;
+    std::vector<BasicBlock> blocks;
+    std::vector<int> bb_of;                     // co_code index -> basic block
+
+    // pending edits, applied by `lower()`
+    std::vector<bool> dead;
+    std::vector<std::vector<Bytecode>> before;  // bytecodes inserted before each index
+    std::vector<int> headers;                   // loops whose `start` skips the inserted preheader
+
+    static bool __is_jump(uint8_t op){
+        return op == OP_JUMP_ABSOLUTE || op == OP_SAFE_JUMP_ABSOLUTE || op == OP_POP_JUMP_IF_FALSE
+            || op == OP_JUMP_IF_TRUE_OR_POP || op == OP_JUMP_IF_FALSE_OR_POP || op == OP_INLINE_RETURN;
+    }
+
+    static bool __is_terminator(uint8_t op){
+        return __is_jump(op) || op == OP_RETURN_VALUE || op == OP_RAISE_ERROR || op == OP_FOR_ITER
+            || op == OP_LOOP_BREAK || op == OP_LOOP_CONTINUE || op == OP_INLINE_CALL;
+    }
+
+    // values popped and pushed by a bytecode on its fall-through path
+    static void __stack_effect(const Bytecode& bc, int& pops, int& pushes){
+        pops = 0; pushes = 0;
+        switch(bc.op){
+            case OP_IMPORT_NAME: case OP_DUP_TOP:
+            case OP_LOAD_CONST: case OP_LOAD_NONE: case OP_LOAD_TRUE: case OP_LOAD_FALSE:
+            case OP_LOAD_EVAL_FN: case OP_LOAD_LAMBDA: case OP_LOAD_ELLIPSIS: case OP_LOAD_NAME:
+            case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF: case OP_LOAD_HOISTED_LEN:
+            case OP_LOAD_NAME_REF: case OP_BUILD_GENERATOR:
+                pushes = 1; break;
+            case OP_POP_TOP: case OP_RETURN_VALUE: case OP_YIELD_VALUE: case OP_POP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE_OR_POP: case OP_JUMP_IF_FALSE_OR_POP:
+            case OP_WITH_ENTER: case OP_WITH_EXIT: case OP_LIST_APPEND: case OP_ASSERT:
+            case OP_STORE_FUNCTION: case OP_STORE_NAME_REF: case OP_STORE_TYPED_LOCAL:
+            case OP_DELETE_REF: case OP_GOTO:
+                pops = 1; break;
+            case OP_CALL:
+                pops = (bc.arg & 0xFFFF) + 2 * ((bc.arg >> 16) & 0xFFFF) + 1;
+                pushes = 1; break;
+            case OP_BINARY_OP: case OP_BINARY_OP_INT: case OP_BINARY_OP_FLOAT:
+            case OP_COMPARE_OP: case OP_COMPARE_OP_NUM: case OP_BITWISE_OP:
+            case OP_IS_OP: case OP_CONTAINS_OP: case OP_BUILD_SLICE:
+            case OP_BUILD_INDEX_REF: case OP_GET_ITER:
+                pops = 2; pushes = 1; break;
+            case OP_UNARY_NEGATIVE: case OP_UNARY_NOT: case OP_BUILD_ATTR_REF:
+                pops = 1; pushes = 1; break;
+            case OP_BUILD_LIST: case OP_BUILD_SET: case OP_BUILD_SMART_TUPLE: case OP_BUILD_STRING:
+                pops = bc.arg; pushes = 1; break;
+            case OP_BUILD_MAP:
+                pops = bc.arg * 2; pushes = 1; break;
+            case OP_STORE_REF: case OP_RAISE_ERROR:
+                pops = 2; break;
+            default: break;
+        }
+    }
+
+    // walks a basic block on a simulated stack, `fn(i, args)` receives the popped values
+    // (or the peeked one for DUP_TOP) and returns the pushed one
+    template<typename __Fn>
+    void walk(const BasicBlock& bb, __Fn fn){
+        std::vector<IRValue> s;
+        for(int i=bb.start; i<bb.end; i++){
+            const Bytecode& bc = co->co_code[i];
+            int pops, pushes;
+            __stack_effect(bc, pops, pushes);
+            std::vector<IRValue> args(pops);
+            for(int k=pops-1; k>=0 && !s.empty(); k--){
+                args[k] = s.back();
+                s.pop_back();
+            }
+            if(bc.op == OP_DUP_TOP) args.push_back(s.empty() ? IRValue() : s.back());
+            // BUILD_CLASS pops until a None, so the stack is unknown afterwards
+            if(bc.op == OP_BUILD_CLASS) s.clear();
+            IRValue out = fn(i, args);
+            if(pushes > 0) s.push_back(out);
+        }
+    }
+
+    void build(){
+        const int n = co->co_code.size();
+        dead.assign(n, false);
+        before.assign(n, {});
+        headers.clear();
+
+        std::vector<bool> leader(n+1, false);
+        leader[0] = true;
+        for(int i=0; i<n; i++){
+            const Bytecode& bc = co->co_code[i];
+            if(__is_jump(bc.op)) leader[bc.arg] = true;
+            if(bc.op == OP_INLINE_CALL) leader[co->co_inlined[bc.arg].end] = true;
+            if(__is_terminator(bc.op)) leader[i+1] = true;
+        }
+        for(int k=1; k<co->co_blocks.size(); k++){
+            leader[co->co_blocks[k].start] = true;
+            leader[co->co_blocks[k].end] = true;
+        }
+
+        blocks.clear();
+        bb_of.assign(n, -1);
+        for(int i=0; i<n; i++){
+            if(leader[i]) blocks.push_back(BasicBlock{i, i});
+            blocks.back().end = i + 1;
+            bb_of[i] = blocks.size() - 1;
+        }
+
+        auto link = [&](BasicBlock& bb, int target){
+            if(target < n) bb.succ.push_back(bb_of[target]);
+        };
+        for(auto& bb : blocks){
+            const Bytecode& bc = co->co_code[bb.end - 1];
+            const CodeBlock& cb = co->co_blocks[bc.block];
+            switch(bc.op){
+                case OP_JUMP_ABSOLUTE: case OP_SAFE_JUMP_ABSOLUTE: case OP_INLINE_RETURN: link(bb, bc.arg); break;
+                case OP_INLINE_CALL: link(bb, bb.end); link(bb, co->co_inlined[bc.arg].end); break;
+                case OP_POP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE_OR_POP: case OP_JUMP_IF_FALSE_OR_POP:
+                    link(bb, bc.arg); link(bb, bb.end); break;
+                case OP_FOR_ITER: link(bb, bb.end); link(bb, cb.end); break;
+                case OP_LOOP_CONTINUE: link(bb, cb.start); break;
+                case OP_LOOP_BREAK: link(bb, cb.end); break;
+                case OP_RETURN_VALUE: case OP_RAISE_ERROR: break;
+                default: link(bb, bb.end); break;
+            }
+        }
+    }
+
+    // inserted jumps with a negative `arg` target `-arg-1` within their own insertion,
+    // and an inserted INLINE_CALL skips the rest of its insertion when deoptimized
+    void lower(){
+        const int n = co->co_code.size();
+        std::vector<int> pre(n+1), post(n+1);
+        int size = 0;
+        for(int i=0; i<n; i++){
+            pre[i] = size;
+            size += before[i].size();
+            post[i] = size;
+            if(!dead[i]) size++;
+        }
+        pre[n] = post[n] = size;
+
+        for(InlinedCall& ic : co->co_inlined){
+            if(ic.end >= 0) ic.end = pre[ic.end];
+        }
+        std::vector<Bytecode> out;
+        out.reserve(size);
+        for(int i=0; i<n; i++){
+            for(Bytecode bc : before[i]){
+                if(__is_jump(bc.op)) bc.arg = bc.arg < 0 ? pre[i] + (-bc.arg - 1) : pre[bc.arg];
+                if(bc.op == OP_INLINE_CALL) co->co_inlined[bc.arg].end = post[i];
+                out.push_back(bc);
+            }
+            if(dead[i]) continue;
+            out.push_back(co->co_code[i]);
+            if(__is_jump(out.back().op)) out.back().arg = pre[out.back().arg];
+        }
+        for(int k=1; k<co->co_blocks.size(); k++){
+            CodeBlock& cb = co->co_blocks[k];
+            bool is_header = std::find(headers.begin(), headers.end(), k) != headers.end();
+            cb.start = is_header ? post[cb.start] : pre[cb.start];
+            cb.end = pre[cb.end];
+        }
+        co->co_code = std::move(out);
+    }
+
+    bool __is_name(int i, uint8_t op) const {
+        return co->co_code[i].op == op && co->co_names[co->co_code[i].arg].second == NAME_LOCAL;
+    }
+
+    bool __is_numeric(const IRValue& v) const {
+        if(v.def < 0) return false;
+        switch(co->co_code[v.def].op){
+            case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF:
+            case OP_BINARY_OP_INT: case OP_BINARY_OP_FLOAT: case OP_UNARY_NEGATIVE:
+                return true;
+            default: return false;
+        }
+    }
+
+    // `LOAD_NAME_REF x; ...; STORE_REF` -> `...; STORE_NAME_REF x`
+    // so that plain and augmented assignments no longer allocate a ref
+    void lower_name_stores(){
+        std::vector<int> dups(co->co_code.size(), 0);
+        for(auto& bb : blocks){
+            walk(bb, [&](int i, std::vector<IRValue>& args){
+                Bytecode& bc = co->co_code[i];
+                if(bc.op == OP_DUP_TOP && args[0].def >= 0) dups[args[0].def]++;
+                if(bc.op != OP_STORE_REF || args[0].def < 0) return IRValue{i};
+                int k = args[0].def;
+                Bytecode& ref = co->co_code[k];
+                if(ref.op != OP_LOAD_NAME_REF && ref.op != OP_LOAD_TYPED_LOCAL_REF) return IRValue{i};
+                uint8_t store = ref.op == OP_LOAD_NAME_REF ? OP_STORE_NAME_REF : OP_STORE_TYPED_LOCAL;
+                if(dups[k] == 0){
+                    dead[k] = true;
+                }else if(dups[k] == 1 && co->co_code[k+1].op == OP_DUP_TOP){
+                    // a += b
+                    CodeObject::__deref_load(ref);
+                    dead[k+1] = true;
+                }else{
+                    return IRValue{i};
+                }
+                bc.op = store;
+                bc.arg = ref.arg;
+                if(args[1].def == i-1) CodeObject::__deref_load(co->co_code[i-1]);
+                return IRValue{i};
+            });
+        }
+    }
+
+    // the loop body runs no user code and does not rebind `obj` or `len`
+    bool __is_pure_loop(const CodeBlock& loop, int obj, const std::vector<int>& calls){
+        const _Str& obj_name = co->co_names[obj].first;
+        for(auto& bb : blocks){
+            if(bb.start < loop.start || bb.start >= loop.end) continue;
+            bool pure = true;
+            walk(bb, [&](int i, std::vector<IRValue>& args){
+                const Bytecode& bc = co->co_code[i];
+                switch(bc.op){
+                    case OP_NO_OP: case OP_LOAD_CONST: case OP_LOAD_NONE: case OP_LOAD_TRUE:
+                    case OP_LOAD_FALSE: case OP_LOAD_ELLIPSIS: case OP_LOAD_NAME: case OP_LOAD_NAME_REF:
+                    case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF: case OP_STORE_TYPED_LOCAL:
+                    case OP_BINARY_OP_INT: case OP_BINARY_OP_FLOAT: case OP_COMPARE_OP_NUM:
+                    case OP_UNARY_NEGATIVE: case OP_IS_OP: case OP_POP_TOP: case OP_RETURN_VALUE:
+                    case OP_JUMP_ABSOLUTE: case OP_LOOP_BREAK: case OP_LOOP_CONTINUE:
+                        break;
+                    case OP_STORE_NAME_REF: {
+                        const _Str& name = co->co_names[bc.arg].first;
+                        if(name == obj_name || name == "len") pure = false;
+                    } break;
+                    case OP_CALL:
+                        if(std::find(calls.begin(), calls.end(), i) == calls.end()) pure = false;
+                        break;
+                    // int and float have native magic methods
+                    case OP_BINARY_OP: case OP_COMPARE_OP:
+                        if(!__is_numeric(args[0])) pure = false;
+                        break;
+                    // `obj` is a list, tuple or str once the guard passes
+                    case OP_BUILD_INDEX_REF:
+                        if(args[0].def < 0 || co->co_code[args[0].def].arg != obj) pure = false;
+                        else if(co->co_code[args[0].def].op != OP_LOAD_NAME && co->co_code[args[0].def].op != OP_LOAD_NAME_REF) pure = false;
+                        break;
+                    case OP_POP_JUMP_IF_FALSE: case OP_JUMP_IF_TRUE_OR_POP: case OP_JUMP_IF_FALSE_OR_POP: {
+                        // asBool() of a bool
+                        int d = args[0].def;
+                        uint8_t op = d < 0 ? OP_NO_OP : co->co_code[d].op;
+                        if(op != OP_COMPARE_OP && op != OP_COMPARE_OP_NUM && op != OP_IS_OP) pure = false;
+                    } break;
+                    default: pure = false; break;
+                }
+                return IRValue{i};
+            });
+            if(!pure) return false;
+        }
+        return true;
+    }
+
+    // `while i < len(a)` -> compute `len(a)` once before the loop,
+    // guarded at runtime by `OP_HOIST_LEN`, see `VM::run_frame`
+    void hoist_loop_invariants(){
+        for(int k=1; k<co->co_blocks.size(); k++){
+            const CodeBlock& loop = co->co_blocks[k];
+            if(loop.type != WHILE_LOOP) continue;
+            int cond_end = -1;
+            for(int i=loop.start; i<loop.end; i++){
+                const Bytecode& bc = co->co_code[i];
+                if(bc.op == OP_POP_JUMP_IF_FALSE && bc.arg == loop.end && bc.block == k){
+                    cond_end = i;
+                    break;
+                }
+            }
+            if(cond_end < 0) continue;
+
+            // find `len(obj)` of the same local in the condition
+            std::vector<int> calls;
+            int obj = -1;
+            for(int i=loop.start+2; i<cond_end; i++){
+                const Bytecode& bc = co->co_code[i];
+                if(bc.op != OP_CALL || bc.arg != 1) continue;
+                if(!__is_name(i-1, OP_LOAD_NAME) || co->co_code[i-2].op != OP_LOAD_NAME) continue;
+                if(co->co_names[co->co_code[i-2].arg].first != "len") continue;
+                if(bb_of[i-2] != bb_of[i]) continue;
+                if(obj != -1 && co->co_code[i-1].arg != obj) continue;
+                obj = co->co_code[i-1].arg;
+                calls.push_back(i);
+            }
+            if(calls.empty() || !__is_pure_loop(loop, obj, calls)) continue;
+
+            int fn = co->co_code[calls[0]-2].arg;
+            int slot = co->add_typed_name("$len" + std::to_string(co->co_hoisted.size()), HINT_INT);
+            int index = co->co_hoisted.size();
+            co->co_hoisted.push_back(HoistedLen{slot, fn, obj});
+            const Bytecode& first = co->co_code[loop.start];
+            before[loop.start].push_back(Bytecode{OP_HOIST_LEN, index, first.line, (uint16_t)loop.parent});
+            for(int i : calls){
+                dead[i-2] = dead[i-1] = true;
+                co->co_code[i].op = OP_LOAD_HOISTED_LEN;
+                co->co_code[i].arg = index;
+            }
+            headers.push_back(k);
+        }
+    }
+
+    // local value numbering over unboxed arithmetic, a repeated expression
+    // is replaced by a load of the hidden typed local holding its first result
+    void eliminate_common_subexprs(){
+        std::vector<int> lo(co->co_code.size(), -1);    // first bytecode of the expression ending here
+        for(auto& bb : blocks){
+            std::map<std::vector<i64>, int> table;
+            std::map<int, int> first;       // value number -> bytecode computing it first
+            std::map<int, int> temp;        // value number -> typed local holding it
+            std::vector<int> version(co->co_typed_names.size(), 0);
+            walk(bb, [&](int i, std::vector<IRValue>& args){
+                const Bytecode bc = co->co_code[i];
+                IRValue out{i};
+                std::vector<i64> key;
+                switch(bc.op){
+                    // equal tagged values share one word
+                    case OP_LOAD_CONST:
+                        key = {bc.op, (i64)co->co_consts[bc.arg].bits()};
+                        lo[i] = i;
+                        break;
+                    case OP_LOAD_TYPED_LOCAL:
+                        if(bc.arg < version.size()) key = {bc.op, bc.arg, version[bc.arg]};
+                        lo[i] = i;
+                        break;
+                    case OP_BINARY_OP_INT: case OP_BINARY_OP_FLOAT:
+                        if(args[0].vn >= 0 && args[1].vn >= 0) key = {bc.op, bc.arg, args[0].vn, args[1].vn};
+                        if(args[1].def == i-1 && lo[i-1] >= 0 && args[0].def == lo[i-1]-1 && lo[args[0].def] >= 0){
+                            lo[i] = lo[args[0].def];
+                        }
+                        break;
+                    case OP_UNARY_NEGATIVE:
+                        if(args[0].vn >= 0) key = {bc.op, args[0].vn};
+                        if(args[0].def == i-1 && lo[i-1] >= 0) lo[i] = lo[i-1];
+                        break;
+                    case OP_STORE_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF:
+                        if(bc.arg < version.size()) version[bc.arg]++;
+                        break;
+                    default: break;
+                }
+                if(key.empty()) return out;
+                auto it = table.find(key);
+                if(it == table.end()) it = table.emplace(key, table.size()).first;
+                out.vn = it->second;
+                if(bc.op != OP_BINARY_OP_INT && bc.op != OP_BINARY_OP_FLOAT) return out;
+
+                auto f = first.find(out.vn);
+                if(f == first.end()){
+                    first[out.vn] = i;
+                    return out;
+                }
+                if(lo[i] < 0) return out;
+                auto t = temp.find(out.vn);
+                if(t == temp.end()){
+                    TypeHint hint = bc.op == OP_BINARY_OP_INT ? HINT_INT : HINT_FLOAT;
+                    int slot = co->add_typed_name("$cse" + std::to_string(co->co_typed_names.size()), hint);
+                    t = temp.emplace(out.vn, slot).first;
+                    const Bytecode& src = co->co_code[f->second];
+                    before[f->second+1].push_back(Bytecode{OP_DUP_TOP, -1, src.line, src.block});
+                    before[f->second+1].push_back(Bytecode{OP_STORE_TYPED_LOCAL, slot, src.line, src.block});
+                }
+                for(int j=lo[i]; j<i; j++) dead[j] = true;
+                co->co_code[i].op = OP_LOAD_TYPED_LOCAL;
+                co->co_code[i].arg = t->second;
+                return out;
+            });
+        }
+    }
+
+    // `x = y` followed by loads of `x` in the same basic block -> loads of `y`
+    void propagate_copies(){
+        for(auto& bb : blocks){
+            std::map<int, int> names;       // co_names index -> co_names index
+            std::map<int, int> typed;       // typed local -> typed local
+            std::set<int> stored;           // names certainly in `f_locals`
+            auto kill = [](std::map<int, int>& m, int v){
+                m.erase(v);
+                for(auto it = m.begin(); it != m.end();){
+                    if(it->second == v) it = m.erase(it);
+                    else ++it;
+                }
+            };
+            for(int i=bb.start; i<bb.end; i++){
+                Bytecode& bc = co->co_code[i];
+                switch(bc.op){
+                    case OP_LOAD_NAME: {
+                        auto it = names.find(bc.arg);
+                        if(it != names.end()) bc.arg = it->second;
+                    } break;
+                    case OP_LOAD_TYPED_LOCAL: {
+                        auto it = typed.find(bc.arg);
+                        if(it != typed.end()) bc.arg = it->second;
+                    } break;
+                    case OP_LOAD_NAME_REF: kill(names, bc.arg); break;
+                    case OP_LOAD_TYPED_LOCAL_REF: kill(typed, bc.arg); break;
+                    case OP_STORE_NAME_REF: {
+                        kill(names, bc.arg);
+                        if(co->co_names[bc.arg].second != NAME_LOCAL) break;
+                        if(i > bb.start && __is_name(i-1, OP_LOAD_NAME)){
+                            int src = co->co_code[i-1].arg;
+                            if(src != bc.arg && stored.count(src)) names[bc.arg] = src;
+                        }
+                        stored.insert(bc.arg);
+                    } break;
+                    case OP_STORE_TYPED_LOCAL: {
+                        kill(typed, bc.arg);
+                        if(i > bb.start && co->co_code[i-1].op == OP_LOAD_TYPED_LOCAL){
+                            int src = co->co_code[i-1].arg;
+                            if(src != bc.arg && co->co_typed_names[src].second == co->co_typed_names[bc.arg].second){
+                                typed[bc.arg] = src;
+                            }
+                        }
+                    } break;
+                    default: break;
+                }
+            }
+        }
+    }
+
+    // stores to locals which are never read afterwards become POP_TOP
+    void eliminate_dead_stores(){
+        // variables are local names (by string) followed by typed locals
+        std::map<_Str, int> ids;
+        for(auto& p : co->co_names) ids.emplace(p.first, ids.size());
+        const int n_names = ids.size();
+        const int n_vars = n_names + co->co_typed_names.size();
+        auto name_id = [&](int arg){ return ids[co->co_names[arg].first]; };
+
+        // returns the variable written by bc and appends the ones it reads
+        auto use_def = [&](const Bytecode& bc, std::vector<int>& uses){
+            switch(bc.op){
+                case OP_LOAD_NAME: case OP_LOAD_NAME_REF:
+                    uses.push_back(name_id(bc.arg)); return -1;
+                case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF:
+                    uses.push_back(n_names + bc.arg); return -1;
+                case OP_STORE_NAME_REF:
+                    if(co->co_names[bc.arg].second != NAME_LOCAL) return -1;
+                    return name_id(bc.arg);
+                case OP_STORE_TYPED_LOCAL:
+                    return n_names + bc.arg;
+                case OP_HOIST_LEN: case OP_LOAD_HOISTED_LEN: {
+                    const HoistedLen& h = co->co_hoisted[bc.arg];
+                    uses.push_back(name_id(h.fn));
+                    uses.push_back(name_id(h.obj));
+                    if(bc.op == OP_HOIST_LEN) return n_names + h.slot;
+                    uses.push_back(n_names + h.slot);
+                    return -1;
+                }
+                default: return -1;
+            }
+        };
+
+        const int n_blocks = blocks.size();
+        std::vector<std::vector<bool>> live_in(n_blocks, std::vector<bool>(n_vars, false));
+        std::vector<std::vector<bool>> live_out = live_in;
+        std::vector<int> uses;
+        bool changed = true;
+        while(changed){
+            changed = false;
+            for(int b=n_blocks-1; b>=0; b--){
+                std::vector<bool> live(n_vars, false);
+                for(int s : blocks[b].succ){
+                    for(int v=0; v<n_vars; v++) if(live_in[s][v]) live[v] = true;
+                }
+                live_out[b] = live;
+                for(int i=blocks[b].end-1; i>=blocks[b].start; i--){
+                    uses.clear();
+                    int d = use_def(co->co_code[i], uses);
+                    if(d >= 0) live[d] = false;
+                    for(int u : uses) live[u] = true;
+                }
+                if(live != live_in[b]){
+                    live_in[b] = std::move(live);
+                    changed = true;
+                }
+            }
+        }
+
+        for(int b=0; b<n_blocks; b++){
+            std::vector<bool> live = live_out[b];
+            for(int i=blocks[b].end-1; i>=blocks[b].start; i--){
+                Bytecode& bc = co->co_code[i];
+                uses.clear();
+                int d = use_def(bc, uses);
+                if(d >= 0){
+                    if(!live[d]){
+                        bc.op = OP_POP_TOP;
+                        bc.arg = -1;
+                    }
+                    live[d] = false;
+                }
+                for(int u : uses) live[u] = true;
+            }
+        }
+
+        // drop `LOAD_CONST; POP_TOP` and the like left behind
+        for(auto& bb : blocks){
+            walk(bb, [&](int i, std::vector<IRValue>& args){
+                if(co->co_code[i].op != OP_POP_TOP || args[0].def != i-1 || dead[i-1]) return IRValue{i};
+                switch(co->co_code[i-1].op){
+                    case OP_LOAD_CONST: case OP_LOAD_NONE: case OP_LOAD_TRUE: case OP_LOAD_FALSE:
+                    case OP_LOAD_ELLIPSIS: case OP_LOAD_TYPED_LOCAL: case OP_DUP_TOP:
+                        dead[i-1] = dead[i] = true;
+                        break;
+                    default: break;
+                }
+                return IRValue{i};
+            });
+        }
+    }
+
+    void __splice(int p, int i, const InlineCandidate& c){
+        const Function& func = *c.func;
+        const _Code& callee = func.code;
+        const Bytecode call = co->co_code[i];
+        const int k = co->co_inlined.size();
+        const int argc = func.args.size();
+        co->co_inlined.push_back(InlinedCall{c.fn, co->co_code[p].arg, argc, call.line, callee});
+
+        // locals of the callee get a private name in the caller
+        std::set<_Str> locals = __locals_of(func);
+        auto rename = [&](int arg){
+            const auto& name = callee->co_names[arg];
+            if(name.second == NAME_LOCAL && locals.count(name.first)) return co->add_name("$" + func.name + "." + name.first, NAME_LOCAL);
+            return co->add_name(name.first, name.second);
+        };
+        auto retype = [&](int slot){
+            _Str name = "$" + func.name + "." + callee->co_typed_names[slot].first;
+            int index = co->find_typed_name(name);
+            return index >= 0 ? index : co->add_typed_name(name, callee->co_typed_names[slot].second);
+        };
+
+        std::vector<Bytecode>& out = before[i];
+        out.push_back(Bytecode{OP_INLINE_CALL, k, call.line, call.block});
+        for(int j=argc-1; j>=0; j--){
+            int slot = callee->find_typed_name(func.args[j]);
+            if(slot >= 0){
+                out.push_back(Bytecode{OP_STORE_TYPED_LOCAL, retype(slot), call.line, call.block});
+            }else{
+                int index = co->add_name("$" + func.name + "." + func.args[j], NAME_LOCAL);
+                out.push_back(Bytecode{OP_STORE_NAME_REF, index, call.line, call.block});
+            }
+        }
+
+        const int base = out.size();
+        const int n = callee->co_code.size();
+        // falling off the end returns None
+        bool stub = callee->co_code.back().op != OP_RETURN_VALUE;
+        for(const Bytecode& bc : callee->co_code){
+            if(__is_jump(bc.op) && bc.arg >= n) stub = true;
+        }
+        const int end = base + n + (stub ? 2 : 0);
+        for(Bytecode bc : callee->co_code){
+            bc.block = call.block;
+            bc.inlined = k + 1;
+            if(__is_jump(bc.op)) bc.arg = -(base + bc.arg) - 1;
+            switch(bc.op){
+                case OP_RETURN_VALUE: bc.op = OP_INLINE_RETURN; bc.arg = -end - 1; break;
+                case OP_LOAD_CONST: bc.arg = co->add_const(callee->co_consts[bc.arg]); break;
+                case OP_LOAD_NAME: case OP_LOAD_NAME_REF: case OP_STORE_NAME_REF: case OP_BUILD_ATTR_REF:
+                    bc.arg = rename(bc.arg); break;
+                case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF: case OP_STORE_TYPED_LOCAL:
+                    bc.arg = retype(bc.arg); break;
+                default: break;
+            }
+            out.push_back(bc);
+        }
+        if(stub){
+            int line = callee->co_code.back().line;
+            out.push_back(Bytecode{OP_LOAD_NONE, -1, line, call.block, (uint16_t)(k+1)});
+            out.push_back(Bytecode{OP_INLINE_RETURN, -end - 1, line, call.block, (uint16_t)(k+1)});
+        }
+        dead[p] = dead[i] = true;
+    }
+
+    static std::set<_Str> __locals_of(const Function& func){
+        std::set<_Str> locals(func.args.begin(), func.args.end());
+        for(const Bytecode& bc : func.code->co_code){
+            if(bc.op == OP_STORE_NAME_REF) locals.insert(func.code->co_names[bc.arg].first);
+        }
+        return locals;
+    }
+
+public:
+    IROptimizer(CodeObject* co): co(co) {}
+
+    // names read by `func` which are neither its arguments nor its locals,
+    // returns false if it cannot run in the frame of its caller
+    static bool free_names_of(const Function& func, std::set<_Str>& names){
+        const _Code& code = func.code;
+        if(!func.starredArg.empty() || !func.kwArgs.empty()) return false;
+        if(code->co_code.empty() || code->co_code.size() > 32) return false;
+        if(code->co_blocks.size() > 1 || !code->co_labels.empty()) return false;
+
+        std::set<_Str> locals = __locals_of(func);
+        // locals must be assigned before the first branch, so stale values
+        // of a previous inlined call are never read
+        std::set<_Str> assigned(func.args.begin(), func.args.end());
+        std::set<int> typed;
+        bool prefix = true;
+        for(int i=0; i<code->co_code.size(); i++){
+            const Bytecode& bc = code->co_code[i];
+            switch(bc.op){
+                case OP_LOAD_NAME: case OP_LOAD_NAME_REF: {
+                    const _Str& name = code->co_names[bc.arg].first;
+                    if(name == func.name || name == "locals" || name == "eval" || name == "super") return false;
+                    if(!locals.count(name)) names.insert(name);
+                    else if(!assigned.count(name)) return false;
+                } break;
+                case OP_STORE_NAME_REF:
+                    if(code->co_names[bc.arg].second != NAME_LOCAL) return false;
+                    if(prefix) assigned.insert(code->co_names[bc.arg].first);
+                    else if(!assigned.count(code->co_names[bc.arg].first)) return false;
+                    break;
+                case OP_LOAD_TYPED_LOCAL: case OP_LOAD_TYPED_LOCAL_REF: {
+                    const _Str& name = code->co_typed_names[bc.arg].first;
+                    if(!typed.count(bc.arg) && !assigned.count(name)) return false;
+                } break;
+                case OP_STORE_TYPED_LOCAL:
+                    if(prefix) typed.insert(bc.arg);
+                    else if(!typed.count(bc.arg) && !assigned.count(code->co_typed_names[bc.arg].first)) return false;
+                    break;
+                case OP_IMPORT_NAME: case OP_PRINT_EXPR: case OP_LOAD_EVAL_FN: case OP_LOAD_LAMBDA:
+                case OP_STORE_FUNCTION: case OP_BUILD_CLASS: case OP_GOTO: case OP_SAFE_JUMP_ABSOLUTE:
+                case OP_HOIST_LEN: case OP_LOAD_HOISTED_LEN: case OP_INLINE_CALL: case OP_INLINE_RETURN:
+                case OP_YIELD_VALUE: case OP_BUILD_GENERATOR:
+                    return false;
+                default: break;
+            }
+            if(__is_terminator(bc.op)) prefix = false;
+        }
+        return true;
+    }
+
+    // splices small functions into call sites of `caller`, each site is guarded by OP_INLINE_CALL
+    void inline_calls(const std::map<_Str, InlineCandidate>& candidates, const std::map<_Str, std::set<_Str>>& free_names, const Function& caller){
+        if(!co->co_labels.empty()) return;
+        build();
+        // the callable of each call site
+        std::vector<int> callable(co->co_code.size(), -1);
+        for(auto& bb : blocks){
+            walk(bb, [&](int i, std::vector<IRValue>& args){
+                const Bytecode& bc = co->co_code[i];
+                if(bc.op == OP_CALL && (bc.arg >> 16) == 0 && args[0].def >= 0) callable[args[0].def] = i;
+                return IRValue{i};
+            });
+        }
+        // names which may be bound in `f_locals` of the caller
+        std::set<_Str> locals(caller.args.begin(), caller.args.end());
+        if(!caller.starredArg.empty()) locals.insert(caller.starredArg);
+        for(auto& kv : caller.kwArgs) locals.insert(kv.first);
+        for(int i=0; i<co->co_code.size(); i++){
+            const Bytecode& bc = co->co_code[i];
+            if(bc.op == OP_LOAD_EVAL_FN) return;
+            if(bc.op == OP_LOAD_NAME || bc.op == OP_LOAD_NAME_REF){
+                const _Str& name = co->co_names[bc.arg].first;
+                if(name == "locals" || name == "eval") return;
+            }
+            if(bc.op == OP_STORE_NAME_REF || (bc.op == OP_LOAD_NAME_REF && callable[i] < 0)){
+                locals.insert(co->co_names[bc.arg].first);
+            }
+        }
+
+        int count = 0;
+        for(int p=0; p<co->co_code.size() && count < 16; p++){
+            const Bytecode& bc = co->co_code[p];
+            if(callable[p] < 0 || (bc.op != OP_LOAD_NAME && bc.op != OP_LOAD_NAME_REF)) continue;
+            const _Str& name = co->co_names[bc.arg].first;
+            auto it = candidates.find(name);
+            if(it == candidates.end() || locals.count(name)) continue;
+            const InlineCandidate& c = it->second;
+            int i = callable[p];
+            if(co->co_code[i].arg != c.func->args.size()) continue;
+            bool shadowed = false;
+            for(const _Str& free : free_names.at(name)) shadowed |= locals.count(free) > 0;
+            if(shadowed) continue;
+            __splice(p, i, c);
+            count++;
+        }
+        if(count > 0) lower();
+    }
+
+    void run(){
+        if(!co->co_labels.empty()) return;
+        // locals(), eval(), f-strings and generator expressions read `f_locals` by name
+        bool introspected = false;
+        for(const Bytecode& bc : co->co_code){
+            if(bc.op == OP_GOTO) return;
+            if(bc.op == OP_LOAD_EVAL_FN || bc.op == OP_BUILD_GENERATOR) introspected = true;
+            if(bc.op == OP_LOAD_NAME || bc.op == OP_LOAD_NAME_REF){
+                const _Str& name = co->co_names[bc.arg].first;
+                if(name == "locals" || name == "eval") introspected = true;
+            }
+        }
+        build(); lower_name_stores(); lower();
+        if(introspected) return;
+        build(); hoist_loop_invariants(); lower();
+        build(); eliminate_common_subexprs(); lower();
+        build(); propagate_copies(); eliminate_dead_stores(); lower();
+    }
+};
+
+void CodeObject::optimize_level_2(){
+    IROptimizer(this).run();
+}
@@ -15,7 +15,7 @@ constexpr const char* __TOKENS[] = {
     "class", "import", "as", "def", "lambda", "pass", "del", "from", "with",
     "None", "in", "is", "and", "or", "not", "True", "False", "global", "try", "except", "finally",
     "goto", "label",      // extended keywords, not available in cpython
-    "while", "for", "if", "elif", "else", "break", "continue", "return", "assert", "raise",
+    "while", "for", "if", "elif", "else", "break", "continue", "return", "yield", "assert", "raise",
     /** KW_END **/
     "is not", "not in",
     "@id", "@num", "@str", "@fstr",
@@ -55,8 +55,10 @@ struct Token{
   int length;        //< Number of chars of the token.
   int line;          //< Line number of the token (1 based).
   PyVar value;       //< Literal value of the token.
+  bool symbol = false;  //< An identifier of a module, interned. Eval and json input is not.
 
   const _Str str() const {
+    if(symbol) return _Str::intern(_Str(start, length));
     return _Str(start, length);
   }
 
@@ -295,7 +297,8 @@ struct Parser {
             token_start,
             (int)(curr_char - token_start),
             current_line - ((type == TK("@eol")) ? 1 : 0),
-            value
+            value,
+            type == TK("@id") && src->mode == EXEC_MODE
         });
     }
 
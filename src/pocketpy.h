@@ -1,13 +1,21 @@
 #pragma once
 
 #include "vm.h"
+#include "gc.h"
+#include "jit.h"
+#include "regvm.h"
+#include "aot.h"
 #include "compiler.h"
 #include "repl.h"
 
 _Code VM::compile(_Str source, _Str filename, CompileMode mode) {
     Compiler compiler(this, source.c_str(), filename, mode);
     try{
-        return compiler.__fillCode();
+        _Code code = compiler.__fillCode();
+        // a module is compiled once, its constants live as long as the vm and are never counted.
+        // Code from eval() and the repl comes and goes, so its constants stay mortal
+        if(mode == EXEC_MODE) immortalize_consts(code);
+        return code;
     }catch(_Error& e){
         throw e;
     }catch(std::exception& e){
@@ -15,6 +23,18 @@ _Code VM::compile(_Str source, _Str filename, CompileMode mode) {
     }
 }
 
+void VM::immortalize_consts(const _Code& code){
+    std::vector<const CodeObject*> pending = {code.get()};
+    while(!pending.empty()){
+        const CodeObject* co = pending.back();
+        pending.pop_back();
+        for(const PyVar& obj : co->co_consts){
+            if(obj->is_type(_tp_function)) pending.push_back(PyFunction_AS_C(obj)->code.get());
+            else if(obj->is_type(_tp_str) || obj->is_type(_tp_int) || obj->is_type(_tp_float)) immortalize(obj);
+        }
+    }
+}
+
 #define BIND_NUM_ARITH_OPT(name, op)                                                                    \
     _vm->bindMethodMulti({"int","float"}, #name, [](VM* vm, const pkpy::ArgList& args){                 \
         if(!vm->is_int_or_float(args[0], args[1]))                                                         \
@@ -67,7 +87,7 @@ void __initializeBuiltinFunctions(VM* _vm) {
         vm->check_args_size(args, 1);
         const _Str& expr = vm->PyStr_AS_C(args[0]);
         _Code code = vm->compile(expr, "<eval>", EVAL_MODE);
-        return vm->_exec(code, vm->top_frame()->_module, vm->top_frame()->f_locals_copy());
+        return vm->_exec(code, vm->top_frame()->_module, vm->top_frame()->f_locals_copy(vm));
     });
 
     _vm->bindBuiltinFunc("isinstance", [](VM* vm, const pkpy::ArgList& args) {
@@ -75,6 +95,18 @@ void __initializeBuiltinFunctions(VM* _vm) {
         return vm->PyBool(vm->isinstance(args[0], args[1]));
     });
 
+    _vm->bindBuiltinFunc("getattr", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2);
+        return vm->getattr(args[0], vm->PyStr_AS_C(args[1]));
+    });
+
+    _vm->bindBuiltinFunc("setattr", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 3);
+        PyVar obj = args[0];
+        vm->setattr(obj, vm->PyStr_AS_C(args[1]), args[2]);
+        return vm->None;
+    });
+
     _vm->bindBuiltinFunc("repr", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1);
         return vm->asRepr(args[0]);
@@ -85,9 +117,77 @@ void __initializeBuiltinFunctions(VM* _vm) {
         return vm->PyInt(vm->hash(args[0]));
     });
 
+    _vm->bindBuiltinFunc("zip", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2);
+        return vm->PyIter(pkpy::make_shared<BaseIterator, ZipIterator>(vm, vm->asIter(args[0]), vm->asIter(args[1])));
+    });
+
     _vm->bindBuiltinFunc("len", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1);
-        return vm->call(args[0], __len__, pkpy::noArg());
+        return vm->call_slot(SLOT_LEN, pkpy::oneArg(args[0]));
+    });
+
+    // an int or a float list is summed straight from its buffer, see `ListStrategy`
+    _vm->bindBuiltinFunc("sum", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1);
+        const PyVar& obj = args[0];
+        if(obj->is_type(vm->_tp_list)){
+            const PyVarList& items = vm->PyList_AS_C(obj);
+            switch(vm->list_strategy(obj)){
+                case LIST_EMPTY: return vm->PyInt(0);
+                case LIST_INT: {
+                    uint64_t res = 0;       // wraps around like `int.__add__`
+                    for(const PyVar& x : items) res += (uint64_t)vm->PyInt_AS_C(x);
+                    return vm->PyInt((i64)res);
+                }
+                case LIST_FLOAT: {
+                    f64 res = 0;
+                    for(const PyVar& x : items) res += vm->PyFloat_AS_C(x);
+                    return vm->PyFloat(res);
+                }
+                default: break;
+            }
+        }
+        PyVar it = vm->asIter(obj);
+        const _Iterator& iter = vm->PyIter_AS_C(it);
+        PyVar res = vm->PyInt(0);
+        while(iter->hasNext()) res = vm->call_slot(SLOT_ADD, pkpy::twoArgs(res, iter->next()));
+        return res;
+    });
+
+    // sorts `a` in place by `keys`, or by its own items for None, see `list.sort`.
+    // The sort is stable, and an int, a float or a str list of keys skips `__lt__`
+    _vm->bindBuiltinFunc("__list_sort", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 3);
+        PyVar keys_obj = args[1] == vm->None ? args[0] : args[1];
+        vm->check_type(keys_obj, vm->_tp_list);
+        _List keys_items = UNION_GET(_List, keys_obj);       // held, a key may change the list
+        const PyVarList& keys = *keys_items;
+        if(keys.size() != vm->PyList_AS_C(args[0]).size()) vm->valueError("keys must be as many as the items");
+        bool reverse = vm->asBool(args[2]) == vm->True;
+
+        std::vector<int> order(keys.size());
+        for(int i = 0; i < order.size(); i++) order[i] = i;
+        auto sort_by = [&](auto less){
+            std::stable_sort(order.begin(), order.end(), [&](int a, int b){
+                return reverse ? less(keys[b], keys[a]) : less(keys[a], keys[b]);
+            });
+        };
+        switch(vm->list_strategy(keys_obj)){
+            case LIST_EMPTY: return vm->None;
+            case LIST_INT: sort_by([vm](const PyVar& x, const PyVar& y){ return vm->PyInt_AS_C(x) < vm->PyInt_AS_C(y); }); break;
+            case LIST_FLOAT: sort_by([vm](const PyVar& x, const PyVar& y){ return vm->PyFloat_AS_C(x) < vm->PyFloat_AS_C(y); }); break;
+            case LIST_STR: sort_by([vm](const PyVar& x, const PyVar& y){ return vm->PyStr_AS_C(x) < vm->PyStr_AS_C(y); }); break;
+            default: sort_by([vm](const PyVar& x, const PyVar& y){
+                return vm->asBool(vm->call_slot(SLOT_LT, pkpy::twoArgs(x, y))) == vm->True;
+            });
+        }
+        PyVarList& _self = vm->PyList_AS_MUT(args[0]);
+        if(_self.size() != order.size()) vm->valueError("list modified during sort");
+        PyVarList sorted(_self.size());
+        for(int i = 0; i < order.size(); i++) sorted[i] = _self[order[i]];
+        _self = std::move(sorted);
+        return vm->None;
     });
 
     _vm->bindBuiltinFunc("chr", [](VM* vm, const pkpy::ArgList& args) {
@@ -109,17 +209,17 @@ void __initializeBuiltinFunctions(VM* _vm) {
         const auto& d = vm->top_frame()->f_globals();
         PyVar obj = vm->call(vm->builtins->attribs["dict"]);
         for (const auto& [k, v] : d) {
-            vm->call(obj, __setitem__, pkpy::twoArgs(vm->PyStr(k), v));
+            vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, vm->PyStr(k), v));
         }
         return obj;
     });
 
     _vm->bindBuiltinFunc("locals", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 0);
-        const auto& d = vm->top_frame()->f_locals;
+        const auto& d = vm->top_frame()->f_locals_copy(vm);
         PyVar obj = vm->call(vm->builtins->attribs["dict"]);
         for (const auto& [k, v] : d) {
-            vm->call(obj, __setitem__, pkpy::twoArgs(vm->PyStr(k), v));
+            vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, vm->PyStr(k), v));
         }
         return obj;
     });
@@ -133,9 +233,8 @@ void __initializeBuiltinFunctions(VM* _vm) {
 
     _vm->bindBuiltinFunc("dir", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1);
-        std::vector<_Str> names;
-        for (auto& [k, _] : args[0]->attribs) names.push_back(k);
-        for (auto& [k, _] : args[0]->_type->attribs) {
+        std::vector<_Str> names = args[0]->attribs.keys();
+        for (auto& [k, _] : vm->_tp(args[0])->attribs) {
             if (k.find("__") == 0) continue;
             if (std::find(names.begin(), names.end(), k) == names.end()) names.push_back(k);
         }
@@ -150,14 +249,14 @@ void __initializeBuiltinFunctions(VM* _vm) {
     _vm->bindMethod("object", "__repr__", [](VM* vm, const pkpy::ArgList& args) {
         PyVar _self = args[0];
         std::stringstream ss;
-        ss << std::hex << (uintptr_t)_self.get();
-        _Str s = "<" + UNION_TP_NAME(_self) + " object at 0x" + ss.str() + ">";
+        ss << std::hex << _self.bits();
+        _Str s = "<" + UNION_NAME(vm->_tp(_self)) + " object at 0x" + ss.str() + ">";
         return vm->PyStr(s);
     });
 
     _vm->bindMethod("type", "__new__", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1);
-        return args[0]->_type;
+        return vm->_tp(args[0]);
     });
 
     _vm->bindMethod("type", "__eq__", [](VM* vm, const pkpy::ArgList& args) {
@@ -183,6 +282,12 @@ void __initializeBuiltinFunctions(VM* _vm) {
         );
     });
 
+    // generators are iterated directly
+    _vm->bindMethod("_native_iterator", "__iter__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_type(args[0], vm->_tp_native_iterator);
+        return args[0];
+    });
+
     _vm->bindMethod("NoneType", "__repr__", [](VM* vm, const pkpy::ArgList& args) {
         return vm->PyStr("None");
     });
@@ -323,6 +428,16 @@ void __initializeBuiltinFunctions(VM* _vm) {
         return vm->PyStr(lhs + rhs);
     });
 
+    _vm->bindMethod("str", "__mul__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2, true);
+        const _Str& _self = vm->PyStr_AS_C(args[0]);
+        i64 n = vm->PyInt_AS_C(args[1]);
+        _Str s;
+        if(n > 0) s.reserve(_self.size() * n);
+        for(i64 i = 0; i < n; i++) s += _self;
+        return vm->PyStr(std::move(s));
+    });
+
     _vm->bindMethod("str", "__len__", [](VM* vm, const pkpy::ArgList& args) {
         const _Str& _self = vm->PyStr_AS_C(args[0]);
         return vm->PyInt(_self.u8_length());
@@ -369,7 +484,7 @@ void __initializeBuiltinFunctions(VM* _vm) {
 
         int _index = (int)vm->PyInt_AS_C(args[1]);
         _index = vm->normalizedIndex(_index, _self.u8_length());
-        return vm->PyStr(_self.u8_getitem(_index));
+        return vm->PyStrChar(_self, _index);
     });
 
     _vm->bindMethod("str", "__gt__", [](VM* vm, const pkpy::ArgList& args) {
@@ -389,13 +504,17 @@ void __initializeBuiltinFunctions(VM* _vm) {
         const _Str& _self = vm->PyStr_AS_C(args[0]);
         const _Str& _old = vm->PyStr_AS_C(args[1]);
         const _Str& _new = vm->PyStr_AS_C(args[2]);
-        _Str _copy = _self;
-        // replace all occurences of _old with _new in _copy
-        size_t pos = 0;
-        while ((pos = _copy.find(_old, pos)) != std::string::npos) {
-            _copy.replace(pos, _old.length(), _new);
-            pos += _new.length();
+        if(_old.empty()) return args[0];
+        // replace all occurences of _old with _new
+        _Str _copy;
+        size_t pos, prev = 0;
+        while ((pos = _self.find(_old, prev)) != _Str::npos) {
+            _copy += _self.view().substr(prev, pos - prev);
+            _copy += _new;
+            prev = pos + _old.length();
         }
+        if(prev == 0) return args[0];
+        _copy += _self.view().substr(prev);
         return vm->PyStr(_copy);
     });
 
@@ -416,23 +535,27 @@ void __initializeBuiltinFunctions(VM* _vm) {
     _vm->bindMethod("str", "join", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 2, true);
         const _Str& _self = vm->PyStr_AS_C(args[0]);
-        PyVarList* _list;
-        if(args[1]->is_type(vm->_tp_list)){
-            _list = &vm->PyList_AS_C(args[1]);
-        }else if(args[1]->is_type(vm->_tp_tuple)){
-            _list = &vm->PyTuple_AS_C(args[1]);
-        }else{
-            vm->typeError("can only join a list or tuple");
-        }
-        _StrStream ss;
-        for(int i = 0; i < _list->size(); i++){
-            if(i > 0) ss << _self;
-            ss << vm->PyStr_AS_C(vm->asStr(_list->operator[](i)));
+        _Str s;
+        PyVar it = vm->asIter(args[1]);
+        const _Iterator& iter = vm->PyIter_AS_C(it);
+        for(bool first = true; iter->hasNext(); first = false){
+            if(!first) s += _self;
+            s += vm->PyStr_AS_C(vm->asStr(iter->next()));
         }
-        return vm->PyStr(ss.str());
+        return vm->PyStr(std::move(s));
     });
 
     /************ PyList ************/
+    _vm->bindMethod("list", "__new__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1);
+        if(args[0]->is_type(vm->_tp_list)) return vm->PyList_COPY(args[0]);
+        PyVar it = vm->asIter(args[0]);
+        const _Iterator& iter = vm->PyIter_AS_C(it);
+        PyVarList items;
+        while(iter->hasNext()) items.push_back(iter->next());
+        return vm->PyList(std::move(items));
+    });
+
     _vm->bindMethod("list", "__iter__", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_type(args[0], vm->_tp_list);
         return vm->PyIter(
@@ -442,39 +565,50 @@ void __initializeBuiltinFunctions(VM* _vm) {
 
     _vm->bindMethod("list", "append", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 2, true);
-        PyVarList& _self = vm->PyList_AS_C(args[0]);
+        PyVarList& _self = vm->PyList_AS_MUT(args[0]);
         _self.push_back(args._index(1));
+        vm->__list_stored(args[0], args._index(1));
         return vm->None;
     });
 
     _vm->bindMethod("list", "insert", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 3, true);
-        PyVarList& _self = vm->PyList_AS_C(args[0]);
+        PyVarList& _self = vm->PyList_AS_MUT(args[0]);
         int _index = (int)vm->PyInt_AS_C(args[1]);
         if(_index < 0) _index += _self.size();
         if(_index < 0) _index = 0;
         if(_index > _self.size()) _index = _self.size();
         _self.insert(_self.begin() + _index, args[2]);
+        vm->__list_stored(args[0], args[2]);
         return vm->None;
     });
 
     _vm->bindMethod("list", "clear", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1, true);
-        vm->PyList_AS_C(args[0]).clear();
+        vm->check_type(args[0], vm->_tp_list);
+        _List& items = UNION_GET(_List, args[0]);
+        if(items.use_count() == 1) items->clear();
+        else items = pkpy::make_shared<PyVarList>();
+        pkpy::__set_object_bits(args[0].get(), LIST_EMPTY);
         return vm->None;
     });
 
     _vm->bindMethod("list", "copy", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1, true);
-        return vm->PyList(vm->PyList_AS_C(args[0]));
+        vm->check_type(args[0], vm->_tp_list);
+        return vm->PyList_COPY(args[0]);
     });
 
     _vm->bindMethod("list", "__add__", [](VM* vm, const pkpy::ArgList& args) {
         const PyVarList& _self = vm->PyList_AS_C(args[0]);
         const PyVarList& _obj = vm->PyList_AS_C(args[1]);
-        PyVarList _new_list = _self;
+        if(_obj.empty()) return vm->PyList_COPY(args[0]);
+        if(_self.empty()) return vm->PyList_COPY(args[1]);
+        PyVarList _new_list;
+        _new_list.reserve(_self.size() + _obj.size());
+        _new_list.insert(_new_list.end(), _self.begin(), _self.end());
         _new_list.insert(_new_list.end(), _obj.begin(), _obj.end());
-        return vm->PyList(_new_list);
+        return vm->PyList(std::move(_new_list));
     });
 
     _vm->bindMethod("list", "__len__", [](VM* vm, const pkpy::ArgList& args) {
@@ -488,10 +622,9 @@ void __initializeBuiltinFunctions(VM* _vm) {
         if(args[1]->is_type(vm->_tp_slice)){
             _Slice s = vm->PySlice_AS_C(args[1]);
             s.normalize(_self.size());
-            PyVarList _new_list;
-            for(size_t i = s.start; i < s.stop; i++)
-                _new_list.push_back(_self[i]);
-            return vm->PyList(_new_list);
+            if(s.start == 0 && s.stop == (int)_self.size()) return vm->PyList_COPY(args[0]);
+            if(s.start >= s.stop) return vm->PyList(PyVarList());
+            return vm->PyList(PyVarList(_self.begin() + s.start, _self.begin() + s.stop));
         }
 
         int _index = (int)vm->PyInt_AS_C(args[1]);
@@ -500,42 +633,75 @@ void __initializeBuiltinFunctions(VM* _vm) {
     });
 
     _vm->bindMethod("list", "__setitem__", [](VM* vm, const pkpy::ArgList& args) {
-        PyVarList& _self = vm->PyList_AS_C(args[0]);
+        PyVarList& _self = vm->PyList_AS_MUT(args[0]);
         int _index = (int)vm->PyInt_AS_C(args[1]);
         _index = vm->normalizedIndex(_index, _self.size());
         _self[_index] = args[2];
+        vm->__list_stored(args[0], args[2]);
         return vm->None;
     });
 
     _vm->bindMethod("list", "__delitem__", [](VM* vm, const pkpy::ArgList& args) {
-        PyVarList& _self = vm->PyList_AS_C(args[0]);
+        PyVarList& _self = vm->PyList_AS_MUT(args[0]);
         int _index = (int)vm->PyInt_AS_C(args[1]);
         _index = vm->normalizedIndex(_index, _self.size());
         _self.erase(_self.begin() + _index);
+        if(_self.empty()) pkpy::__set_object_bits(args[0].get(), LIST_EMPTY);
         return vm->None;
     });
 
+    _vm->bindMethod("list", "__contains__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2, true);
+        const PyVarList& _self = vm->PyList_AS_C(args[0]);
+        const PyVar& _item = args[1];
+        ListStrategy s = vm->list_strategy(args[0]);
+        if(s != LIST_OBJECT && s == vm->__item_strategy(_item)){
+            switch(s){
+                case LIST_INT:
+                    for(const PyVar& x : _self) if(x == _item) return vm->True;
+                    return vm->False;
+                case LIST_FLOAT: {
+                    f64 val = vm->PyFloat_AS_C(_item);
+                    for(const PyVar& x : _self) if(vm->PyFloat_AS_C(x) == val) return vm->True;
+                    return vm->False;
+                }
+                case LIST_STR: {
+                    const _Str& val = vm->PyStr_AS_C(_item);
+                    for(const PyVar& x : _self) if(vm->PyStr_AS_C(x) == val) return vm->True;
+                    return vm->False;
+                }
+                default: break;
+            }
+        }
+        // `__eq__` may change the list, so it is looked up again each time
+        for(size_t i = 0; i < vm->PyList_AS_C(args[0]).size(); i++){
+            PyVar x = vm->PyList_AS_C(args[0])[i];
+            if(vm->asBool(vm->call_slot(SLOT_EQ, pkpy::twoArgs(x, _item))) == vm->True) return vm->True;
+        }
+        return vm->False;
+    });
+
     /************ PyTuple ************/
     _vm->bindMethod("tuple", "__new__", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1);
         PyVarList _list = vm->PyList_AS_C(vm->call(vm->builtins->attribs["list"], args));
-        return vm->PyTuple(_list);
+        return vm->PyTuple(std::move(_list));
     });
 
     _vm->bindMethod("tuple", "__iter__", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_type(args[0], vm->_tp_tuple);
         return vm->PyIter(
-            pkpy::make_shared<BaseIterator, VectorIterator>(vm, args[0])
+            pkpy::make_shared<BaseIterator, TupleIterator>(vm, args[0])
         );
     });
 
     _vm->bindMethod("tuple", "__len__", [](VM* vm, const pkpy::ArgList& args) {
-        const PyVarList& _self = vm->PyTuple_AS_C(args[0]);
+        const PyTupleObject& _self = vm->PyTuple_AS_C(args[0]);
         return vm->PyInt(_self.size());
     });
 
     _vm->bindMethod("tuple", "__getitem__", [](VM* vm, const pkpy::ArgList& args) {
-        const PyVarList& _self = vm->PyTuple_AS_C(args[0]);
+        const PyTupleObject& _self = vm->PyTuple_AS_C(args[0]);
         int _index = (int)vm->PyInt_AS_C(args[1]);
         _index = vm->normalizedIndex(_index, _self.size());
         return _self[_index];
@@ -640,6 +806,26 @@ void __addModuleSys(VM* vm){
         return vm->None;
     });
 
+    // counters of the object pool of this thread, see `pkpy::MemoryPool`
+    vm->bindFunc(mod, "allocstats", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        pkpy::PoolStats st = pkpy::__pool.stats;      // a copy, building the dict allocates
+        PyVarList by_class;
+        for(int64_t n : st.by_class) by_class.push_back(vm->PyInt(n));
+        PyVar obj = vm->call(vm->builtins->attribs["dict"]);
+        auto set = [&](const char* key, PyVar val){
+            vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, vm->PyStr(key), std::move(val)));
+        };
+        set("allocs", vm->PyInt(st.allocs));
+        set("frees", vm->PyInt(st.frees));
+        set("large", vm->PyInt(st.large));
+        set("slab_bytes", vm->PyInt(st.slab_bytes));
+        set("deferred", vm->PyInt(st.deferred));
+        set("pending", vm->PyInt(pkpy::__pool.frees.blocks.size()));
+        set("by_class", vm->PyList(by_class));
+        return obj;
+    });
+
     vm->setattr(mod, "version", vm->PyStr(PK_VERSION));
 }
 
@@ -649,7 +835,7 @@ void __addModuleJson(VM* vm){
         vm->check_args_size(args, 1);
         const _Str& expr = vm->PyStr_AS_C(args[0]);
         _Code code = vm->compile(expr, "<json>", JSON_MODE);
-        return vm->_exec(code, vm->top_frame()->_module, vm->top_frame()->f_locals_copy());
+        return vm->_exec(code, vm->top_frame()->_module, vm->top_frame()->f_locals_copy(vm));
     });
 
     vm->bindFunc(mod, "dumps", [](VM* vm, const pkpy::ArgList& args) {
@@ -711,25 +897,29 @@ void __addModuleMath(VM* vm){
     });
 }
 
+const _Str& m_start = _Str::intern("_start");
+const _Str& m_end = _Str::intern("_end");
+const _Str& m_groups = _Str::intern("_groups");
+
 PyVar __regex_search(const _Str& pattern, const _Str& string, bool fromStart, VM* vm){
-    std::regex re(pattern);
-    std::smatch m;
-    if(std::regex_search(string, m, re)){
+    std::regex re(pattern.str());
+    std::cmatch m;
+    if(std::regex_search(string.begin(), string.end(), m, re)){
         if(fromStart && m.position() != 0){
             return vm->None;
         }
         PyVar ret = vm->new_object(vm->_userTypes["re.Match"], (i64)1);
-        vm->setattr(ret, "_start", vm->PyInt(
+        vm->setattr(ret, m_start, vm->PyInt(
             string.__to_u8_index(m.position())
         ));
-        vm->setattr(ret, "_end", vm->PyInt(
+        vm->setattr(ret, m_end, vm->PyInt(
             string.__to_u8_index(m.position() + m.length())
         ));
         PyVarList groups(m.size());
         for(size_t i = 0; i < m.size(); ++i){
             groups[i] = vm->PyStr(m[i].str());
         }
-        vm->setattr(ret, "_groups", vm->PyTuple(groups));
+        vm->setattr(ret, m_groups, vm->PyTuple(groups));
         return ret;
     }
     return vm->None;
@@ -742,26 +932,26 @@ void __addModuleRe(VM* vm){
     vm->bindMethod("re.Match", "start", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1, true);
         PyVar self = args[0];
-        return vm->getattr(self, "_start");
+        return vm->getattr(self, m_start);
     });
 
     vm->bindMethod("re.Match", "end", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1, true);
         PyVar self = args[0];
-        return vm->getattr(self, "_end");
+        return vm->getattr(self, m_end);
     });
 
     vm->bindMethod("re.Match", "span", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 1, true);
         PyVar self = args[0];
-        PyVarList vec = { vm->getattr(self, "_start"), vm->getattr(self, "_end") };
+        PyVarList vec = { vm->getattr(self, m_start), vm->getattr(self, m_end) };
         return vm->PyTuple(vec);
     });
 
     vm->bindMethod("re.Match", "group", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 2, true);
         int index = (int)vm->PyInt_AS_C(args[1]);
-        const auto& vec = vm->PyTuple_AS_C(vm->getattr(args[0], "_groups"));
+        const auto& vec = vm->PyTuple_AS_C(vm->getattr(args[0], m_groups));
         vm->normalizedIndex(index, vec.size());
         return vec[index];
     });
@@ -785,17 +975,17 @@ void __addModuleRe(VM* vm){
         const _Str& pattern = vm->PyStr_AS_C(args[0]);
         const _Str& repl = vm->PyStr_AS_C(args[1]);
         const _Str& string = vm->PyStr_AS_C(args[2]);
-        std::regex re(pattern);
-        return vm->PyStr(std::regex_replace(string, re, repl));
+        std::regex re(pattern.str());
+        return vm->PyStr(std::regex_replace(string.str(), re, repl.str()));
     });
 
     vm->bindFunc(mod, "split", [](VM* vm, const pkpy::ArgList& args) {
         vm->check_args_size(args, 2);
         const _Str& pattern = vm->PyStr_AS_C(args[0]);
         const _Str& string = vm->PyStr_AS_C(args[1]);
-        std::regex re(pattern);
-        std::sregex_token_iterator it(string.begin(), string.end(), re, -1);
-        std::sregex_token_iterator end;
+        std::regex re(pattern.str());
+        std::cregex_token_iterator it(string.begin(), string.end(), re, -1);
+        std::cregex_token_iterator end;
         PyVarList vec;
         for(; it != end; ++it){
             vec.push_back(vm->PyStr(it->str()));
@@ -804,6 +994,164 @@ void __addModuleRe(VM* vm){
     });
 }
 
+// the cycle collector of the thread the VM runs on, see gc.h
+void __addModuleGc(VM* vm){
+    PyVar mod = vm->newModule("gc");
+    vm->bindFunc(mod, "collect", [](VM* vm, const pkpy::ArgList& args) {
+        if(args.size() > 1) vm->typeError("collect() takes at most 1 argument");
+        int gen = args.size() == 0 ? pkpy::GCState::N_GENS - 1 : (int)vm->PyInt_AS_C(args[0]);
+        if(gen < 0 || gen >= pkpy::GCState::N_GENS) vm->valueError("invalid generation");
+        return vm->PyInt(pkpy::gc_collect(gen));
+    });
+
+    vm->bindFunc(mod, "enable", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        pkpy::__gc_state().enabled = true;
+        return vm->None;
+    });
+
+    vm->bindFunc(mod, "disable", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        pkpy::__gc_state().enabled = false;
+        return vm->None;
+    });
+
+    vm->bindFunc(mod, "isenabled", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        return vm->PyBool(pkpy::__gc_state().enabled);
+    });
+
+    vm->bindFunc(mod, "get_threshold", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        PyVarList ret;
+        for(int t : pkpy::__gc_state().thresholds) ret.push_back(vm->PyInt(t));
+        return vm->PyTuple(ret);
+    });
+
+    vm->bindFunc(mod, "set_threshold", [](VM* vm, const pkpy::ArgList& args) {
+        if(args.size() < 1 || args.size() > pkpy::GCState::N_GENS) vm->typeError("set_threshold() takes 1 to 3 arguments");
+        for(int i=0; i<args.size(); i++) pkpy::__gc_state().thresholds[i] = (int)vm->PyInt_AS_C(args[i]);
+        return vm->None;
+    });
+
+    // releases done in one go, or per safepoint, before the rest is deferred, 0 for no limit
+    vm->bindFunc(mod, "get_free_budget", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        return vm->PyInt(pkpy::__pool.frees.budget);
+    });
+
+    vm->bindFunc(mod, "set_free_budget", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1);
+        i64 budget = vm->PyInt_AS_C(args[0]);
+        if(budget < 0 || budget > std::numeric_limits<int>::max()) vm->valueError("invalid budget");
+        pkpy::__pool.frees.budget = (int)budget;
+        return vm->None;
+    });
+
+    vm->bindFunc(mod, "get_count", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        PyVarList ret;
+        for(int c : pkpy::__gc_state().counts) ret.push_back(vm->PyInt(c));
+        return vm->PyTuple(ret);
+    });
+
+    vm->bindFunc(mod, "get_stats", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 0);
+        PyVarList ret;
+        for(const pkpy::GCGenStats& st : pkpy::__gc_state().stats){
+            PyVar obj = vm->call(vm->builtins->attribs["dict"]);
+            vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, vm->PyStr("collections"), vm->PyInt(st.collections)));
+            vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, vm->PyStr("collected"), vm->PyInt(st.collected)));
+            ret.push_back(obj);
+        }
+        return vm->PyList(ret);
+    });
+}
+
+// references which don't keep their object alive, see `_WeakRef`. The dictionaries built
+// on them are in python, in the `weakref` module
+void __addModuleWeakref(VM* vm){
+    PyVar mod = vm->newModule("_weakref");
+    vm->new_user_type_object(mod, "ref", vm->_tp_object);
+
+    vm->bindMethod("_weakref.ref", "__new__", [](VM* vm, const pkpy::ArgList& args) {
+        if(args.size() < 1 || args.size() > 2) vm->typeError("ref() takes 1 or 2 arguments");
+        return vm->PyWeakRef(args[0], args.size() == 2 ? args[1] : vm->None);
+    });
+
+    // the object, or None once it is released
+    vm->bindMethod("_weakref.ref", "__call__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1, true);
+        vm->check_type(args[0], vm->_userTypes["_weakref.ref"]);
+        int* p = UNION_GET(_WeakRef, args[0]).slot->block;
+        if(p == nullptr) return vm->None;
+        return PyVar::share(p);
+    });
+
+    // the references to an object are equal even once it is released, so they stay usable as keys
+    vm->bindMethod("_weakref.ref", "__eq__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2, true);
+        vm->check_type(args[0], vm->_userTypes["_weakref.ref"]);
+        if(vm->_tp(args[1]) != vm->_tp(args[0])) return vm->False;
+        return vm->PyBool(UNION_GET(_WeakRef, args[0]).slot == UNION_GET(_WeakRef, args[1]).slot);
+    });
+
+    vm->bindMethod("_weakref.ref", "__hash__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1, true);
+        vm->check_type(args[0], vm->_userTypes["_weakref.ref"]);
+        return vm->PyInt((i64)(UNION_GET(_WeakRef, args[0]).slot.bits() >> 4));
+    });
+
+    vm->bindMethod("_weakref.ref", "__repr__", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1, true);
+        vm->check_type(args[0], vm->_userTypes["_weakref.ref"]);
+        int* p = UNION_GET(_WeakRef, args[0]).slot->block;
+        if(p == nullptr) return vm->PyStr("<weakref; dead>");
+        return vm->PyStr("<weakref; to '" + UNION_NAME(vm->_tp(PyVar::share(p))) + "'>");
+    });
+
+    vm->bindFunc(mod, "getweakrefcount", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1);
+        if(!args[0].is_heap() || !(((int*)args[0].bits())[1] & pkpy::WEAKLY_REFERENCED)) return vm->PyInt(0);
+        pkpy::WeakTable* owner;
+        pkpy::shared_ptr<pkpy::WeakSlot>* slot = pkpy::__weak_find((int*)args[0].bits(), owner);
+        if(slot == nullptr) return vm->PyInt(0);
+        return vm->PyInt(slot->use_count() - 1);
+    });
+}
+
+// an in-memory text stream, whose writes append to one buffer in place
+void __addModuleIo(VM* vm){
+    PyVar mod = vm->newModule("io");
+    vm->new_user_type_object(mod, "StringIO", vm->_tp_object);
+
+    vm->bindMethod("io.StringIO", "__new__", [](VM* vm, const pkpy::ArgList& args) {
+        if(args.size() > 1) vm->typeError("StringIO() takes at most 1 argument");
+        _Str value = args.size() == 1 ? vm->PyStr_AS_C(args[0]) : _Str();
+        return vm->new_object(vm->_userTypes["io.StringIO"], std::move(value));
+    });
+
+    // returns the number of characters written
+    vm->bindMethod("io.StringIO", "write", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 2, true);
+        vm->check_type(args[0], vm->_userTypes["io.StringIO"]);
+        const _Str& s = vm->PyStr_AS_C(args[1]);
+        UNION_GET(_Str, args[0]) += s;
+        return vm->PyInt(s.u8_length());
+    });
+
+    vm->bindMethod("io.StringIO", "getvalue", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1, true);
+        vm->check_type(args[0], vm->_userTypes["io.StringIO"]);
+        return vm->PyStr(UNION_GET(_Str, args[0]));
+    });
+
+    vm->bindMethod("io.StringIO", "close", [](VM* vm, const pkpy::ArgList& args) {
+        vm->check_args_size(args, 1, true);
+        return vm->None;
+    });
+}
+
 class _PkExported{
 public:
     virtual ~_PkExported() = default;
@@ -844,6 +1192,7 @@ extern "C" {
             if(_pkLookupTable[i]->get() == p){
                 delete _pkLookupTable[i];
                 _pkLookupTable.erase(_pkLookupTable.begin() + i);
+                pkpy::__drain_frees(0);     // what a deleted vm left queued, see `pkpy::FreeQueue`
                 return;
             }
         }
@@ -862,10 +1211,11 @@ extern "C" {
     /// Return a json representing the result.
     /// If the variable is not found, return `nullptr`.
     char* pkpy_vm_get_global(VM* vm, const char* name){
-        auto it = vm->_main->attribs.find(name);
-        if(it == vm->_main->attribs.end()) return nullptr;
+        pkpy::HeapScope scope(vm->heap());
+        PyVar* val = vm->_main->attribs.try_get(name);
+        if(val == nullptr) return nullptr;
         try{
-            _Str _json = vm->PyStr_AS_C(vm->asJson(it->second));
+            _Str _json = vm->PyStr_AS_C(vm->asJson(*val));
             return strdup(_json.c_str());
         }catch(...){
             return nullptr;
@@ -878,6 +1228,7 @@ extern "C" {
     /// Return a json representing the result.
     /// If there is any error, return `nullptr`.
     char* pkpy_vm_eval(VM* vm, const char* source){
+        pkpy::HeapScope scope(vm->heap());
         PyVarOrNull ret = vm->exec(source, "<eval>", EVAL_MODE);
         if(ret == nullptr) return nullptr;
         try{
@@ -913,12 +1264,16 @@ extern "C" {
     }
 
     void __vm_init(VM* vm){
+        pkpy::HeapScope scope(vm->heap());
         __initializeBuiltinFunctions(vm);
         __addModuleSys(vm);
         __addModuleTime(vm);
         __addModuleJson(vm);
         __addModuleMath(vm);
         __addModuleRe(vm);
+        __addModuleGc(vm);
+        __addModuleWeakref(vm);
+        __addModuleIo(vm);
 
         // add builtins | no exception handler | must succeed
         _Code code = vm->compile(__BUILTINS_CODE, "<builtins>", EXEC_MODE);
@@ -926,6 +1281,8 @@ extern "C" {
 
         pkpy_vm_add_module(vm, "random", __RANDOM_CODE);
         pkpy_vm_add_module(vm, "os", __OS_CODE);
+        pkpy_vm_add_module(vm, "weakref", __WEAKREF_CODE);
+        for(auto& [name, loader] : __aot_registry()) vm->addAotModule(name, loader);
     }
 
     __EXPORT
@@ -936,6 +1293,32 @@ extern "C" {
         return vm;
     }
 
+    __EXPORT
+    /// Create a virtual machine whose objects all come from an arena of `capacity` bytes,
+    /// given back at once when the virtual machine is deleted.
+    /// A script which needs more than the quota of the arena gets a `MemoryError`.
+    VM* pkpy_new_vm_with_arena(bool use_stdio, int64_t capacity){
+        VM* vm = pkpy_allocate(VM, use_stdio, (size_t)std::max<int64_t>(capacity, 0));
+        __vm_init(vm);
+        return vm;
+    }
+
+    __EXPORT
+    /// Set the bytes the objects of a virtual machine with an arena may use.
+    /// `0` sets it back to the whole arena.
+    void pkpy_vm_set_memory_quota(VM* vm, int64_t quota){
+        vm->set_memory_quota((size_t)quota);
+    }
+
+    __EXPORT
+    /// Get the bytes in use by the objects of a virtual machine with an arena.
+    ///
+    /// Return `-1` for a virtual machine without one.
+    int64_t pkpy_vm_get_memory_usage(VM* vm){
+        if(vm->arena() == nullptr) return -1;
+        return (int64_t)vm->arena()->used;
+    }
+
     __EXPORT
     /// Create a virtual machine that supports asynchronous execution.
     ThreadedVM* pkpy_new_tvm(bool use_stdio){
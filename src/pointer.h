@@ -26,10 +26,21 @@ struct NameRef : BaseRef {
     void del(VM* vm, Frame* frame) const;
 };
 
+// a local annotated as `int` or `float`, see `TypedLocal`
+struct TypedLocalRef : BaseRef {
+    int index;
+    TypedLocalRef(int index) : index(index) {}
+
+    PyVar get(VM* vm, Frame* frame) const;
+    void set(VM* vm, Frame* frame, PyVar val) const;
+    void del(VM* vm, Frame* frame) const;
+};
+
 struct AttrRef : BaseRef {
     mutable PyVar obj;
     const NameRef attr;
-    AttrRef(PyVar obj, const NameRef attr) : obj(obj), attr(attr) {}
+    int cache;          // the name's index in co_names for `CodeObject::attr_cache`, -1 for none
+    AttrRef(PyVar obj, const NameRef attr, int cache=-1) : obj(obj), attr(attr), cache(cache) {}
 
     PyVar get(VM* vm, Frame* frame) const;
     void set(VM* vm, Frame* frame, PyVar val) const;
@@ -0,0 +1,710 @@
+#pragma once
+
+#include "vm.h"
+
+// An alternative register-based tier, enabled by PKPY_REGISTER_TIER.
+//
+// `RegTranslator` rewrites the stack bytecode of a code object into three-address instructions
+// over a register file. Register d holds whatever the stack machine would have at depth d.
+// Constants, names and typed locals are never pushed: they become operands of the instruction
+// that consumes them, so `LOAD_NAME`, `DUP_TOP`, `POP_TOP` and most stores disappear.
+// A code object using anything the translator does not handle stays on the stack tier.
+
+#ifdef PKPY_REGISTER_TIER
+
+#define PKPY_REG_OPCODES(X)                                                                     \
+    X(MOVE) X(BINARY) X(BINARY_INT) X(BINARY_FLOAT) X(BITWISE) X(COMPARE) X(COMPARE_NUM)       \
+    X(IS) X(CONTAINS) X(NEGATIVE) X(NOT) X(GETATTR) X(SETATTR) X(GETITEM) X(SETITEM)           \
+    X(CALL) X(RETURN) X(JUMP) X(JUMP_IF_FALSE) X(JUMP_IF_TRUE) X(GET_ITER) X(FOR_ITER)         \
+    X(BUILD_LIST) X(BUILD_TUPLE) X(BUILD_SLICE) X(LIST_APPEND) X(ASSERT) X(RAISE)             \
+    X(INLINE_CALL) X(HOIST_LEN) X(LOAD_HOISTED_LEN)
+
+enum RegOpcode : uint8_t {
+    #define X(name) ROP_##name,
+    PKPY_REG_OPCODES(X)
+    #undef X
+};
+
+static const char* REG_OP_NAMES[] = {
+    #define X(name) #name,
+    PKPY_REG_OPCODES(X)
+    #undef X
+};
+
+enum RegArgKind : uint8_t {
+    RA_REG,
+    RA_CONST,       // co_consts
+    RA_NAME,        // co_names
+    RA_TYPED,       // a typed local
+    RA_LITERAL,     // None, True, False, Ellipsis
+};
+
+struct RegArg {
+    RegArgKind kind = RA_REG;
+    int index = -1;
+
+    bool operator==(const RegArg& other) const { return kind == other.kind && index == other.index; }
+    bool operator!=(const RegArg& other) const { return !(*this == other); }
+};
+
+struct RegInstr {
+    RegOpcode op;
+    int arg = -1;
+    int target = -1;    // jump target in `RegCode::code`
+    int src = -1;       // the bytecode it came from, for tracebacks
+    RegArg dst, a, b, c;
+};
+
+struct RegCode {
+    std::vector<RegInstr> code;
+    std::vector<RegArg> operands;     // arguments of CALL, BUILD_LIST and BUILD_TUPLE, from `b.index`
+    int nregs = 0;
+
+    _Str to_string() const {
+        static const char* KINDS = "rcntl";
+        auto arg_str = [](const RegArg& x) -> _Str {
+            if(x.index < 0) return "";
+            return _Str(std::string(1, KINDS[x.kind]) + std::to_string(x.index));
+        };
+        _StrStream ss;
+        for(int i=0; i<code.size(); i++){
+            const RegInstr& ins = code[i];
+            ss << pad(std::to_string(i), 4) << pad(REG_OP_NAMES[ins.op], 18);
+            bool pooled = ins.op == ROP_CALL || ins.op == ROP_BUILD_LIST || ins.op == ROP_BUILD_TUPLE;
+            _Str b = pooled ? _Str("@" + std::to_string(ins.b.index)) : arg_str(ins.b);
+            ss << pad(arg_str(ins.dst), 6) << pad(arg_str(ins.a), 6) << pad(b, 6) << pad(arg_str(ins.c), 6);
+            if(ins.arg >= 0) ss << " arg=" << ins.arg;
+            if(ins.target >= 0) ss << " -> " << ins.target;
+            ss << '\n';
+        }
+        return ss.str();
+    }
+};
+
+class RegTranslator {
+    struct Entry {
+        enum Kind { VALUE, NAME_REF, TYPED_REF, INDEX_REF, ATTR_REF } kind = VALUE;
+        RegArg v;           // the value, or the object of INDEX_REF and ATTR_REF
+        RegArg idx;         // the index of INDEX_REF
+        RegArg target;      // where NAME_REF and TYPED_REF store to
+        int name = -1;      // the attribute of ATTR_REF
+
+        bool operator==(const Entry& other) const {
+            return kind == other.kind && v == other.v && idx == other.idx && target == other.target && name == other.name;
+        }
+    };
+    struct Unsupported {};
+
+    // registers above the stack are numbered from here until `translate` knows the max depth
+    static const int EXTRA_BASE = 1 << 20;
+
+    const CodeObject* co;
+    std::shared_ptr<RegCode> rc;
+    std::vector<Entry> stack;
+    std::map<int, std::vector<Entry>> state_at;     // the stack at each jump target
+    std::vector<int> work;                          // jump targets not translated yet
+    std::map<int, int> start_of;                    // first instruction of each translated block
+    std::map<int, RegArg> iter_vars;                // loop variable of the iterator in each register
+    bool reachable = true;
+    int curr = 0;
+    int extra = 0;
+    int max_depth = 0;
+    int last_def = -1;      // the last instruction, if its dst may be retargeted by a store
+
+    static RegArg reg(int i){ return {RA_REG, i}; }
+    RegArg fresh(){ return reg(EXTRA_BASE + extra++); }
+
+    int emit(RegInstr ins, bool may_run_code){
+        // code run by the instruction may rebind a name which is still pending on the stack
+        if(may_run_code) flush_if([](const RegArg& x){ return x.kind == RA_NAME; });
+        ins.src = curr;
+        rc->code.push_back(ins);
+        last_def = -1;
+        return rc->code.size() - 1;
+    }
+
+    void move(RegArg dst, RegArg src){
+        RegInstr ins{ROP_MOVE};
+        ins.dst = dst; ins.a = src;
+        emit(ins, false);
+    }
+
+    // reads the pending operands matching `pred` into registers
+    template<typename Pred>
+    void flush_if(Pred pred){
+        for(int p=0; p<stack.size(); p++){
+            Entry& e = stack[p];
+            // like the stack machine, a NAME_REF is only read when it is used as a value
+            if(e.kind == Entry::NAME_REF || e.kind == Entry::TYPED_REF) continue;
+            if(pred(e.v)){ move(reg(p), e.v); e.v = reg(p); }
+            if(e.kind == Entry::INDEX_REF && pred(e.idx)){
+                RegArg r = fresh();
+                move(r, e.idx); e.idx = r;
+            }
+        }
+    }
+
+    // puts every value at its own register, as the stack machine would have it
+    void materialize(){
+        for(int p=0; p<stack.size(); p++){
+            Entry& e = stack[p];
+            if(e.kind == Entry::INDEX_REF || e.kind == Entry::ATTR_REF) throw Unsupported();
+            if(e.kind != Entry::VALUE) continue;
+            if(e.v != reg(p)){ move(reg(p), e.v); e.v = reg(p); }
+        }
+    }
+
+    // `state` is the stack when jumping to `target`, which is translated later if it is new
+    void record(int target, const std::vector<Entry>& state){
+        auto it = state_at.find(target);
+        if(it == state_at.end()){
+            state_at[target] = state;
+            work.push_back(target);
+            return;
+        }
+        if(it->second != state) throw Unsupported();
+    }
+
+    void push(Entry e){
+        stack.push_back(e);
+        max_depth = std::max(max_depth, (int)stack.size());
+    }
+
+    void push_value(RegArg v){ Entry e; e.v = v; push(e); }
+
+    // the value at depth `p`, reading through a reference in place like `Frame::pop_value`
+    RegArg value_at(int p){
+        Entry& e = stack[p];
+        if(e.kind == Entry::INDEX_REF || e.kind == Entry::ATTR_REF){
+            RegInstr ins{e.kind == Entry::INDEX_REF ? ROP_GETITEM : ROP_GETATTR};
+            ins.dst = reg(p); ins.a = e.v; ins.b = e.idx; ins.arg = e.name;
+            emit(ins, true);
+            stack[p] = Entry(); stack[p].v = reg(p);
+        }
+        return stack[p].v;
+    }
+
+    // pops `n` values, reading the top one first
+    std::vector<RegArg> pop_values(int n){
+        int d = stack.size();
+        if(n > d) throw Unsupported();
+        for(int k=n-1; k>=0; k--) value_at(d-n+k);
+        // reading one value may have flushed another
+        std::vector<RegArg> values(n);
+        for(int k=0; k<n; k++) values[k] = stack[d-n+k].v;
+        stack.resize(d-n);
+        return values;
+    }
+
+    RegArg pop_value(){ return pop_values(1)[0]; }
+
+    // emits `ins` into the register of the next stack slot and pushes its result
+    void push_result(RegInstr ins, bool may_run_code){
+        int p = stack.size();
+        ins.dst = reg(p);
+        int i = emit(ins, may_run_code);
+        push_value(reg(p));
+        last_def = i;
+    }
+
+    int add_operands(const std::vector<RegArg>& values, int from){
+        int offset = rc->operands.size();
+        for(int k=from; k<values.size(); k++) rc->operands.push_back(values[k]);
+        return offset;
+    }
+
+    void store(RegArg target, RegArg value){
+        int def = last_def;
+        if(target.kind == RA_NAME) flush_if([](const RegArg& x){ return x.kind == RA_NAME; });
+        else flush_if([&](const RegArg& x){ return x == target; });
+        bool retarget = def >= 0 && def == (int)rc->code.size() - 1 && rc->code[def].dst == value;
+        for(const Entry& e : stack) if(e.v == value || e.idx == value) retarget = false;
+        if(retarget) rc->code[def].dst = target;
+        else move(target, value);
+        last_def = -1;
+    }
+
+    // ref components in registers of the stack may be overwritten before the ref is used
+    RegArg pin(RegArg x, int p, bool is_obj){
+        if(x.kind != RA_REG || x.index >= EXTRA_BASE) return x;
+        if(is_obj && x.index == p) return x;
+        RegArg r = fresh();
+        move(r, x);
+        return r;
+    }
+
+    void jump(RegInstr ins, int target){
+        materialize();
+        record(target, stack);
+        ins.target = target;
+        emit(ins, ins.op != ROP_JUMP);
+    }
+
+    void translate_op(const Bytecode& byte){
+        switch(byte.op){
+            case OP_NO_OP: break;
+            case OP_LOAD_CONST: push_value({RA_CONST, byte.arg}); break;
+            case OP_LOAD_NONE: push_value({RA_LITERAL, 0}); break;
+            case OP_LOAD_TRUE: push_value({RA_LITERAL, 1}); break;
+            case OP_LOAD_FALSE: push_value({RA_LITERAL, 2}); break;
+            case OP_LOAD_ELLIPSIS: push_value({RA_LITERAL, 3}); break;
+            case OP_LOAD_NAME: push_value({RA_NAME, byte.arg}); break;
+            case OP_LOAD_TYPED_LOCAL: push_value({RA_TYPED, byte.arg}); break;
+            case OP_LOAD_NAME_REF: case OP_LOAD_TYPED_LOCAL_REF: {
+                Entry e;
+                bool typed = byte.op == OP_LOAD_TYPED_LOCAL_REF;
+                e.kind = typed ? Entry::TYPED_REF : Entry::NAME_REF;
+                e.v = e.target = {typed ? RA_TYPED : RA_NAME, byte.arg};
+                push(e);
+            } break;
+            case OP_STORE_NAME_REF: store({RA_NAME, byte.arg}, pop_value()); break;
+            case OP_STORE_TYPED_LOCAL: store({RA_TYPED, byte.arg}, pop_value()); break;
+            case OP_STORE_REF: {
+                if(stack.size() < 2) throw Unsupported();
+                RegArg value = value_at(stack.size()-1);
+                Entry r = stack[stack.size()-2];
+                stack.resize(stack.size()-2);
+                RegInstr ins{ROP_SETITEM};
+                switch(r.kind){
+                    case Entry::NAME_REF: case Entry::TYPED_REF: store(r.target, value); break;
+                    case Entry::INDEX_REF:
+                        ins.a = r.v; ins.b = r.idx; ins.c = value;
+                        emit(ins, true); break;
+                    case Entry::ATTR_REF:
+                        ins.op = ROP_SETATTR; ins.a = r.v; ins.b = value; ins.arg = r.name;
+                        emit(ins, true); break;
+                    default: throw Unsupported();
+                }
+            } break;
+            case OP_BUILD_ATTR_REF: {
+                RegArg obj = pop_value();
+                Entry e;
+                e.kind = Entry::ATTR_REF;
+                e.v = pin(obj, stack.size(), true);
+                e.name = byte.arg;
+                push(e);
+            } break;
+            case OP_BUILD_INDEX_REF: {
+                std::vector<RegArg> v = pop_values(2);
+                Entry e;
+                e.kind = Entry::INDEX_REF;
+                e.v = pin(v[0], stack.size(), true);
+                e.idx = pin(v[1], stack.size(), false);
+                push(e);
+            } break;
+            case OP_BINARY_OP: case OP_BINARY_OP_INT: case OP_BINARY_OP_FLOAT: case OP_BITWISE_OP:
+            case OP_COMPARE_OP: case OP_COMPARE_OP_NUM: case OP_IS_OP: case OP_CONTAINS_OP: {
+                static const std::map<Opcode, RegOpcode> ops = {
+                    {OP_BINARY_OP, ROP_BINARY}, {OP_BINARY_OP_INT, ROP_BINARY_INT}, {OP_BINARY_OP_FLOAT, ROP_BINARY_FLOAT},
+                    {OP_BITWISE_OP, ROP_BITWISE}, {OP_COMPARE_OP, ROP_COMPARE}, {OP_COMPARE_OP_NUM, ROP_COMPARE_NUM},
+                    {OP_IS_OP, ROP_IS}, {OP_CONTAINS_OP, ROP_CONTAINS}
+                };
+                std::vector<RegArg> v = pop_values(2);
+                RegInstr ins{ops.at((Opcode)byte.op)};
+                ins.a = v[0]; ins.b = v[1]; ins.arg = byte.arg;
+                // a typed operand may be boxed, so only IS never runs code
+                push_result(ins, byte.op != OP_IS_OP);
+            } break;
+            case OP_UNARY_NEGATIVE: case OP_UNARY_NOT: {
+                RegInstr ins{byte.op == OP_UNARY_NOT ? ROP_NOT : ROP_NEGATIVE};
+                ins.a = pop_value();
+                push_result(ins, true);
+            } break;
+            case OP_POP_JUMP_IF_FALSE: {
+                RegInstr ins{ROP_JUMP_IF_FALSE};
+                ins.a = pop_value();
+                jump(ins, byte.arg);
+            } break;
+            case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP: {
+                if(stack.empty()) throw Unsupported();
+                value_at(stack.size()-1);
+                RegInstr ins{byte.op == OP_JUMP_IF_FALSE_OR_POP ? ROP_JUMP_IF_FALSE : ROP_JUMP_IF_TRUE};
+                ins.a = reg(stack.size()-1);
+                jump(ins, byte.arg);
+                stack.pop_back();
+            } break;
+            case OP_JUMP_ABSOLUTE: jump(RegInstr{ROP_JUMP}, byte.arg); reachable = false; break;
+            case OP_LOOP_CONTINUE:
+                jump(RegInstr{ROP_JUMP}, co->co_blocks[byte.block].start);
+                reachable = false;
+                break;
+            case OP_LOOP_BREAK: {
+                const CodeBlock& block = co->co_blocks[byte.block];
+                if(block.type == FOR_LOOP){
+                    // the iterators are dead registers now, nothing to pop
+                    auto it = state_at.find(block.end);
+                    if(it == state_at.end()) throw Unsupported();
+                    materialize();
+                    if(stack.size() < it->second.size()) throw Unsupported();
+                    RegInstr ins{ROP_JUMP};
+                    ins.target = block.end;
+                    emit(ins, false);
+                }else{
+                    jump(RegInstr{ROP_JUMP}, block.end);
+                }
+                reachable = false;
+            } break;
+            case OP_GET_ITER: {
+                if(stack.size() < 2) throw Unsupported();
+                RegArg iterable = value_at(stack.size()-1);
+                Entry var = stack[stack.size()-2];
+                if(var.kind != Entry::NAME_REF && var.kind != Entry::TYPED_REF) throw Unsupported();
+                stack.resize(stack.size()-2);
+                iter_vars[stack.size()] = var.target;
+                RegInstr ins{ROP_GET_ITER};
+                ins.a = iterable;
+                push_result(ins, true);
+            } break;
+            case OP_FOR_ITER: {
+                int p = stack.size() - 1;
+                if(p < 0 || stack[p].v != reg(p) || !iter_vars.count(p)) throw Unsupported();
+                int end = co->co_blocks[byte.block].end;
+                record(end, std::vector<Entry>(stack.begin(), stack.end()-1));
+                RegInstr ins{ROP_FOR_ITER};
+                ins.a = reg(p); ins.dst = iter_vars[p]; ins.target = end;
+                emit(ins, true);
+            } break;
+            case OP_CALL: {
+                int argc = byte.arg & 0xFFFF;
+                int kwargc = (byte.arg >> 16) & 0xFFFF;
+                if(kwargc > 0) throw Unsupported();
+                std::vector<RegArg> v = pop_values(argc + 1);
+                RegInstr ins{ROP_CALL};
+                ins.a = v[0]; ins.arg = argc; ins.b.index = add_operands(v, 1);
+                push_result(ins, true);
+            } break;
+            case OP_RETURN_VALUE: {
+                RegInstr ins{ROP_RETURN};
+                ins.a = pop_value();
+                emit(ins, false);
+                reachable = false;
+            } break;
+            case OP_POP_TOP: {
+                if(stack.empty()) throw Unsupported();
+                const Entry& e = stack.back();
+                // the load still raises NameError
+                if(e.kind == Entry::VALUE && e.v.kind == RA_NAME) move(reg(stack.size()-1), e.v);
+                stack.pop_back();
+            } break;
+            case OP_DUP_TOP: {
+                if(stack.empty()) throw Unsupported();
+                Entry e = stack.back();
+                if(e.kind == Entry::INDEX_REF || e.kind == Entry::ATTR_REF){
+                    RegInstr ins{e.kind == Entry::INDEX_REF ? ROP_GETITEM : ROP_GETATTR};
+                    ins.a = e.v; ins.b = e.idx; ins.arg = e.name;
+                    push_result(ins, true);
+                }else{
+                    push_value(e.v);
+                }
+            } break;
+            case OP_BUILD_LIST: case OP_BUILD_SMART_TUPLE: {
+                if(byte.arg > stack.size()) throw Unsupported();
+                if(byte.op == OP_BUILD_SMART_TUPLE){
+                    // only refs build a TupleRef, which is an unpacking target
+                    bool all_refs = byte.arg > 0;
+                    for(int k=stack.size()-byte.arg; k<stack.size(); k++) all_refs &= stack[k].kind != Entry::VALUE;
+                    if(all_refs) throw Unsupported();
+                }
+                std::vector<RegArg> v = pop_values(byte.arg);
+                RegInstr ins{byte.op == OP_BUILD_LIST ? ROP_BUILD_LIST : ROP_BUILD_TUPLE};
+                ins.arg = byte.arg; ins.b.index = add_operands(v, 0);
+                push_result(ins, false);
+            } break;
+            case OP_BUILD_SLICE: {
+                std::vector<RegArg> v = pop_values(2);
+                RegInstr ins{ROP_BUILD_SLICE};
+                ins.a = v[0]; ins.b = v[1];
+                push_result(ins, false);
+            } break;
+            case OP_LIST_APPEND: {
+                if(stack.size() < 3 || stack[stack.size()-3].kind != Entry::VALUE) throw Unsupported();
+                RegInstr ins{ROP_LIST_APPEND};
+                ins.b = pop_value();
+                ins.a = stack[stack.size()-2].v;
+                emit(ins, false);
+            } break;
+            case OP_ASSERT: {
+                RegInstr ins{ROP_ASSERT};
+                ins.a = pop_value();
+                emit(ins, true);
+            } break;
+            case OP_RAISE_ERROR: {
+                std::vector<RegArg> v = pop_values(2);
+                RegInstr ins{ROP_RAISE};
+                ins.a = v[0]; ins.b = v[1];
+                emit(ins, true);
+            } break;
+            case OP_INLINE_CALL: {
+                const InlinedCall& ic = co->co_inlined[byte.arg];
+                if(ic.argc > stack.size()) throw Unsupported();
+                materialize();
+                int base = stack.size() - ic.argc;
+                std::vector<Entry> after(stack.begin(), stack.begin() + base);
+                after.push_back(Entry());
+                after.back().v = reg(base);
+                record(ic.end, after);
+                RegInstr ins{ROP_INLINE_CALL};
+                ins.dst = reg(base); ins.arg = byte.arg; ins.target = ic.end;
+                emit(ins, true);
+            } break;
+            case OP_INLINE_RETURN: {
+                if(stack.empty()) throw Unsupported();
+                value_at(stack.size()-1);
+                jump(RegInstr{ROP_JUMP}, byte.arg);
+                reachable = false;
+            } break;
+            case OP_HOIST_LEN: {
+                RegInstr ins{ROP_HOIST_LEN};
+                ins.arg = byte.arg;
+                emit(ins, true);
+            } break;
+            case OP_LOAD_HOISTED_LEN: {
+                RegInstr ins{ROP_LOAD_HOISTED_LEN};
+                ins.arg = byte.arg;
+                push_result(ins, true);
+            } break;
+            default: throw Unsupported();
+        }
+    }
+
+public:
+    RegTranslator(const CodeObject* co) : co(co) {}
+
+    // returns nullptr if `co` must stay on the stack tier
+    std::shared_ptr<RegCode> translate(){
+        if(co->src->mode != EXEC_MODE) return nullptr;
+        rc = std::make_shared<RegCode>();
+        const std::vector<Bytecode>& code = co->co_code;
+        std::set<int> leaders;
+        for(const Bytecode& byte : code){
+            switch(byte.op){
+                case OP_POP_JUMP_IF_FALSE: case OP_JUMP_IF_FALSE_OR_POP: case OP_JUMP_IF_TRUE_OR_POP:
+                case OP_JUMP_ABSOLUTE: case OP_INLINE_RETURN:
+                    leaders.insert(byte.arg); break;
+                case OP_FOR_ITER: case OP_LOOP_BREAK: leaders.insert(co->co_blocks[byte.block].end); break;
+                case OP_LOOP_CONTINUE: leaders.insert(co->co_blocks[byte.block].start); break;
+                case OP_INLINE_CALL: leaders.insert(co->co_inlined[byte.arg].end); break;
+            }
+        }
+        try{
+            // blocks are laid out in the order they are reached, so a fallthrough into a block
+            // which is already translated becomes a jump
+            record(0, {});
+            while(!work.empty()){
+                int i = work.back();
+                work.pop_back();
+                if(start_of.count(i)) continue;
+                stack = state_at[i];
+                reachable = true;
+                last_def = -1;
+                while(true){
+                    start_of[i] = rc->code.size();
+                    curr = std::min(i, (int)code.size() - 1);
+                    if(i == code.size()){
+                        if(!stack.empty()) throw Unsupported();
+                        RegInstr ins{ROP_RETURN};
+                        ins.a = {RA_LITERAL, 0};
+                        emit(ins, false);
+                        break;
+                    }
+                    translate_op(code[i++]);
+                    if(!reachable){
+                        // lay out the target of a jump right after it if it is new
+                        RegInstr& last = rc->code.back();
+                        if(last.op != ROP_JUMP || start_of.count(last.target)) break;
+                        i = last.target;
+                        rc->code.pop_back();
+                        stack = state_at[i];
+                        reachable = true;
+                        last_def = -1;
+                        continue;
+                    }
+                    if(!leaders.count(i) && i < code.size()) continue;
+                    last_def = -1;
+                    materialize();
+                    if(start_of.count(i)){
+                        if(state_at[i] != stack) throw Unsupported();
+                        RegInstr ins{ROP_JUMP};
+                        ins.target = i;
+                        emit(ins, false);
+                        break;
+                    }
+                    auto it = state_at.find(i);
+                    if(it != state_at.end() && it->second != stack) throw Unsupported();
+                    state_at[i] = stack;
+                }
+            }
+        }catch(Unsupported&){
+            return nullptr;
+        }
+
+        auto fix = [this](RegArg& x){
+            if(x.kind == RA_REG && x.index >= EXTRA_BASE) x.index = x.index - EXTRA_BASE + max_depth;
+        };
+        for(RegInstr& ins : rc->code){
+            fix(ins.dst); fix(ins.a); fix(ins.b); fix(ins.c);
+            if(ins.target >= 0) ins.target = start_of[ins.target];
+        }
+        for(RegArg& x : rc->operands) fix(x);
+        rc->nregs = max_depth + extra;
+        return rc;
+    }
+};
+
+void VM::__reg_translate(CodeObject* code){
+    code->co_reg = RegTranslator(code).translate();
+
+}
+
+PyVar VM::run_reg_frame(Frame* frame){
+    const RegCode& rc = *frame->code->co_reg;
+    std::vector<PyVar> regs(rc.nregs);
+
+    auto get = [&](const RegArg& x) -> PyVar {
+        switch(x.kind){
+            case RA_REG: return regs[x.index];
+            case RA_CONST: return frame->code->co_consts[x.index];
+            case RA_NAME: return NameRef(frame->code->co_names[x.index]).get(this, frame);
+            case RA_TYPED: return load_typed_local(frame, x.index);
+            case RA_LITERAL: {
+                const PyVar* literals[] = {&None, &True, &False, &Ellipsis};
+                return *literals[x.index];
+            }
+        }
+        UNREACHABLE();
+    };
+
+    auto set = [&](const RegArg& x, PyVar value){
+        switch(x.kind){
+            case RA_REG: regs[x.index] = std::move(value); break;
+            case RA_NAME: NameRef(frame->code->co_names[x.index]).set(this, frame, std::move(value)); break;
+            case RA_TYPED: store_typed_local(frame, x.index, std::move(value)); break;
+            default: UNREACHABLE();
+        }
+    };
+
+    auto operands = [&](int offset, int n){
+        pkpy::ArgList args(n);
+        for(int i=0; i<n; i++) args._index(i) = get(rc.operands[offset + i]);
+        return args;
+    };
+
+    int pc = 0;
+    while(true){
+        const RegInstr& ins = rc.code[pc++];
+        frame->set_ip(ins.src);
+#ifdef PKPY_COUNT_INSTRUCTIONS
+        _instructions++;
+#endif
+        test_stop_flag();
+
+        switch(ins.op){
+            case ROP_MOVE: set(ins.dst, get(ins.a)); break;
+            case ROP_BINARY:
+                set(ins.dst, call_slot((TypeSlot)(SLOT_ADD + ins.arg), pkpy::twoArgs(get(ins.a), get(ins.b))));
+                break;
+            case ROP_BINARY_INT: set(ins.dst, binary_op_int(ins.arg, get(ins.a), get(ins.b))); break;
+            case ROP_BINARY_FLOAT: set(ins.dst, binary_op_float(ins.arg, get(ins.a), get(ins.b))); break;
+            case ROP_BITWISE:
+                set(ins.dst, fast_call(BITWISE_SPECIAL_METHODS[ins.arg], pkpy::twoArgs(get(ins.a), get(ins.b))));
+                break;
+            case ROP_COMPARE: {
+                // for __ne__ we use the negation of __eq__
+                int op = ins.arg == 3 ? 2 : ins.arg;
+                PyVar res = call_slot((TypeSlot)(SLOT_LT + op), pkpy::twoArgs(get(ins.a), get(ins.b)));
+                if(op != ins.arg) res = PyBool(!PyBool_AS_C(res));
+                set(ins.dst, std::move(res));
+            } break;
+            case ROP_COMPARE_NUM: set(ins.dst, compare_op_num(ins.arg, get(ins.a), get(ins.b))); break;
+            case ROP_IS: set(ins.dst, PyBool((get(ins.a) == get(ins.b)) != (ins.arg == 1))); break;
+            case ROP_CONTAINS: {
+                bool ret_c = PyBool_AS_C(call_slot(SLOT_CONTAINS, pkpy::twoArgs(get(ins.b), get(ins.a))));
+                set(ins.dst, PyBool(ret_c != (ins.arg == 1)));
+            } break;
+            case ROP_NEGATIVE: set(ins.dst, num_negated(get(ins.a))); break;
+            case ROP_NOT: set(ins.dst, PyBool(!PyBool_AS_C(asBool(get(ins.a))))); break;
+            case ROP_GETATTR: {
+                AttrCache* c = frame->code->attr_cache(ins.arg);
+                set(ins.dst, getattr_cached(get(ins.a), frame->code->co_names[ins.arg].first, c));
+            } break;
+            case ROP_SETATTR: {
+                PyVar obj = get(ins.a);
+                AttrCache* c = frame->code->attr_cache(ins.arg);
+                setattr_cached(obj, frame->code->co_names[ins.arg].first, get(ins.b), c);
+            } break;
+            case ROP_GETITEM: set(ins.dst, call_slot(SLOT_GETITEM, pkpy::twoArgs(get(ins.a), get(ins.b)))); break;
+            case ROP_SETITEM: call_slot(SLOT_SETITEM, pkpy::threeArgs(get(ins.a), get(ins.b), get(ins.c))); break;
+            case ROP_CALL: {
+                PyVar callable = get(ins.a);
+                set(ins.dst, call(callable, operands(ins.b.index, ins.arg), pkpy::noArg(), false));
+            } break;
+            case ROP_RETURN: return get(ins.a);
+            case ROP_JUMP:
+                if(ins.target < pc) __gc_safepoint();     // a loop back-edge
+                pc = ins.target;
+                break;
+            case ROP_JUMP_IF_FALSE: if(!PyBool_AS_C(asBool(get(ins.a)))) pc = ins.target; break;
+            case ROP_JUMP_IF_TRUE: if(PyBool_AS_C(asBool(get(ins.a)))) pc = ins.target; break;
+            case ROP_GET_ITER: {
+                PyVar obj = get(ins.a);
+                if(slots_of(_tp(obj))[SLOT_ITER] == nullptr) typeError("'" + UNION_TP_NAME(obj) + "' object is not iterable");
+                set(ins.dst, call_slot(SLOT_ITER, pkpy::oneArg(obj)));
+            } break;
+            case ROP_FOR_ITER: {
+                auto& it = PyIter_AS_C(regs[ins.a.index]);
+                if(it->hasNext()) set(ins.dst, it->next());
+                else pc = ins.target;
+            } break;
+            case ROP_BUILD_LIST: set(ins.dst, PyList(operands(ins.b.index, ins.arg).toList())); break;
+            case ROP_BUILD_TUPLE: set(ins.dst, PyTuple(operands(ins.b.index, ins.arg))); break;
+            case ROP_BUILD_SLICE: {
+                PyVar start = get(ins.a);
+                PyVar stop = get(ins.b);
+                _Slice s;
+                if(start != None) {check_type(start, _tp_int); s.start = (int)PyInt_AS_C(start);}
+                if(stop != None) {check_type(stop, _tp_int); s.stop = (int)PyInt_AS_C(stop);}
+                set(ins.dst, PySlice(s));
+            } break;
+            case ROP_LIST_APPEND: fast_call(m_append, pkpy::twoArgs(get(ins.a), get(ins.b))); break;
+            case ROP_ASSERT: if(asBool(get(ins.a)) != True) _error("AssertionError", ""); break;
+            case ROP_RAISE: {
+                _Str msg = PyStr_AS_C(asRepr(get(ins.b)));
+                _Str type = PyStr_AS_C(get(ins.a));
+                _error(type, msg);
+            } break;
+            case ROP_INLINE_CALL: {
+                const InlinedCall& ic = frame->code->co_inlined[ins.arg];
+                PyVar callable = NameRef(frame->code->co_names[ic.name]).get(this, frame);
+                if(callable == ic.fn) break;    // run the spliced body
+                pkpy::ArgList args(ic.argc);
+                for(int i=0; i<ic.argc; i++) args._index(i) = regs[ins.dst.index + i];
+                regs[ins.dst.index] = call(callable, std::move(args), pkpy::noArg(), false);
+                pc = ins.target;
+            } break;
+            case ROP_HOIST_LEN: {
+                const HoistedLen& h = frame->code->co_hoisted[ins.arg];
+                PyVar fn = NameRef(frame->code->co_names[h.fn]).get(this, frame);
+                PyVar obj = NameRef(frame->code->co_names[h.obj]).get(this, frame);
+                i64 n = -1;
+                if(fn->is_type(_tp_native_function) && (obj->is_type(_tp_list) || obj->is_type(_tp_tuple) || obj->is_type(_tp_str))){
+                    n = PyInt_AS_C(call(fn, pkpy::oneArg(obj)));
+                }
+                frame->f_unboxed[h.slot].value._int = n;
+            } break;
+            case ROP_LOAD_HOISTED_LEN: {
+                const HoistedLen& h = frame->code->co_hoisted[ins.arg];
+                i64 n = frame->f_unboxed[h.slot].value._int;
+                if(n >= 0){
+                    set(ins.dst, PyInt(n));
+                }else{
+                    PyVar fn = NameRef(frame->code->co_names[h.fn]).get(this, frame);
+                    PyVar obj = NameRef(frame->code->co_names[h.obj]).get(this, frame);
+                    set(ins.dst, call(fn, pkpy::oneArg(obj)));
+                }
+            } break;
+            default: UNREACHABLE();
+        }
+    }
+}
+
+#endif
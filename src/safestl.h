@@ -9,7 +9,7 @@ typedef pkpy::shared_ptr<PyObject> PyVar;
 typedef PyVar PyVarOrNull;
 typedef PyVar PyVarRef;
 
-class PyVarList: public std::vector<PyVar> {
+class PyVarList: public std::vector<PyVar, pkpy::charged_allocator<PyVar>> {
     PyVar& at(size_t) = delete;
 
     inline void __checkIndex(size_t i) const {
@@ -23,16 +23,25 @@ class PyVarList: public std::vector<PyVar> {
 public:
     PyVar& operator[](size_t i) {
         __checkIndex(i);
-        return std::vector<PyVar>::operator[](i);
+        return vector::operator[](i);
     }
 
     const PyVar& operator[](size_t i) const {
         __checkIndex(i);
-        return std::vector<PyVar>::operator[](i);
+        return vector::operator[](i);
     }
 
     // define constructors the same as std::vector
-    using std::vector<PyVar>::vector;
+    using vector::vector;
+    PyVarList() = default;
+    PyVarList(const PyVarList&) = default;
+    PyVarList(PyVarList&&) noexcept = default;
+    PyVarList& operator=(const PyVarList&) = default;
+    PyVarList& operator=(PyVarList&&) noexcept = default;
+
+    ~PyVarList(){
+        if(size() > pkpy::FreeQueue::MIN_DEFERRED_ITEMS) pkpy::__defer_items(data(), size());
+    }
 };
 
 typedef emhash8::HashMap<_Str, PyVar> PyVarDict;
@@ -189,4 +198,12 @@ namespace pkpy {
         ret[1] = b;
         return ret;
     }
+
+    ArgList threeArgs(const PyVar& a, const PyVar& b, const PyVar& c) {
+        ArgList ret(3);
+        ret[0] = a;
+        ret[1] = b;
+        ret[2] = c;
+        return ret;
+    }
 }
\ No newline at end of file
@@ -4,64 +4,376 @@
 
 typedef std::stringstream _StrStream;
 
-class _Str : public std::string {
-    mutable std::vector<uint16_t>* _u8_index = nullptr;
+namespace pkpy {
+    // the bytes of a string, shared by its copies and by the views into it. They never
+    // change while more than one `_Str` refers to them
+    struct StrBuffer {
+        std::atomic<int> refcount;
+        bool interned;
+        size_t size;
+        size_t capacity;
+        std::atomic<std::vector<uint32_t>*> u8_index;       // of the whole buffer, see `STR_INDEX_STRIDE`
+        char chars[1];                                      // null-terminated
+
+        static StrBuffer* alloc(size_t capacity){
+            StrBuffer* b = (StrBuffer*)__charged_alloc(offsetof(StrBuffer, chars) + capacity + 1, true);
+            new (&b->refcount) std::atomic<int>(1);
+            b->interned = false;
+            b->size = 0;
+            b->capacity = capacity;
+            new (&b->u8_index) std::atomic<std::vector<uint32_t>*>(nullptr);
+            b->chars[0] = '\0';
+            return b;
+        }
+
+        // an interned buffer is never freed, its count is left alone
+        inline void inc_ref(){ if(!interned) refcount.fetch_add(1, std::memory_order_relaxed); }
+        inline void dec_ref(){
+            if(!interned && refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) __free(this);
+        }
+
+        static void __free(StrBuffer* b){
+            delete b->u8_index.load(std::memory_order_relaxed);
+            __charged_free(b);
+        }
+    };
+
+    // a substring at least this long is a view into its parent, unless it is smaller than
+    // 1/STR_VIEW_RATIO of the parent, which it would keep alive. Shorter ones are copied
+    const size_t STR_VIEW_MIN = 32;
+    const size_t STR_VIEW_RATIO = 1024;
+
+    // the index of a non-ASCII buffer keeps the byte offset of every STR_INDEX_STRIDE-th
+    // character, the characters in between are counted from there
+    const size_t STR_INDEX_STRIDE = 64;
+
+    inline bool __u8_start(char c){
+        // https://stackoverflow.com/questions/3911536/utf-8-unicode-whats-with-0xc0-and-0x80
+        return (c & 0xC0) != 0x80;
+    }
+
+    inline size_t __u8_count(const char* p, const char* end){
+        size_t n = 0;
+        for(; p < end; p++) n += __u8_start(*p);
+        return n;
+    }
+
+    // whether no byte has its high bit set, 16 bytes at a time where SSE2 is there
+    inline bool __is_ascii(const char* p, size_t n){
+        size_t i = 0;
+#ifdef PKPY_SSE2
+        for(; i + 16 <= n; i += 16){
+            if(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(p + i))) != 0) return false;
+        }
+#endif
+        for(; i + 8 <= n; i += 8){
+            uint64_t w;
+            memcpy(&w, p + i, 8);
+            if(w & 0x8080808080808080ULL) return false;
+        }
+        for(; i < n; i++){
+            if(p[i] & 0x80) return false;
+        }
+        return true;
+    }
+};
+
+class _Str {
+    static const size_t INLINE_MAX = 15;
+
+    mutable pkpy::StrBuffer* _buf = nullptr;        // nullptr when the bytes are inline
+    mutable const char* _data = _inline;
+    mutable size_t _hash = 0;
+    uint32_t _size = 0;
     mutable bool hash_initialized = false;
-    mutable size_t _hash;
+    mutable bool _ascii = true;                     // a view of a non-ASCII buffer is never taken as ASCII
+    mutable char _inline[INLINE_MAX + 1] = {};      // a short string is kept here, null-terminated
 
-    void utf8_lazy_init() const{
-        if(_u8_index != nullptr) return;
-        _u8_index = new std::vector<uint16_t>();
-        _u8_index->reserve(size());
-        if(size() > 65535) throw std::runtime_error("String has more than 65535 bytes.");
-        for(uint16_t i = 0; i < size(); i++){
-            // https://stackoverflow.com/questions/3911536/utf-8-unicode-whats-with-0xc0-and-0x80
-            if((at(i) & 0xC0) != 0x80)
-                _u8_index->push_back(i);
+    void __set(const char* s, size_t n) const {
+        _ascii = pkpy::__is_ascii(s, n);
+        if(n <= INLINE_MAX){
+            if(n > 0) memmove(_inline, s, n);       // `s` may be null when empty
+            _inline[n] = '\0';
+            _buf = nullptr;
+            _data = _inline;
+        }else{
+            _buf = pkpy::StrBuffer::alloc(n);
+            memcpy(_buf->chars, s, n);
+            _buf->chars[n] = '\0';
+            _buf->size = n;
+            _data = _buf->chars;
         }
     }
-public:
-    _Str() : std::string() {}
-    _Str(const char* s) : std::string(s) {}
-    _Str(const char* s, size_t n) : std::string(s, n) {}
-    _Str(const std::string& s) : std::string(s) {}
-    _Str(const _Str& s) : std::string(s) {
-        if(s._u8_index != nullptr){
-            _u8_index = new std::vector<uint16_t>(*s._u8_index);
+
+    void __copy(const _Str& s){
+        _size = s._size;
+        hash_initialized = s.hash_initialized;
+        _hash = s._hash;
+        _ascii = s._ascii;
+        _buf = s._buf;
+        if(_buf == nullptr){
+            memcpy(_inline, s._inline, sizeof(_inline));
+            _data = _inline;
+        }else{
+            _buf->inc_ref();
+            _data = s._data;
         }
-        if(s.hash_initialized){
-            _hash = s._hash;
-            hash_initialized = true;
+    }
+
+    void __steal(_Str& s){
+        if(s._buf == nullptr){ __copy(s); return; }
+        _size = s._size;
+        hash_initialized = s.hash_initialized;
+        _hash = s._hash;
+        _ascii = s._ascii;
+        _buf = s._buf;
+        _data = s._data;
+        s._buf = nullptr;
+        s._data = s._inline;
+        s._inline[0] = '\0';
+        s._size = 0;
+        s.hash_initialized = false;
+        s._ascii = true;
+    }
+
+    inline bool __whole() const { return _buf != nullptr && _data == _buf->chars && _size == _buf->size; }
+    inline bool __unique() const { return __whole() && !_buf->interned && _buf->refcount.load() == 1; }
+
+    // gives a view its own bytes
+    void __compact() const {
+        if(_buf == nullptr || __whole()) return;
+        pkpy::StrBuffer* parent = _buf;
+        __set(_data, _size);
+        parent->dec_ref();
+    }
+
+    // see `pkpy::STR_INDEX_STRIDE`, built once and shared by the copies and the views of the buffer
+    const std::vector<uint32_t>& __u8_index() const{
+        std::vector<uint32_t>* index = _buf->u8_index.load(std::memory_order_acquire);
+        if(index != nullptr) return *index;
+        index = new std::vector<uint32_t>();
+        index->reserve(_buf->size / pkpy::STR_INDEX_STRIDE + 1);
+        size_t n = 0;
+        for(size_t i = 0; i < _buf->size; i++){
+            if(pkpy::__u8_start(_buf->chars[i]) && n++ % pkpy::STR_INDEX_STRIDE == 0) index->push_back(i);
+        }
+        std::vector<uint32_t>* expected = nullptr;
+        if(!_buf->u8_index.compare_exchange_strong(expected, index)){
+            delete index;       // built by another thread holding a copy
+            return *expected;
         }
+        return *index;
+    }
+
+    // the number of characters of the buffer before the byte at `p`
+    size_t __u8_rank(const std::vector<uint32_t>& index, const char* p) const {
+        size_t block = std::upper_bound(index.begin(), index.end(), (size_t)(p - _buf->chars)) - index.begin();
+        if(block == 0) return pkpy::__u8_count(_buf->chars, p);
+        block--;
+        return block * pkpy::STR_INDEX_STRIDE + pkpy::__u8_count(_buf->chars + index[block], p);
+    }
+
+    // the byte offset of the `i`-th character, an inline string is scanned
+    size_t __u8_offset(int i) const {
+        if(_ascii) return std::min((size_t)i, (size_t)_size);
+        if(_buf != nullptr){
+            const std::vector<uint32_t>& index = __u8_index();
+            size_t k = __u8_rank(index, _data) + i;
+            size_t block = k / pkpy::STR_INDEX_STRIDE;
+            if(block >= index.size()) return _size;
+            const char* p = _buf->chars + index[block];
+            const char* end = _data + _size;
+            for(size_t r = k % pkpy::STR_INDEX_STRIDE; r > 0 && p < end; r--){
+                do p++; while(p < end && !pkpy::__u8_start(*p));
+            }
+            return std::min((size_t)(p - _data), (size_t)_size);
+        }
+        for(size_t p = 0; p < _size; p++){
+            if(pkpy::__u8_start(_data[p]) && i-- == 0) return p;
+        }
+        return _size;
+    }
+public:
+    static const size_t npos = std::string::npos;
+
+    _Str() {}
+    _Str(const char* s) { _size = strlen(s); __set(s, _size); }
+    _Str(const char* s, size_t n) { _size = n; __set(s, n); }
+    _Str(const std::string& s) { _size = s.size(); __set(s.data(), s.size()); }
+    _Str(std::string_view s) { _size = s.size(); __set(s.data(), s.size()); }
+    _Str(const _Str& s) { __copy(s); }
+    _Str(_Str&& s) { __steal(s); }
+
+    _Str& operator=(const _Str& s){
+        if(this == &s) return *this;
+        pkpy::StrBuffer* old = _buf;
+        __copy(s);
+        if(old != nullptr) old->dec_ref();
+        return *this;
+    }
+
+    _Str& operator=(_Str&& s){
+        if(this == &s) return *this;
+        pkpy::StrBuffer* old = _buf;
+        __steal(s);
+        if(old != nullptr) old->dec_ref();
+        return *this;
+    }
+
+    ~_Str(){
+        if(_buf != nullptr) _buf->dec_ref();
+    }
+
+    inline size_t size() const { return _size; }
+    inline size_t length() const { return _size; }
+    inline bool empty() const { return _size == 0; }
+    inline const char* data() const { return _data; }
+    inline const char* begin() const { return _data; }
+    inline const char* end() const { return _data + _size; }
+    inline char operator[](size_t i) const { return _data[i]; }
+    inline char front() const { return _data[0]; }
+    inline char back() const { return _data[_size - 1]; }
+    inline std::string_view view() const { return std::string_view(_data, _size); }
+    inline std::string str() const { return std::string(_data, _size); }
+    operator std::string() const { return str(); }
+
+    char at(size_t i) const {
+        if(i >= _size) throw std::out_of_range("_Str::at");
+        return _data[i];
+    }
+
+    const char* c_str() const {
+        if(_buf != nullptr && _data + _size != _buf->chars + _buf->size) __compact();
+        return _data;
     }
-    _Str(_Str&& s) : std::string(std::move(s)) {
-        if(_u8_index != nullptr) delete _u8_index;
-        _u8_index = s._u8_index;
-        s._u8_index = nullptr;
-        if(s.hash_initialized){
-            _hash = s._hash;
-            hash_initialized = true;
+
+    // a view into the same buffer if it is long enough, see `pkpy::STR_VIEW_MIN`
+    _Str substr(size_t pos, size_t n = npos) const {
+        if(pos > _size) throw std::out_of_range("_Str::substr");
+        n = std::min(n, _size - pos);
+        if(_buf == nullptr || n < pkpy::STR_VIEW_MIN || n < _buf->size / pkpy::STR_VIEW_RATIO){
+            return _Str(_data + pos, n);
         }
+        _Str ret;
+        _buf->inc_ref();
+        ret._buf = _buf;
+        ret._data = _data + pos;
+        ret._size = n;
+        ret._ascii = _ascii;
+        return ret;
     }
 
-    size_t hash() const{
-        if(!hash_initialized){
-            _hash = std::hash<std::string>()(*this);
-            hash_initialized = true;
+    size_t find(const _Str& s, size_t pos = 0) const { return view().find(s.view(), pos); }
+    size_t find(const char* s, size_t pos = 0) const { return view().find(s, pos); }
+    size_t find(char c, size_t pos = 0) const { return view().find(c, pos); }
+    size_t rfind(const _Str& s, size_t pos = npos) const { return view().rfind(s.view(), pos); }
+    size_t rfind(const char* s, size_t pos = npos) const { return view().rfind(s, pos); }
+    size_t rfind(char c, size_t pos = npos) const { return view().rfind(c, pos); }
+    int compare(const _Str& other) const { return view().compare(other.view()); }
+
+    // room for `n` bytes in a buffer of this string's own, appending up to there copies nothing
+    void reserve(size_t n){
+        if(n <= INLINE_MAX || (__unique() && n <= _buf->capacity)) return;
+        pkpy::StrBuffer* b = pkpy::StrBuffer::alloc(n);
+        memcpy(b->chars, _data, _size);
+        b->chars[_size] = '\0';
+        b->size = _size;
+        if(_buf != nullptr) _buf->dec_ref();
+        _buf = b;
+        _data = b->chars;
+    }
+
+    // appends in place when the bytes are this string's alone, a shared buffer is copied first
+    _Str& operator+=(std::string_view s){
+        if(s.empty()) return *this;
+        size_t n = _size + s.size();
+        hash_initialized = false;
+        _ascii = _ascii && pkpy::__is_ascii(s.data(), s.size());
+        if(_buf == nullptr && n <= INLINE_MAX){
+            memmove(_inline + _size, s.data(), s.size());
+            _inline[n] = '\0';
+        }else if(__unique() && n <= _buf->capacity){
+            delete _buf->u8_index.exchange(nullptr);
+            memmove(_buf->chars + _size, s.data(), s.size());
+            _buf->chars[n] = '\0';
+            _buf->size = n;
+        }else{
+            pkpy::StrBuffer* b = pkpy::StrBuffer::alloc(std::max(n, (size_t)_size * 2));
+            memcpy(b->chars, _data, _size);
+            memcpy(b->chars + _size, s.data(), s.size());
+            b->chars[n] = '\0';
+            b->size = n;
+            if(_buf != nullptr) _buf->dec_ref();
+            _buf = b;
+            _data = b->chars;
         }
+        _size = n;
+        return *this;
+    }
+    _Str& operator+=(const _Str& s){ return *this += s.view(); }
+    _Str& operator+=(const std::string& s){ return *this += std::string_view(s); }
+    _Str& operator+=(const char* s){ return *this += std::string_view(s); }
+    _Str& operator+=(char c){ return *this += std::string_view(&c, 1); }
+    void push_back(char c){ *this += c; }
+
+    size_t __compute_hash() const {
+        _hash = std::hash<std::string_view>()(view());
+        hash_initialized = true;
         return _hash;
     }
 
+    inline size_t hash() const{
+        return hash_initialized ? _hash : __compute_hash();
+    }
+
+    // the canonical copy of an identifier, kept for the life of the process. Copies of it
+    // share its buffer and its hash, so they compare equal to each other by a pointer
+    static const _Str& intern(const _Str& s);
+
+    inline bool is_ascii() const { return _ascii; }
+    inline bool is_interned() const { return _buf != nullptr && _buf->interned && __whole(); }
+
+    bool __equals(const _Str& other) const {
+        if(is_interned() && other.is_interned()) return false;
+        if(hash_initialized && other.hash_initialized && _hash != other._hash) return false;
+        return memcmp(_data, other._data, _size) == 0;
+    }
+
+    inline bool operator==(const _Str& other) const {
+        if(_size != other._size) return false;
+        return _data == other._data || __equals(other);
+    }
+    bool operator!=(const _Str& other) const { return !(*this == other); }
+    bool operator==(std::string_view other) const { return view() == other; }
+    bool operator!=(std::string_view other) const { return view() != other; }
+    bool operator==(const std::string& other) const { return view() == other; }
+    bool operator!=(const std::string& other) const { return view() != other; }
+    bool operator==(const char* other) const { return view() == other; }
+    bool operator!=(const char* other) const { return view() != other; }
+    bool operator<(const _Str& other) const { return view() < other.view(); }
+    bool operator>(const _Str& other) const { return view() > other.view(); }
+    bool operator<=(const _Str& other) const { return view() <= other.view(); }
+    bool operator>=(const _Str& other) const { return view() >= other.view(); }
+
+    // the number of characters before the byte at `index`
     int __to_u8_index(int64_t index) const{
-        utf8_lazy_init();
-        auto p = std::lower_bound(_u8_index->begin(), _u8_index->end(), index);
-        if(*p != index) UNREACHABLE();
-        return (int)(p - _u8_index->begin());
+        if(_ascii) return index;
+        if(_buf != nullptr){
+            const std::vector<uint32_t>& u8_index = __u8_index();
+            return __u8_rank(u8_index, _data + index) - __u8_rank(u8_index, _data);
+        }
+        return pkpy::__u8_count(_data, _data + index);
     }
 
     int u8_length() const {
-        utf8_lazy_init();
-        return _u8_index->size();
+        return __to_u8_index(_size);
+    }
+
+    // the byte offset of the character after the one at byte `pos`
+    size_t u8_next(size_t pos) const {
+        if(_ascii) return pos + 1;
+        do pos++; while(pos < _size && !pkpy::__u8_start(_data[pos]));
+        return pos;
     }
 
     _Str u8_getitem(int i) const{
@@ -69,19 +381,16 @@ public:
     }
 
     _Str u8_substr(int start, int end) const{
-        utf8_lazy_init();
         if(start >= end) return _Str();
-        int c_end = end >= _u8_index->size() ? size() : _u8_index->at(end);
-        return substr(_u8_index->at(start), c_end - _u8_index->at(start));
+        size_t begin = __u8_offset(start);
+        return substr(begin, __u8_offset(end) - begin);
     }
 
     _Str __lstrip() const {
-        _Str copy(*this);
-        copy.erase(copy.begin(), std::find_if(copy.begin(), copy.end(), [](char c) {
-            // std::isspace(c) does not working on windows (Debug)
-            return c != ' ' && c != '\t' && c != '\r' && c != '\n';
-        }));
-        return _Str(copy);
+        size_t i = 0;
+        // std::isspace(c) does not working on windows (Debug)
+        while(i < _size && (_data[i] == ' ' || _data[i] == '\t' || _data[i] == '\r' || _data[i] == '\n')) i++;
+        return substr(i);
     }
 
     _Str __escape(bool single_quote) const {
@@ -115,28 +424,30 @@ public:
         return ss.str();
     }
 
-    _Str& operator=(const _Str& s){
-        this->std::string::operator=(s);
-        if(_u8_index != nullptr) delete _u8_index;
-        this->_u8_index = s._u8_index;
-        this->hash_initialized = s.hash_initialized;
-        this->_hash = s._hash;
-        return *this;
-    }
+    friend const _Str& __intern_str(const _Str& s);
+};
 
-    _Str& operator=(_Str&& s){
-        this->std::string::operator=(std::move(s));
-        if(_u8_index != nullptr) delete _u8_index;
-        this->_u8_index = s._u8_index;
-        this->hash_initialized = s.hash_initialized;
-        this->_hash = s._hash;
-        return *this;
-    }
+inline _Str operator+(const _Str& a, std::string_view b){
+    _Str ret; ret.reserve(a.size() + b.size()); ret += a; ret += b; return ret;
+}
+inline _Str operator+(const _Str& a, const _Str& b){ return a + b.view(); }
+inline _Str operator+(const _Str& a, const std::string& b){ return a + std::string_view(b); }
+inline _Str operator+(const _Str& a, const char* b){ return a + std::string_view(b); }
+inline _Str operator+(const _Str& a, char b){ return a + std::string_view(&b, 1); }
+inline _Str operator+(std::string_view a, const _Str& b){
+    _Str ret; ret.reserve(a.size() + b.size()); ret += a; ret += b; return ret;
+}
+inline _Str operator+(const std::string& a, const _Str& b){ return std::string_view(a) + b; }
+inline _Str operator+(const char* a, const _Str& b){ return std::string_view(a) + b; }
+inline _Str operator+(char a, const _Str& b){ return std::string_view(&a, 1) + b; }
+inline bool operator==(const char* a, const _Str& b){ return b == a; }
+inline bool operator!=(const char* a, const _Str& b){ return b != a; }
+inline bool operator==(const std::string& a, const _Str& b){ return b == a; }
+inline bool operator!=(const std::string& a, const _Str& b){ return b != a; }
 
-    ~_Str(){
-        if(_u8_index != nullptr) delete _u8_index;
-    }
-};
+inline std::ostream& operator<<(std::ostream& os, const _Str& s){
+    return os.write(s.data(), s.size());
+}
 
 namespace std {
     template<>
@@ -147,38 +458,68 @@ namespace std {
     };
 }
 
-const _Str& __class__ = _Str("__class__");
-const _Str& __base__ = _Str("__base__");
-const _Str& __new__ = _Str("__new__");
-const _Str& __iter__ = _Str("__iter__");
-const _Str& __str__ = _Str("__str__");
-const _Str& __repr__ = _Str("__repr__");
-const _Str& __module__ = _Str("__module__");
-const _Str& __getitem__ = _Str("__getitem__");
-const _Str& __setitem__ = _Str("__setitem__");
-const _Str& __delitem__ = _Str("__delitem__");
-const _Str& __contains__ = _Str("__contains__");
-const _Str& __init__ = _Str("__init__");
-const _Str& __json__ = _Str("__json__");
-const _Str& __name__ = _Str("__name__");
-const _Str& __len__ = _Str("__len__");
-
-const _Str& m_append = _Str("append");
-const _Str& m_eval = _Str("eval");
-const _Str& m_self = _Str("self");
-const _Str& __enter__ = _Str("__enter__");
-const _Str& __exit__ = _Str("__exit__");
+// one table for the process, so the constants below and the names of every VM are the same symbols
+inline const _Str& __intern_str(const _Str& s){
+    static std::mutex lock;
+    static auto* table = new std::unordered_set<_Str>();     // never freed, constants point into it
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = table->find(s);
+    if(it == table->end()){
+        // always in a buffer, so that every copy points to the same bytes
+        _Str key;
+        key._size = s.size();
+        key._buf = pkpy::StrBuffer::alloc(s.size());
+        memcpy(key._buf->chars, s.data(), s.size());
+        key._buf->chars[s.size()] = '\0';
+        key._buf->size = s.size();
+        key._data = key._buf->chars;
+        key._ascii = pkpy::__is_ascii(s.data(), s.size());
+        if(!key._ascii) key.__u8_index();       // shared by threads from now on, nothing is built lazily
+        key._buf->interned = true;
+        key.hash();
+        it = table->insert(std::move(key)).first;
+    }
+    return *it;
+}
+
+inline const _Str& _Str::intern(const _Str& s){ return __intern_str(s); }
+
+const _Str& __class__ = _Str::intern("__class__");
+const _Str& __base__ = _Str::intern("__base__");
+const _Str& __new__ = _Str::intern("__new__");
+const _Str& __iter__ = _Str::intern("__iter__");
+const _Str& __str__ = _Str::intern("__str__");
+const _Str& __repr__ = _Str::intern("__repr__");
+const _Str& __module__ = _Str::intern("__module__");
+const _Str& __getitem__ = _Str::intern("__getitem__");
+const _Str& __setitem__ = _Str::intern("__setitem__");
+const _Str& __delitem__ = _Str::intern("__delitem__");
+const _Str& __contains__ = _Str::intern("__contains__");
+const _Str& __init__ = _Str::intern("__init__");
+const _Str& __json__ = _Str::intern("__json__");
+const _Str& __name__ = _Str::intern("__name__");
+const _Str& __len__ = _Str::intern("__len__");
+const _Str& __call__ = _Str::intern("__call__");
+
+const _Str& m_append = _Str::intern("append");
+const _Str& m_eval = _Str::intern("eval");
+const _Str& m_self = _Str::intern("self");
+const _Str& __enter__ = _Str::intern("__enter__");
+const _Str& __exit__ = _Str::intern("__exit__");
 
 const _Str CMP_SPECIAL_METHODS[] = {
-    "__lt__", "__le__", "__eq__", "__ne__", "__gt__", "__ge__"
+    _Str::intern("__lt__"), _Str::intern("__le__"), _Str::intern("__eq__"),
+    _Str::intern("__ne__"), _Str::intern("__gt__"), _Str::intern("__ge__")
 };  // __ne__ should not be used
 
 const _Str BINARY_SPECIAL_METHODS[] = {
-    "__add__", "__sub__", "__mul__", "__truediv__", "__floordiv__", "__mod__", "__pow__"
+    _Str::intern("__add__"), _Str::intern("__sub__"), _Str::intern("__mul__"), _Str::intern("__truediv__"),
+    _Str::intern("__floordiv__"), _Str::intern("__mod__"), _Str::intern("__pow__")
 };
 
 const _Str BITWISE_SPECIAL_METHODS[] = {
-    "__lshift__", "__rshift__", "__and__", "__or__", "__xor__"
+    _Str::intern("__lshift__"), _Str::intern("__rshift__"),
+    _Str::intern("__and__"), _Str::intern("__or__"), _Str::intern("__xor__")
 };
 
 const uint32_t __LoRangeA[] = {170,186,443,448,660,1488,1519,1568,1601,1646,1649,1749,1774,1786,1791,1808,1810,1869,1969,1994,2048,2112,2144,2208,2230,2308,2365,2384,2392,2418,2437,2447,2451,2474,2482,2486,2493,2510,2524,2527,2544,2556,2565,2575,2579,2602,2610,2613,2616,2649,2654,2674,2693,2703,2707,2730,2738,2741,2749,2768,2784,2809,2821,2831,2835,2858,2866,2869,2877,2908,2911,2929,2947,2949,2958,2962,2969,2972,2974,2979,2984,2990,3024,3077,3086,3090,3114,3133,3160,3168,3200,3205,3214,3218,3242,3253,3261,3294,3296,3313,3333,3342,3346,3389,3406,3412,3423,3450,3461,3482,3507,3517,3520,3585,3634,3648,3713,3716,3718,3724,3749,3751,3762,3773,3776,3804,3840,3904,3913,3976,4096,4159,4176,4186,4193,4197,4206,4213,4238,4352,4682,4688,4696,4698,4704,4746,4752,4786,4792,4800,4802,4808,4824,4882,4888,4992,5121,5743,5761,5792,5873,5888,5902,5920,5952,5984,5998,6016,6108,6176,6212,6272,6279,6314,6320,6400,6480,6512,6528,6576,6656,6688,6917,6981,7043,7086,7098,7168,7245,7258,7401,7406,7413,7418,8501,11568,11648,11680,11688,11696,11704,11712,11720,11728,11736,12294,12348,12353,12447,12449,12543,12549,12593,12704,12784,13312,19968,40960,40982,42192,42240,42512,42538,42606,42656,42895,42999,43003,43011,43015,43020,43072,43138,43250,43259,43261,43274,43312,43360,43396,43488,43495,43514,43520,43584,43588,43616,43633,43642,43646,43697,43701,43705,43712,43714,43739,43744,43762,43777,43785,43793,43808,43816,43968,44032,55216,55243,63744,64112,64285,64287,64298,64312,64318,64320,64323,64326,64467,64848,64914,65008,65136,65142,65382,65393,65440,65474,65482,65490,65498,65536,65549,65576,65596,65599,65616,65664,66176,66208,66304,66349,66370,66384,66432,66464,66504,66640,66816,66864,67072,67392,67424,67584,67592,67594,67639,67644,67647,67680,67712,67808,67828,67840,67872,67968,68030,68096,68112,68117,68121,68192,68224,68288,68297,68352,68416,68448,68480,68608,68864,69376,69415,69424,69600,69635,69763,69840,69891,69956,69968,70006,70019,70081,70106,70108,70144,70163,70272,70280,70282,70287,70303,70320,70405,70415,70419,70442,70450,70453,70461,70480,70493,70656,70727,70751,70784,70852,70855,71040,71128,71168,71236,71296,71352,71424,71680,71935,72096,72106,72161,72163,72192,72203,72250,72272,72284,72349,72384,72704,72714,72768,72818,72960,72968,72971,73030,73056,73063,73066,73112,73440,73728,74880,77824,82944,92160,92736,92880,92928,93027,93053,93952,94032,94208,100352,110592,110928,110948,110960,113664,113776,113792,113808,123136,123214,123584,124928,126464,126469,126497,126500,126503,126505,126516,126521,126523,126530,126535,126537,126539,126541,126545,126548,126551,126553,126555,126557,126559,126561,126564,126567,126572,126580,126585,126590,126592,126603,126625,126629,126635,131072,173824,177984,178208,183984,194560};
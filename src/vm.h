@@ -1,6 +1,7 @@
 #pragma once
 
 #include "codeobject.h"
+#include "optimizer.h"
 #include "iter.h"
 #include "error.h"
 
@@ -20,14 +21,23 @@
     __DEF_PY_AS_C(type, ctype, ptype)
 
 
+#ifdef PKPY_ENABLE_JIT
+struct JitContext;
+#endif
+
 class VM {
+    pkpy::Heap _heap;                               // first, so it is released after everything else
+    pkpy::ImmortalSet _immortals;                   // destroyed after everything but the heap
     std::atomic<bool> _stop_flag = false;
-    std::vector<PyVar> _small_integers;             // [-5, 256]
     PyVarDict _modules;                             // loaded modules
     emhash8::HashMap<_Str, _Str> _lazy_modules;     // lazy loaded modules
+    emhash8::HashMap<_Str, _AotLoader> _aot_modules;    // modules transpiled to C++, see aot.h
+    PyVarDict _aot_functions;                       // python functions behind native ones, see `__aot_call`
+    int _slots_epoch = 0;                           // bumped when a slot of any type is (re)bound, see `__affects_slots`
 protected:
     std::deque< std::unique_ptr<Frame> > callstack;
     PyVar __py2py_call_signal;
+    PyVar __yield_signal;
     
     inline void test_stop_flag(){
         if(_stop_flag){
@@ -36,15 +46,105 @@ protected:
         }
     }
 
+    // calls and loop back-edges are where cycles get collected and deferred releases
+    // catch up, nothing is half-built there
+    inline void __gc_safepoint(){
+        pkpy::FreeQueue& q = pkpy::__pool.frees;
+        if(!q.blocks.empty()) pkpy::__drain_frees(q.budget);
+        if(pkpy::__gc_state().should_collect()) pkpy::gc_collect_auto();
+    }
+
+    // `s = s + t` or `s += t`, where the next bytecode rebinds the name `s` and nothing else
+    // holds the str: `t` is appended in place, so building a str in a loop is linear
+    bool __str_append(Frame* frame, const PyVar& lhs, const PyVar& rhs){
+        if(lhs.use_count() != 2 || !lhs->is_type(_tp_str) || !rhs->is_type(_tp_str)) return false;
+        const PyVar& fn = slots_of(_tp_str)[SLOT_ADD];
+        if(fn == nullptr || !fn->is_type(_tp_native_function)) return false;
+        const std::vector<Bytecode>& code = frame->code->co_code;
+        int next = frame->next_index();
+        if(next >= code.size() || code[next].op != OP_STORE_NAME_REF) return false;
+        // the other reference must be the binding `NameRef::set` replaces
+        const auto& name = frame->code->co_names[code[next].arg];
+        PyVar* target = frame->f_locals.try_get(name.first);
+        if(target == nullptr && name.second == NAME_GLOBAL) target = frame->f_globals().try_get(name.first);
+        if(target == nullptr || target->get() != lhs.get()) return false;
+        UNION_GET(_Str, lhs) += PyStr_AS_C(rhs);
+        return true;
+    }
+
+    // calls back the weak references of the objects released so far, each with the reference
+    // itself. Only a call runs them, never a loop back-edge, which may not expect python code
+    void __weak_callbacks(){
+        std::vector<pkpy::shared_ptr<pkpy::WeakSlot>>& released = pkpy::__weak_table().released;
+        while(!released.empty()){
+            pkpy::shared_ptr<pkpy::WeakSlot> slot = std::move(released.back());
+            released.pop_back();
+            while(!slot->watchers.empty()){
+                PyObject* owner = (PyObject*)slot->watchers.back();
+                slot->watchers.pop_back();
+                PyVar ref = PyVar::share((int*)owner - 2);
+                _WeakRef& r = UNION_GET(_WeakRef, ref);
+                r.owner = nullptr;
+                PyVar callback = r.callback;
+                if(callback != nullptr) call(callback, pkpy::oneArg(ref));
+            }
+        }
+    }
+
     PyVar run_frame(Frame* frame){
-        while(frame->has_next_bytecode()){
+        __gc_safepoint();
+        if(!pkpy::__weak_table().released.empty()) __weak_callbacks();
+        if(frame->code->co_aot != nullptr && frame->next_index() == 0) return frame->code->co_aot(this, frame);
+#ifdef PKPY_REGISTER_TIER
+        if(frame->next_index() == 0 && __reg_ready(frame->code)) return run_reg_frame(frame);
+#endif
+#ifdef PKPY_ENABLE_JIT
+        if(__jit_tick(frame->code)) return __jit_run(frame);
+#endif
+        return __run_frame(frame);
+    }
+
+#ifdef PKPY_ENABLE_JIT
+    // counts calls and back-edges of `code` and compiles it once it is hot, see jit.h
+    inline bool __jit_tick(const _Code& code){
+        if(code->co_jit != nullptr) return true;
+        if(++code->co_hotness < PKPY_JIT_THRESHOLD) return false;
+        __jit_compile(code.get());
+        return code->co_jit != nullptr;
+    }
+    void __jit_compile(CodeObject* code);
+    PyVar __jit_run(Frame* frame);
+    template<int __op> static int __jit_step(VM* vm, Frame* frame, JitContext* ctx, int ip);
+#endif
+
+#ifdef PKPY_REGISTER_TIER
+    // translates `code` on its first run, see regvm.h
+    inline bool __reg_ready(const _Code& code){
+        if(!code->co_reg_tried){
+            code->co_reg_tried = true;
+            __reg_translate(code.get());
+        }
+        return code->co_reg != nullptr;
+    }
+    void __reg_translate(CodeObject* code);
+    PyVar run_reg_frame(Frame* frame);
+#endif
+
+    // with `__op` >= 0, runs only the bytecode at `next_ip`, which must exist and be `__op`,
+    // and returns nullptr if the frame should go on
+    template<int __op=-1>
+    PyVar __run_frame(Frame* frame){
+        while(__op >= 0 || frame->has_next_bytecode()){
             const Bytecode& byte = frame->next_bytecode();
+#ifdef PKPY_COUNT_INSTRUCTIONS
+            _instructions++;
+#endif
             //printf("[%d] %s (%d)\n", frame->stack_size(), OP_NAMES[byte.op], byte.arg);
             //printf("%s\n", frame->code->src->getLine(byte.line).c_str());
 
             test_stop_flag();
 
-            switch (byte.op)
+            switch (__op < 0 ? byte.op : __op)
             {
             case OP_NO_OP: break;       // do nothing
             case OP_LOAD_CONST: frame->push(frame->code->co_consts[byte.arg]); break;
@@ -63,10 +163,50 @@ protected:
                 const auto& p = frame->code->co_names[byte.arg];
                 NameRef(p).set(this, frame, frame->pop_value(this));
             } break;
+            case OP_LOAD_TYPED_LOCAL: frame->push(load_typed_local(frame, byte.arg)); break;
+            case OP_LOAD_TYPED_LOCAL_REF: frame->push(PyRef(TypedLocalRef(byte.arg))); break;
+            case OP_STORE_TYPED_LOCAL: store_typed_local(frame, byte.arg, frame->pop_value(this)); break;
+            case OP_INLINE_CALL: {
+                const InlinedCall& ic = frame->code->co_inlined[byte.arg];
+                PyVar callable = NameRef(frame->code->co_names[ic.name]).get(this, frame);
+                if(callable == ic.fn) break;    // run the spliced body
+                // the name was rebound, so call whatever it is now and skip the body
+                frame->jump_abs(ic.end);
+                pkpy::ArgList args = frame->pop_n_values_reversed(this, ic.argc);
+                PyVar ret = call(callable, std::move(args), pkpy::ArgList(0), true);
+                if(ret == __py2py_call_signal) return ret;
+                frame->push(std::move(ret));
+            } break;
+            case OP_INLINE_RETURN: {
+                frame->top() = frame->top_value(this);
+                frame->jump_abs(byte.arg);
+            } break;
+            case OP_HOIST_LEN: {
+                const HoistedLen& h = frame->code->co_hoisted[byte.arg];
+                PyVar fn = NameRef(frame->code->co_names[h.fn]).get(this, frame);
+                PyVar obj = NameRef(frame->code->co_names[h.obj]).get(this, frame);
+                i64 n = -1;
+                // the loop body is pure, so only builtin containers keep their length
+                if(fn->is_type(_tp_native_function) && (obj->is_type(_tp_list) || obj->is_type(_tp_tuple) || obj->is_type(_tp_str))){
+                    n = PyInt_AS_C(call(fn, pkpy::oneArg(obj)));
+                }
+                frame->f_unboxed[h.slot].value._int = n;
+            } break;
+            case OP_LOAD_HOISTED_LEN: {
+                const HoistedLen& h = frame->code->co_hoisted[byte.arg];
+                i64 n = frame->f_unboxed[h.slot].value._int;
+                if(n >= 0){
+                    frame->push(PyInt(n));
+                }else{
+                    PyVar fn = NameRef(frame->code->co_names[h.fn]).get(this, frame);
+                    PyVar obj = NameRef(frame->code->co_names[h.obj]).get(this, frame);
+                    frame->push(call(fn, pkpy::oneArg(obj)));
+                }
+            } break;
             case OP_BUILD_ATTR_REF: {
                 const auto& attr = frame->code->co_names[byte.arg];
                 PyVar obj = frame->pop_value(this);
-                frame->push(PyRef(AttrRef(obj, NameRef(attr))));
+                frame->push(PyRef(AttrRef(obj, NameRef(attr), byte.arg)));
             } break;
             case OP_BUILD_INDEX_REF: {
                 PyVar index = frame->pop_value(this);
@@ -89,9 +229,8 @@ protected:
                 for(int i=0; i<items.size(); i++){
                     if(!items[i]->is_type(_tp_ref)) {
                         done = true;
-                        PyVarList values = items.toList();
-                        for(int j=i; j<values.size(); j++) frame->try_deref(this, values[j]);
-                        frame->push(PyTuple(values));
+                        for(int j=0; j<items.size(); j++) frame->try_deref(this, items[j]);
+                        frame->push(PyTuple(std::move(items)));
                         break;
                     }
                 }
@@ -101,9 +240,9 @@ protected:
             case OP_BUILD_STRING:
             {
                 pkpy::ArgList items = frame->pop_n_values_reversed(this, byte.arg);
-                _StrStream ss;
-                for(int i=0; i<items.size(); i++) ss << PyStr_AS_C(asStr(items[i]));
-                frame->push(PyStr(ss.str()));
+                _Str s;
+                for(int i=0; i<items.size(); i++) s += PyStr_AS_C(asStr(items[i]));
+                frame->push(PyStr(std::move(s)));
             } break;
             case OP_LOAD_EVAL_FN: {
                 frame->push(builtins->attribs[m_eval]);
@@ -137,6 +276,7 @@ protected:
                     }
                 } break;
             case OP_RETURN_VALUE: return frame->pop_value(this);
+            case OP_YIELD_VALUE: return __yield_signal;     // the value stays on the stack, see `__resume`
             case OP_PRINT_EXPR:
                 {
                     const PyVar expr = frame->top_value(this);
@@ -148,8 +288,24 @@ protected:
                 {
                     pkpy::ArgList args(2);
                     args._index(1) = frame->pop_value(this);
-                    args._index(0) = frame->top_value(this);
-                    frame->top() = fast_call(BINARY_SPECIAL_METHODS[byte.arg], std::move(args));
+                    args._index(0) = frame->pop_value(this);
+                    if(byte.arg == 0 && __str_append(frame, args[0], args[1])){
+                        frame->push(std::move(args._index(0)));
+                        break;
+                    }
+                    frame->push(call_slot((TypeSlot)(SLOT_ADD + byte.arg), std::move(args)));
+                } break;
+            case OP_BINARY_OP_INT:
+                {
+                    PyVar rhs = frame->pop_value(this);
+                    PyVar lhs = frame->pop_value(this);
+                    frame->push(binary_op_int(byte.arg, lhs, rhs));
+                } break;
+            case OP_BINARY_OP_FLOAT:
+                {
+                    PyVar rhs = frame->pop_value(this);
+                    PyVar lhs = frame->pop_value(this);
+                    frame->push(binary_op_float(byte.arg, lhs, rhs));
                 } break;
             case OP_BITWISE_OP:
                 {
@@ -162,10 +318,16 @@ protected:
                 {
                     // for __ne__ we use the negation of __eq__
                     int op = byte.arg == 3 ? 2 : byte.arg;
-                    PyVar res = fast_call(CMP_SPECIAL_METHODS[op], frame->pop_n_values_reversed(this, 2));
+                    PyVar res = call_slot((TypeSlot)(SLOT_LT + op), frame->pop_n_values_reversed(this, 2));
                     if(op != byte.arg) res = PyBool(!PyBool_AS_C(res));
                     frame->push(std::move(res));
                 } break;
+            case OP_COMPARE_OP_NUM:
+                {
+                    PyVar rhs = frame->pop_value(this);
+                    PyVar lhs = frame->pop_value(this);
+                    frame->push(compare_op_num(byte.arg, lhs, rhs));
+                } break;
             case OP_IS_OP:
                 {
                     bool ret_c = frame->pop_value(this) == frame->pop_value(this);
@@ -175,7 +337,7 @@ protected:
             case OP_CONTAINS_OP:
                 {
                     PyVar rhs = frame->pop_value(this);
-                    bool ret_c = PyBool_AS_C(call(rhs, __contains__, pkpy::oneArg(frame->pop_value(this))));
+                    bool ret_c = PyBool_AS_C(call_slot(SLOT_CONTAINS, pkpy::twoArgs(rhs, frame->pop_value(this))));
                     if(byte.arg == 1) ret_c = !ret_c;
                     frame->push(PyBool(ret_c));
                 } break;
@@ -219,7 +381,7 @@ protected:
                     PyVarList items = frame->pop_n_values_reversed_unlimited(this, byte.arg*2);
                     PyVar obj = call(builtins->attribs["dict"]);
                     for(int i=0; i<items.size(); i+=2){
-                        call(obj, __setitem__, pkpy::twoArgs(items[i], items[i+1]));
+                        call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, items[i], items[i+1]));
                     }
                     frame->push(obj);
                 } break;
@@ -258,9 +420,8 @@ protected:
             case OP_GET_ITER:
                 {
                     PyVar obj = frame->pop_value(this);
-                    PyVarOrNull iter_fn = getattr(obj, __iter__, false);
-                    if(iter_fn != nullptr){
-                        PyVar tmp = call(iter_fn);
+                    if(slots_of(_tp(obj))[SLOT_ITER] != nullptr){
+                        PyVar tmp = call_slot(SLOT_ITER, pkpy::oneArg(obj));
                         PyVarRef var = frame->pop();
                         check_type(var, _tp_ref);
                         PyIter_AS_C(tmp)->var = var;
@@ -284,6 +445,11 @@ protected:
                 {
                     int blockStart = frame->code->co_blocks[byte.block].start;
                     frame->jump_abs(blockStart);
+                    __gc_safepoint();
+#ifdef PKPY_ENABLE_JIT
+                    // on-stack replacement into the hot loop
+                    if constexpr(__op < 0) if(__jit_tick(frame->code)) return __jit_run(frame);
+#endif
                 } break;
             case OP_LOOP_BREAK:
                 {
@@ -302,6 +468,11 @@ protected:
                     if(asBool(expr)==True) frame->jump_abs(byte.arg);
                     else frame->pop_value(this);
                 } break;
+            case OP_BUILD_GENERATOR: {
+                const _Func& fn = PyFunction_AS_C(frame->code->co_consts[byte.arg]);
+                auto gen = __newFrame(fn->code, frame->_module, frame->f_locals_copy(this));
+                frame->push(PyIter(pkpy::make_shared<BaseIterator, Generator>(this, std::move(gen))));
+            } break;
             case OP_BUILD_SLICE:
                 {
                     PyVar stop = frame->pop_value(this);
@@ -317,7 +488,12 @@ protected:
                     auto it = _modules.find(name);
                     if(it == _modules.end()){
                         auto it2 = _lazy_modules.find(name);
-                        if(it2 == _lazy_modules.end()){
+                        auto it3 = _aot_modules.find(name);
+                        if(it3 != _aot_modules.end()){
+                            PyVar _m = newModule(name);
+                            it3->second(this, _m);
+                            frame->push(_m);
+                        }else if(it2 == _lazy_modules.end()){
                             _error("ImportError", "module '" + name + "' not found");
                         }else{
                             const _Str& source = it2->second;
@@ -338,6 +514,7 @@ protected:
                 throw std::runtime_error(_Str("opcode ") + OP_NAMES[byte.op] + " is not implemented");
                 break;
             }
+            if constexpr(__op >= 0) return nullptr;
         }
 
         if(frame->code->src->mode == EVAL_MODE || frame->code->src->mode == JSON_MODE){
@@ -353,6 +530,7 @@ public:
     PyVarDict _types;
     PyVarDict _userTypes;
     PyVar None, True, False, Ellipsis;
+    PyVar _ascii_chars[128];        // the 1-char strs of the ASCII range, see `PyStrChar()`
 
     bool use_stdio;
     std::ostream* _stdout;
@@ -362,8 +540,16 @@ public:
     PyVar _main;            // __main__ module
 
     int maxRecursionDepth = 1000;
+    int optimizeLevel = 2;      // level 2 enables `IROptimizer` for EXEC_MODE code
+#ifdef PKPY_COUNT_INSTRUCTIONS
+    i64 _instructions = 0;      // bytecodes run by both tiers
+#endif
 
-    VM(bool use_stdio){
+    // with an `arena_capacity`, every object of the VM comes from an arena of that many bytes,
+    // whose quota is the whole arena until `set_memory_quota()`, see `pkpy::Arena`
+    VM(bool use_stdio, size_t arena_capacity=0){
+        if(arena_capacity > 0) _heap.arena = pkpy::__new_arena(arena_capacity);
+        pkpy::HeapScope scope(_heap);
         this->use_stdio = use_stdio;
         if(use_stdio){
             std::cout.setf(std::ios::unitbuf);
@@ -375,9 +561,6 @@ public:
             this->_stderr = new _StrStream();
         }
         initializeBuiltinClasses();
-
-        _small_integers.reserve(300);
-        for(i64 i=-5; i<=256; i++) _small_integers.push_back(new_object(_tp_int, i));
     }
 
     void keyboardInterrupt(){
@@ -407,9 +590,15 @@ public:
         return callstack.back().get();
     }
 
+    // the iterator of `obj`, see `PyIter_AS_C`
+    PyVar asIter(const PyVar& obj){
+        if(slots_of(_tp(obj))[SLOT_ITER] == nullptr) typeError("'" + UNION_TP_NAME(obj) + "' object is not iterable");
+        return call_slot(SLOT_ITER, pkpy::oneArg(obj));
+    }
+
     PyVar asRepr(const PyVar& obj){
         if(obj->is_type(_tp_type)) return PyStr("<class '" + UNION_GET(_Str, obj->attribs[__name__]) + "'>");
-        return call(obj, __repr__);
+        return call_slot(SLOT_REPR, pkpy::oneArg(obj));
     }
 
     PyVar asJson(const PyVar& obj){
@@ -421,16 +610,60 @@ public:
         if(obj->is_type(_tp_bool)) return obj;
         if(obj->is_type(_tp_int)) return PyBool(PyInt_AS_C(obj) != 0);
         if(obj->is_type(_tp_float)) return PyBool(PyFloat_AS_C(obj) != 0.0);
-        PyVarOrNull len_fn = getattr(obj, __len__, false);
-        if(len_fn != nullptr){
-            PyVar ret = call(len_fn);
+        const PyVar* slots = slots_of(_tp(obj));
+        if(slots[SLOT_BOOL] != nullptr){
+            PyVar ret = call_slot(SLOT_BOOL, pkpy::oneArg(obj));
+            return PyBool(PyBool_AS_C(ret));
+        }
+        if(slots[SLOT_LEN] != nullptr){
+            PyVar ret = call_slot(SLOT_LEN, pkpy::oneArg(obj));
             return PyBool(PyInt_AS_C(ret) > 0);
         }
         return True;
     }
 
+    // the slots of `type`, refilled if a dunder of some type was (re)bound since the last time
+    inline const PyVar* slots_of(const PyVar& type){
+        PyTypeObject* t = (PyTypeObject*)type.get();
+        if(t->slots_epoch != _slots_epoch) __fill_slots(t);
+        return t->slots;
+    }
+
+    void __fill_slots(PyTypeObject* t){
+        for(int i=0; i<__SLOT_COUNT; i++){
+            t->slots[i] = nullptr;
+            PyObject* cls = t;
+            while(cls != None.get()){
+                PyVar* val = cls->attribs.try_get(SLOT_NAMES[i]);
+                if(val != nullptr){ t->slots[i] = *val; break; }
+                cls = cls->attribs[__base__].get();
+            }
+        }
+        PyVar* new_fn = t->attribs.try_get(__new__);
+        t->ctor_new = new_fn != nullptr ? *new_fn : nullptr;
+        // the attributes `__init__` may set on `self`
+        t->ctor_attribs = 0;
+        const PyVar& init_fn = t->slots[SLOT_INIT];
+        if(init_fn != nullptr && init_fn->is_type(_tp_function)){
+            for(const auto& p : PyFunction_AS_C(init_fn)->code->co_names) t->ctor_attribs += p.second == NAME_ATTR;
+        }
+        t->slots_epoch = _slots_epoch;
+    }
+
+    // like `fast_call(SLOT_NAMES[slot], args)`, native methods are called directly
+    PyVar call_slot(TypeSlot slot, pkpy::ArgList&& args){
+        const PyVar& fn = slots_of(_tp(args[0]))[slot];
+        if(fn == nullptr) attributeError(args[0], SLOT_NAMES[slot]);
+        if(fn->is_type(_tp_native_function)){
+            _CppFunc f = UNION_GET(_CppFunc, fn);
+            return f(this, args);
+        }
+        PyVar callable = fn;    // the call may rebind the slot
+        return call(callable, std::move(args));
+    }
+
     PyVar fast_call(const _Str& name, pkpy::ArgList&& args){
-        PyObject* cls = args[0]->_type.get();
+        PyObject* cls = _tp(args[0]).get();
         while(cls != None.get()) {
             PyVar* val = cls->attribs.try_get(name);
             if(val != nullptr) return call(*val, std::move(args));
@@ -461,18 +694,7 @@ public:
     }
 
     PyVar call(const PyVar& _callable, pkpy::ArgList args, const pkpy::ArgList& kwargs, bool opCall){
-        if(_callable->is_type(_tp_type)){
-            auto it = _callable->attribs.find(__new__);
-            PyVar obj;
-            if(it != _callable->attribs.end()){
-                obj = call(it->second, args, kwargs, false);
-            }else{
-                obj = new_object(_callable, (i64)-1);
-                PyVarOrNull init_fn = getattr(obj, __init__, false);
-                if (init_fn != nullptr) call(init_fn, args, kwargs, false);
-            }
-            return obj;
-        }
+        if(_callable->is_type(_tp_type)) return __construct(_callable, args, kwargs, opCall);
 
         const PyVar* callable = &_callable;
         if((*callable)->is_type(_tp_bounded_method)){
@@ -491,66 +713,115 @@ public:
             return f(this, args);
         } else if((*callable)->is_type(_tp_function)){
             const _Func& fn = PyFunction_AS_C((*callable));
-            PyVarDict locals;
-            int i = 0;
-            for(const auto& name : fn->args){
-                if(i < args.size()){
-                    locals.emplace(name, args[i++]);
-                    continue;
-                }
-                typeError("missing positional argument '" + name + "'");
+            PyVarDict locals = __bind_args(fn, nullptr, args, kwargs);
+            if(fn->code->co_generator){
+                auto gen = __newFrame(fn->code, __module_of(*callable), std::move(locals));
+                return PyIter(pkpy::make_shared<BaseIterator, Generator>(this, std::move(gen)));
             }
+            Frame* frame = __pushNewFrame(fn->code, __module_of(*callable), std::move(locals));
+            if(opCall) return __py2py_call_signal;
+            return __exec_pushed(frame);
+        }
+        PyVarOrNull call_fn = getattr(*callable, __call__, false);
+        if(call_fn != nullptr) return call(call_fn, std::move(args), kwargs, opCall);
+        typeError("'" + UNION_TP_NAME(*callable) + "' object is not callable");
+        return None;
+    }
 
-            locals.insert(fn->kwArgs.begin(), fn->kwArgs.end());
+    // binds `self` (if not nullptr) followed by `args` and `kwargs` to the parameters of `fn`
+    PyVarDict __bind_args(const _Func& fn, const PyVar* self, const pkpy::ArgList& args, const pkpy::ArgList& kwargs){
+        const int argc = args.size() + (self != nullptr);
+        auto arg = [&](int i) -> const PyVar& {
+            if(self == nullptr) return args[i];
+            return i == 0 ? *self : args[i-1];
+        };
+
+        PyVarDict locals;
+        int i = 0;
+        for(const auto& name : fn->args){
+            if(i < argc){
+                locals.emplace(name, arg(i++));
+                continue;
+            }
+            typeError("missing positional argument '" + name + "'");
+        }
 
-            std::vector<_Str> positional_overrided_keys;
-            if(!fn->starredArg.empty()){
-                // handle *args
-                PyVarList vargs;
-                while(i < args.size()) vargs.push_back(args[i++]);
-                locals.emplace(fn->starredArg, PyTuple(std::move(vargs)));
-            }else{
-                for(const auto& key : fn->kwArgsOrder){
-                    if(i < args.size()){
-                        locals[key] = args[i++];
-                        positional_overrided_keys.push_back(key);
-                    }else{
-                        break;
-                    }
+        locals.insert(fn->kwArgs.begin(), fn->kwArgs.end());
+
+        std::vector<_Str> positional_overrided_keys;
+        if(!fn->starredArg.empty()){
+            // handle *args
+            PyVarList vargs;
+            while(i < argc) vargs.push_back(arg(i++));
+            locals.emplace(fn->starredArg, PyTuple(std::move(vargs)));
+        }else{
+            for(const auto& key : fn->kwArgsOrder){
+                if(i < argc){
+                    locals[key] = arg(i++);
+                    positional_overrided_keys.push_back(key);
+                }else{
+                    break;
                 }
-                if(i < args.size()) typeError("too many arguments");
             }
-            
-            for(int i=0; i<kwargs.size(); i+=2){
-                const _Str& key = PyStr_AS_C(kwargs[i]);
-                if(!fn->kwArgs.contains(key)){
-                    typeError(key.__escape(true) + " is an invalid keyword argument for " + fn->name + "()");
-                }
-                const PyVar& val = kwargs[i+1];
-                if(!positional_overrided_keys.empty()){
-                    auto it = std::find(positional_overrided_keys.begin(), positional_overrided_keys.end(), key);
-                    if(it != positional_overrided_keys.end()){
-                        typeError("multiple values for argument '" + key + "'");
-                    }
+            if(i < argc) typeError("too many arguments");
+        }
+
+        for(int i=0; i<kwargs.size(); i+=2){
+            const _Str& key = PyStr_AS_C(kwargs[i]);
+            if(!fn->kwArgs.contains(key)){
+                typeError(key.__escape(true) + " is an invalid keyword argument for " + fn->name + "()");
+            }
+            const PyVar& val = kwargs[i+1];
+            if(!positional_overrided_keys.empty()){
+                auto it = std::find(positional_overrided_keys.begin(), positional_overrided_keys.end(), key);
+                if(it != positional_overrided_keys.end()){
+                    typeError("multiple values for argument '" + key + "'");
                 }
-                locals[key] = val;
             }
+            locals[key] = val;
+        }
+        return locals;
+    }
 
-            PyVar* it_m = (*callable)->attribs.try_get(__module__);
-            PyVar _module = it_m != nullptr ? *it_m : top_frame()->_module;
-            if(opCall){
-                __pushNewFrame(fn->code, _module, std::move(locals));
-                return __py2py_call_signal;
-            }
-            return _exec(fn->code, _module, std::move(locals));
+    inline PyVar __module_of(const PyVar& fn){
+        PyVar* it_m = fn->attribs.try_get(__module__);
+        return it_m != nullptr ? *it_m : top_frame()->_module;
+    }
+
+    // calls a type with the constructor plan cached next to its slots
+    PyVar __construct(const PyVar& type, const pkpy::ArgList& args, const pkpy::ArgList& kwargs, bool opCall){
+        PyTypeObject* t = (PyTypeObject*)type.get();
+        const PyVar* slots = slots_of(type);
+        if(t->ctor_new != nullptr){
+            PyVar new_fn = t->ctor_new;
+            return call(new_fn, args, kwargs, false);
         }
-        typeError("'" + UNION_TP_NAME(*callable) + "' object is not callable");
-        return None;
+        PyVar obj = new_object(type, (i64)-1);
+        if(t->shape == nullptr) t->shape = std::make_unique<Shape>();
+        obj->attribs.init_shape(t->shape.get(), t->ctor_attribs);
+        const PyVar& init_fn = slots[SLOT_INIT];
+        if(init_fn == nullptr) return obj;
+        if(init_fn->is_type(_tp_function)){
+            // no bound method, and the caller's loop runs `__init__` like any other python call
+            const _Func& fn = PyFunction_AS_C(init_fn);
+            PyVarDict locals = __bind_args(fn, &obj, args, kwargs);
+            Frame* frame = __pushNewFrame(fn->code, __module_of(init_fn), std::move(locals));
+            frame->f_ctor_self = obj;
+            if(opCall) return __py2py_call_signal;
+            return __exec_pushed(frame);
+        }
+        pkpy::ArgList init_args(args.size() + 1);
+        init_args[0] = obj;
+        for(int i=0; i<args.size(); i++) init_args[i+1] = args[i];
+        PyVar callable = init_fn;
+        call(callable, std::move(init_args), kwargs, false);
+        return obj;
     }
 
 
     // repl mode is only for setting `frame->id` to 0
     virtual PyVarOrNull exec(_Str source, _Str filename, CompileMode mode, PyVar _module=nullptr){
+        pkpy::HeapScope scope(_heap);
         if(_module == nullptr) _module = _main;
         try {
             _Code code = compile(source, filename, mode);
@@ -559,6 +830,11 @@ public:
         }catch (const _Error& e){
             *_stderr << e.what() << '\n';
         }
+        catch (const pkpy::MemoryError& e) {
+            pkpy::ArenaScope outside(nullptr);      // the arena is still full, the report must not fail
+            auto re = RuntimeError("MemoryError", e.what(), _cleanErrorAndGetSnapshots());
+            *_stderr << re.what() << '\n';
+        }
         catch (const std::exception& e) {
             auto re = RuntimeError("UnexpectedError", e.what(), _cleanErrorAndGetSnapshots());
             *_stderr << re.what() << '\n';
@@ -571,29 +847,70 @@ public:
     }
 
     Frame* __pushNewFrame(const _Code& code, PyVar _module, PyVarDict&& locals){
-        if(code == nullptr) UNREACHABLE();
+        return __pushFrame(__newFrame(code, _module, std::move(locals)));
+    }
+
+    Frame* __pushFrame(std::unique_ptr<Frame>&& frame){
         if(callstack.size() > maxRecursionDepth){
             throw RuntimeError("RecursionError", "maximum recursion depth exceeded", _cleanErrorAndGetSnapshots());
         }
-        Frame* frame = new Frame(code, _module, std::move(locals));
-        callstack.emplace_back(frame);
+        callstack.push_back(std::move(frame));
+        return callstack.back().get();
+    }
+
+    std::unique_ptr<Frame> __newFrame(const _Code& code, PyVar _module, PyVarDict&& locals){
+        if(code == nullptr) UNREACHABLE();
+        auto frame = std::make_unique<Frame>(code, _module, std::move(locals));
+        // typed arguments are unboxed if they have the annotated type
+        for(int i=0; i<code->co_typed_names.size(); i++){
+            auto it = frame->f_locals.find(code->co_typed_names[i].first);
+            if(it == frame->f_locals.end()) continue;
+            store_typed_local(frame.get(), i, it->second);
+            frame->f_locals.erase(it);
+        }
         return frame;
     }
 
+    PyVar load_typed_local(Frame* frame, int index){
+        const TypedLocal& t = frame->f_unboxed[index];
+        if(!t.bound) nameError(frame->code->co_typed_names[index].first);
+        if(t.boxed != nullptr) return t.boxed;
+        if(frame->code->co_typed_names[index].second == HINT_INT) return PyInt(t.value._int);
+        return PyFloat(t.value._float);
+    }
+
+    void store_typed_local(Frame* frame, int index, const PyVar& obj){
+        TypedLocal& t = frame->f_unboxed[index];
+        t.bound = true;
+        if(frame->code->co_typed_names[index].second == HINT_INT){
+            if(obj->is_type(_tp_int)){ t.value._int = PyInt_AS_C(obj); t.boxed = nullptr; return; }
+        }else{
+            if(obj->is_type(_tp_float)){ t.value._float = PyFloat_AS_C(obj); t.boxed = nullptr; return; }
+        }
+        t.boxed = obj;
+    }
+
     PyVar _exec(_Code code, PyVar _module, PyVarDict&& locals){
-        Frame* frame = __pushNewFrame(code, _module, std::move(locals));
-        Frame* frameBase = frame;
+        return __exec_pushed(__pushNewFrame(code, _module, std::move(locals)));
+    }
+
+    // runs `frameBase`, the top of the callstack, until it returns
+    PyVar __exec_pushed(Frame* frameBase){
+        Frame* frame = frameBase;
         PyVar ret = nullptr;
 
         while(true){
             ret = run_frame(frame);
+            // a generator frame is suspended, its `Generator` takes it back
+            if(ret == __yield_signal && frame == frameBase) return ret;
             if(ret != __py2py_call_signal){
+                if(frame->f_ctor_self != nullptr) ret = frame->f_ctor_self;
                 if(frame == frameBase){         // [ frameBase<- ]
                     break;
                 }else{
                     callstack.pop_back();
                     frame = callstack.back().get();
-                    frame->push(ret);
+                    frame->push(std::move(ret));    // not kept alive until the next return
                 }
             }else{
                 frame = callstack.back().get();  // [ frameBase, newFrame<- ]
@@ -604,9 +921,20 @@ public:
         return ret;
     }
 
+    // runs a suspended generator frame until its next `yield`, false once it returns
+    // `frame` is null while it runs, so a generator never resumes itself
+    bool __resume(std::unique_ptr<Frame>& frame, PyVar& value){
+        Frame* base = __pushFrame(std::move(frame));
+        if(__exec_pushed(base) != __yield_signal) return false;
+        value = base->pop_value(this);
+        frame = std::move(callstack.back());
+        callstack.pop_back();
+        return true;
+    }
+
     PyVar new_user_type_object(PyVar mod, _Str name, PyVar base){
-        PyVar obj = pkpy::make_shared<PyObject, Py_<i64>>((i64)1, _tp_type);
-        setattr(obj, __base__, base);
+        PyVar obj = pkpy::make_shared<PyObject, PyTypeObject>((i64)1, _tp_type);
+        obj->attribs.set(__base__, base);       // a new type, no slots depend on it yet
         _Str fullName = UNION_NAME(mod) + "." +name;
         setattr(obj, __name__, PyStr(fullName));
         _userTypes[fullName] = obj;
@@ -616,8 +944,8 @@ public:
 
     PyVar new_type_object(_Str name, PyVar base=nullptr) {
         if(base == nullptr) base = _tp_object;
-        PyVar obj = pkpy::make_shared<PyObject, Py_<i64>>((i64)0, _tp_type);
-        setattr(obj, __base__, base);
+        PyVar obj = pkpy::make_shared<PyObject, PyTypeObject>((i64)0, _tp_type);
+        obj->attribs.set(__base__, base);
         _types[name] = obj;
         return obj;
     }
@@ -639,8 +967,17 @@ public:
         _lazy_modules[name] = source;
     }
 
+    void addAotModule(_Str name, _AotLoader loader){
+        _aot_modules[name] = loader;
+    }
+
+    // runtime of the code generated by `AotTranspiler`, see aot.h
+    template<int __op> PyVar __aot_step(Frame* frame, int ip);
+    PyVar __aot_call(const _Str& key, const pkpy::ArgList& args);
+    void __aot_exec(const _Code& code, PyVar _module, const _AotNatives& natives);
+
     PyVarOrNull getattr(const PyVar& obj, const _Str& name, bool throw_err=true) {
-        PyVarDict::iterator it;
+        PyVar* val;
         PyObject* cls;
 
         if(obj->is_type(_tp_super)){
@@ -651,21 +988,21 @@ public:
                 if(!(*root)->is_type(_tp_super)) break;
                 depth++;
             }
-            cls = (*root)->_type.get();
+            cls = _tp(*root).get();
             for(int i=0; i<depth; i++) cls = cls->attribs[__base__].get();
 
-            it = (*root)->attribs.find(name);
-            if(it != (*root)->attribs.end()) return it->second;        
+            val = (*root)->attribs.try_get(name);
+            if(val != nullptr) return *val;
         }else{
-            it = obj->attribs.find(name);
-            if(it != obj->attribs.end()) return it->second;
-            cls = obj->_type.get();
+            val = obj->attribs.try_get(name);
+            if(val != nullptr) return *val;
+            cls = _tp(obj).get();
         }
 
         while(cls != None.get()) {
-            it = cls->attribs.find(name);
-            if(it != cls->attribs.end()){
-                PyVar valueFromCls = it->second;
+            val = cls->attribs.try_get(name);
+            if(val != nullptr){
+                PyVar valueFromCls = *val;
                 if(valueFromCls->is_type(_tp_function) || valueFromCls->is_type(_tp_native_function)){
                     return PyBoundedMethod({obj, std::move(valueFromCls)});
                 }else{
@@ -678,14 +1015,64 @@ public:
         return nullptr;
     }
 
+    // `getattr` of an instance attribute skips the shape lookup while the instances agree
+    PyVar getattr_cached(const PyVar& obj, const _Str& name, AttrCache* c){
+        if(obj.is_heap()){
+            const PyAttribs& a = obj->attribs;
+            Shape* s = a.shape();
+            if(s != nullptr){
+                if(s->id == c->load_shape) return a.value_at(c->load_index);
+                int i = s->index_of(name);
+                if(i >= 0){
+                    c->load_shape = s->id;
+                    c->load_index = i;
+                    return a.value_at(i);
+                }
+            }
+        }
+        return getattr(obj, name);
+    }
+
+    void setattr_cached(PyVar& obj, const _Str& name, PyVar&& value, AttrCache* c){
+        if(obj.is_heap()){
+            PyAttribs& a = obj->attribs;
+            Shape* s = a.shape();
+            if(s != nullptr){
+                if(s->id != c->store_shape){
+                    int i = s->index_of(name);
+                    Shape* next = i >= 0 ? nullptr : s->add(name);
+                    if(i < 0 && next == nullptr){ a.set(name, std::move(value)); return; }
+                    c->store_shape = s->id;
+                    c->store_index = i;
+                    c->store_next = next;
+                }
+                if(c->store_next == nullptr) a.value_at(c->store_index) = std::move(value);
+                else a.append(c->store_next, std::move(value));
+                return;
+            }
+        }
+        setattr(obj, name, value);
+    }
+
     template<typename T>
     void setattr(PyObject* obj, const _Str& name, T&& value) {
         while(obj->is_type(_tp_super)) obj = ((Py_<PyVar>*)obj)->_valueT.get();
-        obj->attribs[name] = value;
+        if(obj->is_type(_tp_type) && name.size() > 2 && name[0] == '_' && name[1] == '_' && __affects_slots(name)) _slots_epoch++;
+        obj->attribs.set(name, value);
+    }
+
+    // whether rebinding `name` of a type may change the slots of some type
+    bool __affects_slots(const _Str& name){
+        if(name == __new__ || name == __base__) return true;
+        for(const _Str& s : SLOT_NAMES){
+            if(name == s) return true;
+        }
+        return false;
     }
 
     template<typename T>
     inline void setattr(PyVar& obj, const _Str& name, T&& value) {
+        if(obj.is_tagged()) attributeError(obj, name);      // there is no object to hold it
         setattr(obj.get(), name, value);
     }
 
@@ -694,7 +1081,7 @@ public:
         if(type == nullptr) type = _userTypes.try_get(typeName);
         if(type == nullptr) UNREACHABLE();
         PyVar func = PyNativeFunction(fn);
-        setattr(*type, funcName, func);
+        setattr(*type, _Str::intern(funcName), func);
     }
 
     void bindMethodMulti(std::vector<_Str> typeNames, _Str funcName, _CppFunc fn) {
@@ -710,12 +1097,12 @@ public:
     void bindFunc(PyVar module, _Str funcName, _CppFunc fn) {
         check_type(module, _tp_module);
         PyVar func = PyNativeFunction(fn);
-        setattr(module, funcName, func);
+        setattr(module, _Str::intern(funcName), func);
     }
 
     bool isinstance(PyVar obj, PyVar type){
         check_type(type, _tp_type);
-        PyObject* t = obj->_type.get();
+        PyObject* t = _tp(obj).get();
         while (t != None.get()){
             if (t == type.get()) return true;
             t = t->attribs[__base__].get();
@@ -750,6 +1137,68 @@ public:
         return nullptr;
     }
 
+    template<typename T>
+    static inline bool __compare(int op, T a, T b){
+        switch(op){
+            case 0: return a < b;
+            case 1: return a <= b;
+            case 2: return a == b;
+            case 3: return a != b;
+            case 4: return a > b;
+            case 5: return a >= b;
+            default: UNREACHABLE();
+        }
+    }
+
+    // the specialized opcodes of operands typed as numbers, see `Compiler::emitBinaryOp`.
+    // A typed local may hold a boxed value of any type, which takes the generic path
+    PyVar binary_op_int(int op, const PyVar& lhs, const PyVar& rhs){
+        if(!lhs->is_type(_tp_int) || !rhs->is_type(_tp_int)){
+            return call_slot((TypeSlot)(SLOT_ADD + op), pkpy::twoArgs(lhs, rhs));
+        }
+        i64 a = PyInt_AS_C(lhs);
+        i64 b = PyInt_AS_C(rhs);
+        switch(op){
+            case 0: return PyInt(a + b);
+            case 1: return PyInt(a - b);
+            case 2: return PyInt(a * b);
+            case 4: if(b == 0) zeroDivisionError(); return PyInt(a / b);
+            case 5: if(b == 0) zeroDivisionError(); return PyInt(a % b);
+            default: UNREACHABLE();
+        }
+    }
+
+    PyVar binary_op_float(int op, const PyVar& lhs, const PyVar& rhs){
+        bool l_float = lhs->is_type(_tp_float), r_float = rhs->is_type(_tp_float);
+        bool numbers = (l_float || lhs->is_type(_tp_int)) && (r_float || rhs->is_type(_tp_int));
+        // `int / int` is a float too, the other operators of two ints are not
+        if(!numbers || (op != 3 && !l_float && !r_float)){
+            return call_slot((TypeSlot)(SLOT_ADD + op), pkpy::twoArgs(lhs, rhs));
+        }
+        f64 a = num_to_float(lhs);
+        f64 b = num_to_float(rhs);
+        switch(op){
+            case 0: return PyFloat(a + b);
+            case 1: return PyFloat(a - b);
+            case 2: return PyFloat(a * b);
+            case 3: if(b == 0) zeroDivisionError(); return PyFloat(a / b);
+            default: UNREACHABLE();
+        }
+    }
+
+    PyVar compare_op_num(int op, const PyVar& lhs, const PyVar& rhs){
+        bool l_int = lhs->is_type(_tp_int), r_int = rhs->is_type(_tp_int);
+        if(l_int && r_int) return PyBool(__compare(op, PyInt_AS_C(lhs), PyInt_AS_C(rhs)));
+        if((l_int || lhs->is_type(_tp_float)) && (r_int || rhs->is_type(_tp_float))){
+            return PyBool(__compare(op, num_to_float(lhs), num_to_float(rhs)));
+        }
+        // for __ne__ we use the negation of __eq__
+        int slot = op == 3 ? 2 : op;
+        PyVar res = call_slot((TypeSlot)(SLOT_LT + slot), pkpy::twoArgs(lhs, rhs));
+        if(slot != op) res = PyBool(!PyBool_AS_C(res));
+        return res;
+    }
+
     int normalizedIndex(int index, int size){
         if(index < 0) index += size;
         if(index < 0 || index >= size){
@@ -794,6 +1243,15 @@ public:
             if(byte.op == OP_LOAD_NAME_REF || byte.op == OP_LOAD_NAME){
                 argStr += " (" + code->co_names[byte.arg].first.__escape(true) + ")";
             }
+            if(byte.op == OP_LOAD_TYPED_LOCAL || byte.op == OP_LOAD_TYPED_LOCAL_REF || byte.op == OP_STORE_TYPED_LOCAL){
+                argStr += " (" + code->co_typed_names[byte.arg].first.__escape(true) + ")";
+            }
+            if(byte.op == OP_INLINE_CALL){
+                argStr += " (" + code->co_names[code->co_inlined[byte.arg].name].first.__escape(true) + ")";
+            }
+            if(byte.op == OP_HOIST_LEN || byte.op == OP_LOAD_HOISTED_LEN){
+                argStr += " (" + code->co_names[code->co_hoisted[byte.arg].obj].first.__escape(true) + ")";
+            }
             ss << pad(argStr, 20);      // may overflow
             ss << code->co_blocks[byte.block].to_string();
             if(i != code->co_code.size() - 1) ss << '\n';
@@ -822,7 +1280,7 @@ public:
     }
 
     // for quick access
-    PyVar _tp_object, _tp_type, _tp_int, _tp_float, _tp_bool, _tp_str;
+    PyVar _tp_object, _tp_type, _tp_int, _tp_float, _tp_bool, _tp_none, _tp_str;
     PyVar _tp_list, _tp_tuple;
     PyVar _tp_function, _tp_native_function, _tp_native_iterator, _tp_bounded_method;
     PyVar _tp_slice, _tp_range, _tp_module, _tp_ref;
@@ -831,25 +1289,170 @@ public:
     template<typename P>
     inline PyVarRef PyRef(P&& value) {
         static_assert(std::is_base_of<BaseRef, P>::value, "P should derive from BaseRef");
+        static_assert(alignof(P) <= alignof(PyObject), "the ref should start right after the header");
         return new_object(_tp_ref, std::forward<P>(value));
     }
 
     inline const BaseRef* PyRef_AS_C(const PyVar& obj)
     {
         if(!obj->is_type(_tp_ref)) typeError("expected an l-value");
-        return (const BaseRef*)(obj->value());
+        return (const BaseRef*)((const char*)obj.get() + sizeof(PyObject));
     }
 
-    __DEF_PY_AS_C(Int, i64, _tp_int)
-    inline PyVar PyInt(i64 value) { 
-        if(value >= -5 && value <= 256) return _small_integers[value + 5];
+    // ints in [-2^61, 2^61) are tagged, others are boxed
+    inline PyVar PyInt(i64 value) {
+        if(value >= -(1LL << 61) && value < (1LL << 61)) return PyVar::from_bits(((uintptr_t)value << 2) | pkpy::TAG_INT);
         return new_object(_tp_int, value);
     }
 
-    DEF_NATIVE(Float, f64, _tp_float)
+    inline i64 PyInt_AS_C(const PyVar& obj) {
+        if((obj.bits() & pkpy::TAG_MASK) == pkpy::TAG_INT) return (i64)obj.bits() >> 2;
+        check_type(obj, _tp_int);
+        return UNION_GET(i64, obj);
+    }
+
+    // floats are tagged as (exponent, mantissa, sign) if their exponent is within [768, 1278],
+    // that is 9 bits, which covers magnitudes in [2^-255, 2^256). Zero takes the exponent 0,
+    // and subnormals, infinities, nans and other magnitudes are boxed
+    inline PyVar PyFloat(f64 value) {
+        uint64_t bits; memcpy(&bits, &value, sizeof(bits));
+        uint64_t exp = (bits >> 52) & 0x7FF;
+        if((exp >= 768 && exp <= 1278) || (bits << 1) == 0){
+            uint64_t payload = ((exp ? exp - 767 : 0) << 53) | ((bits & 0xFFFFFFFFFFFFFULL) << 1) | (bits >> 63);
+            return PyVar::from_bits((payload << 2) | pkpy::TAG_FLOAT);
+        }
+        return new_object(_tp_float, value);
+    }
+
+    inline f64 PyFloat_AS_C(const PyVar& obj) {
+        if((obj.bits() & pkpy::TAG_MASK) == pkpy::TAG_FLOAT){
+            uint64_t payload = obj.bits() >> 2;
+            uint64_t exp = payload >> 53;
+            uint64_t bits = ((payload & 1) << 63) | ((exp ? exp + 767 : 0) << 52) | ((payload >> 1) & 0xFFFFFFFFFFFFFULL);
+            f64 value; memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+        check_type(obj, _tp_float);
+        return UNION_GET(f64, obj);
+    }
+
+    // the type of `obj`, tagged values have no object to hold it
+    inline const PyVar& _tp(const PyVar& obj) {
+        if(!obj.is_tagged()) return obj->_type;
+        switch(obj.bits() & pkpy::TAG_MASK){
+            case pkpy::TAG_INT: return _tp_int;
+            case pkpy::TAG_FLOAT: return _tp_float;
+        }
+        return obj == None ? _tp_none : _tp_bool;
+    }
+
     DEF_NATIVE(Str, _Str, _tp_str)
-    DEF_NATIVE(List, PyVarList, _tp_list)
-    DEF_NATIVE(Tuple, PyVarList, _tp_tuple)
+
+    // the `i`-th character of `s`, shared in the ASCII range
+    inline PyVar PyStrChar(const _Str& s, int i){
+        if(s.is_ascii()) return _ascii_chars[(uint8_t)s[i]];
+        return PyStr(s.u8_getitem(i));
+    }
+
+    inline PyVar PyList(PyVarList items) {
+        PyVar obj = new_object(_tp_list, pkpy::make_shared<PyVarList>(std::move(items)));
+        __list_rescan(obj);
+        return obj;
+    }
+
+    // a copy of `list` in O(1), both share the items until either changes
+    inline PyVar PyList_COPY(const PyVar& list) {
+        PyVar obj = new_object(_tp_list, UNION_GET(_List, list));
+        pkpy::__set_object_bits(obj.get(), list_strategy(list));
+        return obj;
+    }
+
+    inline const PyVarList& PyList_AS_C(const PyVar& obj) {
+        check_type(obj, _tp_list);
+        return *UNION_GET(_List, obj);
+    }
+
+    // the items of a list about to change, which stop being shared first.
+    // References from `PyList_AS_C` may dangle after this, so don't hold one across it
+    inline PyVarList& PyList_AS_MUT(const PyVar& obj) {
+        check_type(obj, _tp_list);
+        _List& items = UNION_GET(_List, obj);
+        if(items.use_count() != 1) items = pkpy::make_shared<PyVarList>(*items);
+        return *items;
+    }
+
+    // a weak reference to `obj`, which `callback` gets once `obj` is released, if not None
+    PyVar PyWeakRef(const PyVar& obj, const PyVar& callback){
+        if(!obj.is_heap()) typeError("cannot create weak reference to '" + UNION_TP_NAME(obj) + "' object");
+        _WeakRef r{pkpy::__weak_slot((int*)obj.bits()), callback == None ? nullptr : callback};
+        PyVar ref = new_object(_userTypes["_weakref.ref"], std::move(r));
+        _WeakRef& value = UNION_GET(_WeakRef, ref);
+        if(value.callback != nullptr){
+            value.owner = ref.get();
+            value.slot->watchers.push_back(value.owner);
+        }
+        return ref;
+    }
+
+    inline ListStrategy __item_strategy(const PyVar& obj){
+        if(obj.is_tagged()){
+            switch(obj.bits() & pkpy::TAG_MASK){
+                case pkpy::TAG_INT: return LIST_INT;
+                case pkpy::TAG_FLOAT: return LIST_FLOAT;
+            }
+            return LIST_OBJECT;
+        }
+        return obj->is_type(_tp_str) ? LIST_STR : LIST_OBJECT;
+    }
+
+    inline ListStrategy list_strategy(const PyVar& list){
+        return (ListStrategy)pkpy::__object_bits(list.get());
+    }
+
+    // after `item` was stored into `list`, a list never goes back from `LIST_OBJECT` but by a rescan
+    inline void __list_stored(const PyVar& list, const PyVar& item){
+        ListStrategy s = list_strategy(list);
+        if(s == LIST_OBJECT) return;
+        ListStrategy k = __item_strategy(item);
+        if(s != k) pkpy::__set_object_bits(list.get(), s == LIST_EMPTY ? k : LIST_OBJECT);
+    }
+
+    inline void __list_rescan(const PyVar& list){
+        ListStrategy s = LIST_EMPTY;
+        for(const PyVar& item : *UNION_GET(_List, list)){
+            ListStrategy k = __item_strategy(item);
+            if(s == LIST_EMPTY) s = k;
+            else if(s != k){ s = LIST_OBJECT; break; }
+        }
+        pkpy::__set_object_bits(list.get(), s);
+    }
+
+    // a tuple of `n` null items, to be filled before it is seen, see `PyTupleObject`
+    inline PyVar PyTuple(int n) {
+        return pkpy::make_var_shared<PyObject, PyTupleObject>(sizeof(PyVar) * n, _tp_tuple, n);
+    }
+    inline PyVar PyTuple(const PyVarList& items) {
+        PyVar obj = PyTuple((int)items.size());
+        PyVar* data = ((PyTupleObject*)obj.get())->data();
+        for(int i=0; i<items.size(); i++) data[i] = items[i];
+        return obj;
+    }
+    inline PyVar PyTuple(PyVarList&& items) {
+        PyVar obj = PyTuple((int)items.size());
+        PyVar* data = ((PyTupleObject*)obj.get())->data();
+        for(int i=0; i<items.size(); i++) data[i] = std::move(items[i]);
+        return obj;
+    }
+    inline PyVar PyTuple(pkpy::ArgList&& items) {
+        PyVar obj = PyTuple(items.size());
+        PyVar* data = ((PyTupleObject*)obj.get())->data();
+        for(int i=0; i<items.size(); i++) data[i] = std::move(items[i]);
+        return obj;
+    }
+    inline PyTupleObject& PyTuple_AS_C(const PyVar& obj) {
+        check_type(obj, _tp_tuple);
+        return *(PyTupleObject*)obj.get();
+    }
     DEF_NATIVE(Function, _Func, _tp_function)
     DEF_NATIVE(NativeFunction, _CppFunc, _tp_native_function)
     DEF_NATIVE(Iter, _Iterator, _tp_native_iterator)
@@ -862,8 +1465,8 @@ public:
     inline const PyVar& PyBool(bool value){return value ? True : False;}
 
     void initializeBuiltinClasses(){
-        _tp_object = pkpy::make_shared<PyObject, Py_<i64>>((i64)0, nullptr);
-        _tp_type = pkpy::make_shared<PyObject, Py_<i64>>((i64)0, nullptr);
+        _tp_object = pkpy::make_shared<PyObject, PyTypeObject>((i64)0, nullptr);
+        _tp_type = pkpy::make_shared<PyObject, PyTypeObject>((i64)0, nullptr);
 
         _types["object"] = _tp_object;
         _types["type"] = _tp_type;
@@ -879,7 +1482,7 @@ public:
         _tp_module = new_type_object("module");
         _tp_ref = new_type_object("_ref");
 
-        new_type_object("NoneType");
+        _tp_none = new_type_object("NoneType");
         new_type_object("ellipsis");
         
         _tp_function = new_type_object("function");
@@ -888,10 +1491,14 @@ public:
         _tp_bounded_method = new_type_object("_bounded_method");
         _tp_super = new_type_object("super");
 
-        this->None = new_object(_types["NoneType"], (i64)0);
+        this->None = PyVar::from_bits(pkpy::TAGGED_NONE);
         this->Ellipsis = new_object(_types["ellipsis"], (i64)0);
-        this->True = new_object(_tp_bool, true);
-        this->False = new_object(_tp_bool, false);
+        this->True = PyVar::from_bits(pkpy::TAGGED_TRUE);
+        this->False = PyVar::from_bits(pkpy::TAGGED_FALSE);
+        ((PyTypeObject*)_tp_int.get())->tagged = KIND_INT;
+        ((PyTypeObject*)_tp_float.get())->tagged = KIND_FLOAT;
+        ((PyTypeObject*)_tp_none.get())->tagged = KIND_NONE;
+        ((PyTypeObject*)_tp_bool.get())->tagged = KIND_BOOL;
         this->builtins = newModule("builtins");
         this->_main = newModule("__main__");
 
@@ -904,12 +1511,36 @@ public:
             setattr(type, __name__, PyStr(name));
         }
 
+        for(int i=0; i<128; i++){
+            char c = (char)i;
+            _ascii_chars[i] = PyStr(_Str(&c, 1));
+        }
+
         this->__py2py_call_signal = new_object(_tp_object, (i64)7);
+        this->__yield_signal = new_object(_tp_object, (i64)8);
 
         std::vector<_Str> publicTypes = {"type", "object", "bool", "int", "float", "str", "list", "tuple", "range"};
         for (auto& name : publicTypes) {
             setattr(builtins, name, _types[name]);
         }
+
+        // every object holds its type, these are never counted
+        for (auto& [_, type] : _types) immortalize(type);
+        immortalize(Ellipsis);
+        for(const PyVar& c : _ascii_chars) immortalize(c);
+        immortalize(__py2py_call_signal);
+        immortalize(__yield_signal);
+    }
+
+    inline void immortalize(const PyVar& obj){ _immortals.add(obj); }
+
+    inline pkpy::Arena* arena() const { return _heap.arena; }
+    inline pkpy::Heap& heap() { return _heap; }
+
+    // caps the bytes in use by the objects of a VM with an arena, 0 for the whole arena
+    void set_memory_quota(size_t quota){
+        if(_heap.arena == nullptr) return;
+        _heap.arena->quota = quota == 0 ? _heap.arena->capacity() : quota;
     }
 
     i64 hash(const PyVar& obj){
@@ -921,6 +1552,7 @@ public:
         }
         if (obj->is_type(_tp_str)) return PyStr_AS_C(obj).hash();
         if (obj->is_type(_tp_type)) return (i64)obj.get();
+        if (slots_of(_tp(obj))[SLOT_HASH] != nullptr) return PyInt_AS_C(call_slot(SLOT_HASH, pkpy::oneArg(obj)));
         if (obj->is_type(_tp_tuple)) {
             i64 x = 1000003;
             for (const auto& item : PyTuple_AS_C(obj)) {
@@ -974,6 +1606,7 @@ public:
     }
 
     virtual ~VM() {
+        _heap.enter();
         if(!use_stdio){
             delete _stdout;
             delete _stderr;
@@ -981,6 +1614,7 @@ public:
     }
 
     _Code compile(_Str source, _Str filename, CompileMode mode);
+    void immortalize_consts(const _Code& code);
 };
 
 /***** Pointers' Impl *****/
@@ -1037,12 +1671,29 @@ void NameRef::del(VM* vm, Frame* frame) const{
     }
 }
 
+PyVar TypedLocalRef::get(VM* vm, Frame* frame) const{
+    return vm->load_typed_local(frame, index);
+}
+
+void TypedLocalRef::set(VM* vm, Frame* frame, PyVar val) const{
+    vm->store_typed_local(frame, index, val);
+}
+
+void TypedLocalRef::del(VM* vm, Frame* frame) const{
+    TypedLocal& t = frame->f_unboxed[index];
+    if(!t.bound) vm->nameError(frame->code->co_typed_names[index].first);
+    t.bound = false;
+    t.boxed = nullptr;
+}
+
 PyVar AttrRef::get(VM* vm, Frame* frame) const{
+    if(cache >= 0) return vm->getattr_cached(obj, attr.pair->first, frame->code->attr_cache(cache));
     return vm->getattr(obj, attr.pair->first);
 }
 
 void AttrRef::set(VM* vm, Frame* frame, PyVar val) const{
-    vm->setattr(obj, attr.pair->first, val);
+    if(cache >= 0) vm->setattr_cached(obj, attr.pair->first, std::move(val), frame->code->attr_cache(cache));
+    else vm->setattr(obj, attr.pair->first, val);
 }
 
 void AttrRef::del(VM* vm, Frame* frame) const{
@@ -1050,11 +1701,11 @@ void AttrRef::del(VM* vm, Frame* frame) const{
 }
 
 PyVar IndexRef::get(VM* vm, Frame* frame) const{
-    return vm->call(obj, __getitem__, pkpy::oneArg(index));
+    return vm->call_slot(SLOT_GETITEM, pkpy::twoArgs(obj, index));
 }
 
 void IndexRef::set(VM* vm, Frame* frame, PyVar val) const{
-    vm->call(obj, __setitem__, pkpy::twoArgs(index, val));
+    vm->call_slot(SLOT_SETITEM, pkpy::threeArgs(obj, index, val));
 }
 
 void IndexRef::del(VM* vm, Frame* frame) const{
@@ -1070,15 +1721,16 @@ PyVar TupleRef::get(VM* vm, Frame* frame) const{
 }
 
 void TupleRef::set(VM* vm, Frame* frame, PyVar val) const{
-    if(!val->is_type(vm->_tp_tuple) && !val->is_type(vm->_tp_list)){
-        vm->typeError("only tuple or list can be unpacked");
-    }
-    const PyVarList& args = UNION_GET(PyVarList, val);
-    if(args.size() > varRefs.size()) vm->valueError("too many values to unpack");
-    if(args.size() < varRefs.size()) vm->valueError("not enough values to unpack");
-    for (int i = 0; i < varRefs.size(); i++) {
-        vm->PyRef_AS_C(varRefs[i])->set(vm, frame, args[i]);
-    }
+    auto unpack = [&](const auto& args){
+        if(args.size() > varRefs.size()) vm->valueError("too many values to unpack");
+        if(args.size() < varRefs.size()) vm->valueError("not enough values to unpack");
+        for (int i = 0; i < varRefs.size(); i++) {
+            vm->PyRef_AS_C(varRefs[i])->set(vm, frame, args[i]);
+        }
+    };
+    if(val->is_type(vm->_tp_tuple)) unpack(vm->PyTuple_AS_C(val));
+    else if(val->is_type(vm->_tp_list)) unpack(vm->PyList_AS_C(val));
+    else vm->typeError("only tuple or list can be unpacked");
 }
 
 void TupleRef::del(VM* vm, Frame* frame) const{
@@ -1090,6 +1742,14 @@ inline void Frame::try_deref(VM* vm, PyVar& v){
     if(v->is_type(vm->_tp_ref)) v = vm->PyRef_AS_C(v)->get(vm, this);
 }
 
+inline PyVarDict Frame::f_locals_copy(VM* vm) const {
+    PyVarDict copy = f_locals;
+    for(int i=0; i<code->co_typed_names.size(); i++){
+        if(f_unboxed[i].bound) copy[code->co_typed_names[i].first] = vm->load_typed_local((Frame*)this, i);
+    }
+    return copy;
+}
+
 /***** Iterators' Impl *****/
 PyVar RangeIterator::next(){
     PyVar val = vm->PyInt(current);
@@ -1098,7 +1758,36 @@ PyVar RangeIterator::next(){
 }
 
 PyVar StringIterator::next(){
-    return vm->PyStr(str.u8_getitem(index++));
+    size_t begin = pos;
+    pos = str.u8_next(pos);
+    if(pos == begin + 1 && !(str[begin] & 0x80)) return vm->_ascii_chars[(uint8_t)str[begin]];
+    return vm->PyStr(str.substr(begin, pos - begin));
+}
+
+bool ZipIterator::hasNext(){
+    return vm->PyIter_AS_C(a)->hasNext() && vm->PyIter_AS_C(b)->hasNext();
+}
+
+PyVar ZipIterator::next(){
+    PyVar obj = vm->PyTuple(2);
+    PyVar* data = ((PyTupleObject*)obj.get())->data();
+    data[0] = vm->PyIter_AS_C(a)->next();
+    data[1] = vm->PyIter_AS_C(b)->next();
+    return obj;
+}
+
+bool Generator::hasNext(){
+    if(state == NEED_VALUE){
+        state = DONE;       // an error inside the frame drops it
+        if(vm->__resume(frame, value)) state = HAS_VALUE;
+    }
+    return state == HAS_VALUE;
+}
+
+PyVar Generator::next(){
+    if(!hasNext()) UNREACHABLE();
+    state = NEED_VALUE;
+    return std::move(value);
 }
 
 enum ThreadState {
@@ -1130,6 +1819,7 @@ class ThreadedVM : public VM {
 
 public:
     ThreadedVM(bool use_stdio) : VM(use_stdio) {
+        pkpy::HeapScope scope(heap());
         bindBuiltinFunc("__string_channel_call", [](VM* vm, const pkpy::ArgList& args){
             vm->check_args_size(args, 1);
             _Str data = vm->PyStr_AS_C(args[0]);
@@ -0,0 +1,24 @@
+# transpiles every test into a module, builds them into the executable and imports each of them
+g++ -o pocketpy src/main.cpp --std=c++17 -O1 -pthread -fno-rtti || exit 1
+
+rm -rf _aot && mkdir _aot
+for f in tests/_*.py; do
+    name=aot$(basename $f .py)
+    ./pocketpy --aot $f $name > _aot/$name.h || exit 1
+    echo "#include \"$name.h\"" >> _aot/modules.h
+    echo "import $name" > _aot/$name.py
+done
+
+g++ -o pocketpy src/main.cpp --std=c++17 -O1 -pthread -fno-rtti -I_aot -DPKPY_AOT_MODULES='"modules.h"' || exit 1
+
+failed=0
+for f in _aot/*.py; do
+    err=$(./pocketpy $f 2>&1 >/dev/null | grep -v "^Running time")
+    if [ -n "$err" ]; then
+        echo "[x] $f"; echo "$err"; failed=1
+    else
+        echo "[√] $f"
+    fi
+done
+rm -rf _aot
+[ $failed -eq 0 ] && echo "ALL TESTS PASSED"
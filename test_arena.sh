@@ -0,0 +1,20 @@
+# runs every test in an arena, then the scripts of tests/arena which must exceed a small quota
+g++ -o pocketpy src/main.cpp --std=c++17 -O1 -pthread -fno-rtti || exit 1
+
+failed=0
+for f in tests/_*.py; do
+    if ./pocketpy --arena 268435456 $f > /dev/null 2>&1; then
+        echo "[√] $f"
+    else
+        echo "[x] $f"; failed=1
+    fi
+done
+for f in tests/arena/*.py; do
+    out=$(./pocketpy --arena 2000000 $f 2>&1)
+    if [ $? -ne 0 ] && echo "$out" | grep -q "^MemoryError: memory quota"; then
+        echo "[√] $f"
+    else
+        echo "[x] $f"; echo "$out"; failed=1
+    fi
+done
+[ $failed -eq 0 ] && echo "ALL TESTS PASSED"
@@ -0,0 +1,3 @@
+g++ -o pocketpy src/main.cpp --std=c++17 -O1 -pthread -fno-rtti -DPKPY_ENABLE_JIT -DPKPY_JIT_THRESHOLD=0 -DPKPY_TYPED_LOCALS
+
+python3 scripts/run_tests.py
\ No newline at end of file
@@ -0,0 +1,20 @@
+import sys
+
+before = sys.allocstats()
+keep = [str(i) for i in range(1000)]
+after = sys.allocstats()
+
+assert after['allocs'] - before['allocs'] >= 1000
+assert after['frees'] <= after['allocs']
+assert len(after['by_class']) == 16
+assert sum(after['by_class']) + after['large'] == after['allocs']
+assert after['slab_bytes'] >= before['slab_bytes']
+
+# freed blocks are reused, the slabs stop growing
+def churn(n):
+    for i in range(n):
+        t = (str(i), [i])
+churn(1000)
+s0 = sys.allocstats()['slab_bytes']
+churn(20000)
+assert sys.allocstats()['slab_bytes'] == s0
@@ -64,4 +64,31 @@ assert D.__base__ is C
 
 d = D(1, 2, 3, 4, 5)
 assert d.add() == 15
-assert d.sub() == -13
\ No newline at end of file
+assert d.sub() == -13
+
+# constructors run through the cached plan of each type
+class R:
+    def __init__(self, a, b=3):
+        self.v = a + b
+assert R(1).v == 4
+assert R(1, 2).v == 3
+assert R(1, b=5).v == 6
+
+class U:
+    def __init__(self, *c):
+        self.n = len(c)
+assert U(1, 2, 3).n == 3
+
+class S:
+    pass
+assert type(S()) is S
+
+class T(S):
+    def __init__(self):
+        return 1
+assert type(T()) is T
+
+def t_init(self):
+    self.k = 7
+T.__init__ = t_init
+assert T().k == 7
@@ -0,0 +1,41 @@
+import gc
+import sys
+
+# a long chain is released without recursing once per link
+a = None
+for i in range(200000):
+    a = [a]
+a = None
+gc.collect()
+
+# a big release is done a budget at a time, the rest waits for the next safepoints,
+# unless a collection runs, which releases all of it
+gc.disable()
+gc.set_free_budget(100)
+assert gc.get_free_budget() == 100
+before = sys.allocstats()['deferred']
+a = [[str(i)] for i in range(10000)]
+a = None
+st = sys.allocstats()
+assert st['deferred'] > before
+assert st['pending'] > 0
+
+def step():
+    return 1
+for i in range(1000):
+    step()
+assert sys.allocstats()['pending'] == 0
+gc.enable()
+
+# a collection releases whatever is queued first
+a = [[i] for i in range(10000)]
+a = None
+gc.collect()
+assert sys.allocstats()['pending'] == 0
+
+gc.set_free_budget(0)
+a = [[str(i)] for i in range(10000)]
+b = sys.allocstats()['deferred']
+a = None
+assert sys.allocstats()['deferred'] == b
+gc.set_free_budget(4096)
@@ -0,0 +1,97 @@
+import gc
+import sys
+
+class Node:
+    def __init__(self, parent):
+        self.parent = parent
+        self.children = []
+        if parent is not None:
+            parent.children.append(self)
+
+def make_tree():
+    root = Node(None)
+    for i in range(10):
+        Node(root)
+
+gc.collect()
+gc.disable()
+for _ in range(50):
+    make_tree()
+assert gc.collect() == 50 * 22      # the nodes and their lists of children
+gc.enable()
+
+# a collection leaves reachable objects alone
+root = Node(None)
+a = Node(root)
+b = Node(a)
+gc.collect()
+assert b.parent.parent is root
+assert root.children[0].children[0] is b
+
+# instances referencing their own bound methods
+class Holder:
+    def __init__(self):
+        self.f = self.get
+    def get(self):
+        return 1
+
+h = Holder()
+assert h.f() == 1
+gc.collect()
+assert h.f() == 1
+for _ in range(20):
+    Holder()
+assert gc.collect() >= 20
+
+# lists and tuples in cycles
+def cycle():
+    l = []
+    l.append(l)
+    t = (l, [l])
+    l.append(t)
+for _ in range(10):
+    cycle()
+assert gc.collect() >= 10
+
+# suspended generators that reference themselves
+def gen():
+    yield 1
+    yield 2
+def self_gen():
+    g = gen()
+    holder = [g]
+    holder.append(holder)
+for _ in range(5):
+    self_gen()
+assert gc.collect() >= 5
+
+# a generator survives while it is iterated
+def count(n):
+    i = 0
+    while i < n:
+        gc.collect()
+        yield i
+        i += 1
+assert list(count(5)) == [0, 1, 2, 3, 4]
+
+# automatic collection keeps long loops bounded
+assert gc.isenabled()
+t = gc.get_threshold()
+assert len(t) == 3
+gc.set_threshold(100, 10, 10)
+assert gc.get_threshold() == (100, 10, 10)
+s0 = sys.allocstats()['slab_bytes']
+for _ in range(20000):
+    make_tree()
+assert sys.allocstats()['slab_bytes'] - s0 < 4 * 1024 * 1024
+gc.set_threshold(t[0], t[1], t[2])
+
+gc.disable()
+assert not gc.isenabled()
+gc.enable()
+
+stats = gc.get_stats()
+assert len(stats) == 3
+assert stats[0]['collections'] > 0
+assert sum([s['collected'] for s in stats]) > 0
+assert len(gc.get_count()) == 3
@@ -0,0 +1,137 @@
+def gen(n):
+    i = 0
+    while i < n:
+        yield i
+        i += 1
+
+assert list(gen(5)) == [0, 1, 2, 3, 4]
+assert list(gen(0)) == []
+
+# generators run lazily
+log = []
+def noisy():
+    log.append('start')
+    yield 1
+    log.append('middle')
+    yield 2
+    log.append('end')
+
+g = noisy()
+assert log == []
+for x in g:
+    log.append(x)
+assert log == ['start', 1, 'middle', 2, 'end']
+
+# an exhausted generator stays exhausted
+assert list(g) == []
+
+def early(n):
+    for i in range(n):
+        if i == 2:
+            return
+        yield i
+assert list(early(10)) == [0, 1]
+
+def bare():
+    yield
+assert list(bare()) == [None]
+
+# nested loops and generators of generators
+def pairs(n):
+    for i in range(n):
+        for j in range(i):
+            yield (i, j)
+assert list(pairs(3)) == [(1, 0), (2, 0), (2, 1)]
+
+def double(it):
+    for x in it:
+        yield x * 2
+assert list(double(double(gen(3)))) == [0, 4, 8]
+
+# breaking out of a loop over a generator
+res = []
+for x in gen(100):
+    if x == 3:
+        break
+    res.append(x)
+assert res == [0, 1, 2]
+
+class Tree:
+    def __init__(self, value, children):
+        self.value = value
+        self.children = children
+
+    def walk(self):
+        yield self.value
+        for c in self.children:
+            for v in c.walk():
+                yield v
+
+t = Tree(1, [Tree(2, [Tree(3, [])]), Tree(4, [])])
+assert list(t.walk()) == [1, 2, 3, 4]
+
+# generator expressions
+a = [1, 2, 3, 4]
+assert list(x * x for x in a) == [1, 4, 9, 16]
+assert list((x for x in a if x % 2 == 0)) == [2, 4]
+assert sum(x for x in range(101)) == 5050
+k = 3
+assert list(x + k for x in a) == [4, 5, 6, 7]
+assert tuple(c for c in 'abc') == ('a', 'b', 'c')
+assert list(([y for y in range(x)] for x in range(3))) == [[], [0], [0, 1]]
+assert (1, 2) == (1, 2)
+assert ('for', 1)[0] == 'for'
+assert list(s for s in ['for', ')', '(']) == ['for', ')', '(']
+
+def local_genexpr(n):
+    m = n + 1
+    return list(i * m for i in range(n))
+assert local_genexpr(3) == [0, 4, 8]
+
+# pipelines stay lazy, nothing is materialized
+def naturals():
+    i = 0
+    while True:
+        yield i
+        i += 1
+
+def take(n, it):
+    res = []
+    for x in it:
+        if len(res) == n:
+            break
+        res.append(x)
+    return res
+
+evens = (x for x in naturals() if x % 2 == 0)
+def inc(x):
+    return x + 1
+assert take(3, map(inc, evens)) == [1, 3, 5]
+assert sum(x for x in range(1000000) if x < 3) == 3
+
+# lazy builtins
+assert list(map(inc, [1, 2, 3])) == [2, 3, 4]
+assert list(zip([1, 2, 3], 'ab')) == [(1, 'a'), (2, 'b')]
+assert list(zip(map(inc, [1, 2, 3]), [3, 4])) == [(2, 3), (3, 4)]
+assert list(zip(gen(5), 'abc')) == [(0, 'a'), (1, 'b'), (2, 'c')]
+assert list(zip('ab', naturals())) == [('a', 0), ('b', 1)]
+assert '-'.join(map(str, [1, 2])) == '1-2'
+assert ''.join(x for x in 'abc') == 'abc'
+assert ', '.join(reversed(['a', 'b'])) == 'b, a'
+assert '-'.join([]) == ''
+assert list(reversed(gen(3))) == [2, 1, 0]
+
+# dict.keys/values/items stay snapshot lists
+d = {'a': 1, 'b': 2}
+assert sorted(d.keys()) == ['a', 'b']
+assert sorted(d.values()) == [1, 2]
+assert sorted([k + str(v) for k, v in d.items()]) == ['a1', 'b2']
+assert len(d.keys()) == 2
+assert 'a' in d.keys()
+assert len(d.items()[0]) == 2
+n = 0
+for k in d.keys():
+    d[k + k] = 0
+    n += 1
+assert n == 2
+assert len(d) == 4
@@ -0,0 +1,34 @@
+import sys
+
+# types, Ellipsis and the constants of a module are never counted
+big = sys.getrefcount(int)
+assert big > 2 ** 28
+x = [int for i in range(1000)]
+assert sys.getrefcount(int) == big
+assert sys.getrefcount(...) == sys.getrefcount(...)
+s = 'a constant'
+c = sys.getrefcount(s)
+t = [s for i in range(100)]
+assert sys.getrefcount(s) == c
+x = None
+t = None
+assert sys.getrefcount(int) == big
+
+# values built at runtime are counted as usual
+r = str(12345) + 'x'
+n = sys.getrefcount(r)
+u = [r, r]
+assert sys.getrefcount(r) == n + 2
+u = None
+assert sys.getrefcount(r) == n
+
+# immortal objects behave like any other
+assert type(int) is type
+assert str(...) == 'Ellipsis'
+assert s + '!' == 'a constant!'
+d = {s: 1, 1.25: 2}
+assert d['a constant'] == 1 and d[1.25] == 2
+
+# code from eval() keeps its constants mortal
+e = eval("'x' + 'y'")
+assert e == 'xy'
@@ -0,0 +1,50 @@
+# names and name-like literals are interned, strings built at runtime are not,
+# both must still compare and hash the same
+a = 'hello'
+b = 'hel' + 'lo'
+assert a == b
+assert hash(a) == hash(b)
+assert a != 'hello!'
+assert 'hello!'[:5] == a
+
+d = {'key': 1, 'other': 2}
+assert d['ke' + 'y'] == 1
+assert d[''.join(['o', 't', 'h', 'e', 'r'])] == 2
+d['dyn' + 'amic'] = 3
+assert d['dynamic'] == 3
+
+class Point:
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+p = Point(1, 2)
+assert getattr(p, 'x') == 1
+assert getattr(p, ''.join(['y'])) == 2
+setattr(p, 'z' * 1, 3)
+assert p.z == 3
+setattr(p, 'long_' + 'name', 4)
+assert p.long_name == 4
+
+def f(first, *rest, second=2):
+    return first + second + len(rest)
+
+assert f(1) == 3
+assert f(1, second=5) == 6
+assert f(1, 2, 3, second=4) == 7
+
+# a string shaped like a name but with other characters is a plain string
+assert 'not a name' == 'not ' + 'a name'
+assert '1abc' == '1' + 'abc'
+assert 'x' in ['a', 'b', 'x']
+assert 'a_b'.split('_') == ['a', 'b']
+
+# eval and json input is left out of the table, it still matches what is in it
+import json
+j = json.loads('{"key": "user_1", "x": 1}')
+assert j['key'] == 'user_1'
+assert d[j['key'][:0] + 'key'] == 1
+assert j['x'] == 1
+assert getattr(p, eval("'x'")) == 1
+assert eval('p.x + p.y') == 3
+assert eval("{'key': 5}")['key'] == 5
@@ -0,0 +1,61 @@
+import gc
+
+# copies share the items of a list until either of them changes
+a = [1, 2, 3]
+b = a.copy()
+c = a[:]
+d = list(a)
+e = a + []
+a.append(4)
+assert a == [1, 2, 3, 4]
+assert b == [1, 2, 3] and c == [1, 2, 3] and d == [1, 2, 3] and e == [1, 2, 3]
+b[0] = 9
+assert b == [9, 2, 3] and c == [1, 2, 3]
+del c[0]
+assert c == [2, 3] and d == [1, 2, 3]
+d.insert(0, 0)
+assert d == [0, 1, 2, 3] and e == [1, 2, 3]
+e.clear()
+assert e == [] and a == [1, 2, 3, 4]
+
+f = [3, 1, 2]
+g = f[:]
+g.sort()
+assert f == [3, 1, 2] and g == [1, 2, 3]
+assert [] + f == f
+assert f[1:] == [1, 2] and f[:-1] == [3, 1] and f[5:] == [] and f[2:1] == []
+
+# the copy keeps the kind of its items
+h = ['x', 'y'].copy()
+assert 'y' in h
+h.append(1)
+assert sum([1.5, 2.5].copy()) == 4.0
+
+# an iterator sees the changes of its list, not those of a copy
+a = [1, 2, 3]
+b = a.copy()
+seen = []
+for x in a:
+    seen.append(x)
+    if x == 1:
+        a.append(4)
+        b.append(5)
+        b = None
+assert seen == [1, 2, 3, 4]
+
+assert list(range(3)) == [0, 1, 2]
+assert list('ab') == ['a', 'b']
+assert list((1, 2)) == [1, 2]
+
+# a cycle through items shared by copies is collected once they stop being shared
+gc.collect()
+class Node:
+    pass
+n = Node()
+n.items = [n]
+m = Node()
+m.items = n.items.copy()
+m.items.append(m)
+n = None
+m = None
+assert gc.collect() == 4
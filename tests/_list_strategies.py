@@ -0,0 +1,70 @@
+# lists of ints, floats or strs take typed fast paths, any other item falls back to the generic ones
+a = [3, 1, 2]
+assert sum(a) == 6
+assert sum([]) == 0
+assert sum([1.5, 2.5]) == 4.0
+assert sum([1, 2.5]) == 3.5
+assert sum([2 ** 61, 2 ** 61]) == 2 ** 62
+assert sum((1, 2, 3)) == 6
+assert sum(range(5)) == 10
+assert sum([[1], [2]][0]) == 1
+
+assert 2 in a
+assert 4 not in a
+assert 2.0 in a
+assert 'a' not in a
+assert 1.5 in [0.5, 1.5]
+assert 1 in [0.5, 1.0]
+assert 'b' in ['a', 'b']
+assert 'c' not in ['a', 'b']
+assert None not in []
+assert [1] in [[0], [1]]
+
+# a mixed list keeps working once it stops being of one type
+b = [1, 2]
+b.append('x')
+assert 'x' in b
+assert sum([1, 2]) == 3
+b.clear()
+b.append(1.5)
+b.insert(0, 0.5)
+assert sum(b) == 2.0
+b[0] = 'y'
+assert 'y' in b
+del b[0]
+del b[0]
+b.append(7)
+assert sum(b) == 7
+
+# sort is stable, by a key and in either order
+a = [5, 3, 9, 1, 3]
+a.sort()
+assert a == [1, 3, 3, 5, 9]
+a.sort(reverse=True)
+assert a == [9, 5, 3, 3, 1]
+assert sorted([2.5, 0.5, 1.5]) == [0.5, 1.5, 2.5]
+assert sorted(['b', 'c', 'a']) == ['a', 'b', 'c']
+assert sorted([3, 1.5, 2]) == [1.5, 2, 3]
+assert sorted((3, 2, 1)) == [1, 2, 3]
+assert sorted([]) == []
+
+words = ['bb', 'a', 'ccc', 'dd', 'e']
+assert sorted(words, key=len) == ['a', 'e', 'bb', 'dd', 'ccc']
+assert sorted(words, key=len, reverse=True) == ['ccc', 'bb', 'dd', 'a', 'e']
+neg_len = lambda w: -len(w)
+assert sorted(words, key=neg_len) == ['ccc', 'bb', 'dd', 'a', 'e']
+
+class P:
+    def __init__(self, x):
+        self.x = x
+    def __lt__(self, other):
+        return self.x < other.x
+ps = sorted([P(3), P(1), P(2)])
+assert [p.x for p in ps] == [1, 2, 3]
+get_x = lambda p: p.x
+ps.sort(key=get_x, reverse=True)
+assert [p.x for p in ps] == [3, 2, 1]
+
+big = [(i * 7919) % 1000 for i in range(1000)]
+big.sort()
+assert big == list(range(1000))
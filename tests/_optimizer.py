@@ -0,0 +1,104 @@
+# len() hoisted out of a pure loop
+def total(a):
+    i: int = 0
+    s: int = 0
+    while i < len(a):
+        s += (i*2)*(i*2) + a[i]
+        i += 1
+    return s
+
+assert total([1, 2, 3]) == 26
+assert total((4, 5)) == 13
+assert total('') == 0
+
+# the guard falls back for user types
+class Seq:
+    def __init__(self):
+        self.calls = 0
+    def __len__(self):
+        self.calls += 1
+        return 3
+    def __getitem__(self, i):
+        return i
+
+seq = Seq()
+assert total(seq) == 23
+assert seq.calls == 4
+
+# the body may change the length
+def grow(a):
+    i: int = 0
+    while i < len(a):
+        if i < 3:
+            a.append(i)
+        i += 1
+    return a
+
+assert grow([1, 2]) == [1, 2, 0, 1, 2]
+
+# copies and dead stores
+def copies(n):
+    a = 1
+    a = 2
+    b = a
+    c = b
+    for j in range(n):
+        c = c + j
+    return c
+
+assert copies(4) == 8
+
+def f():
+    x = 1
+    x += 2
+    y, z = x, 4
+    return [y, z, locals()['x']]
+
+assert f() == [3, 4, 3]
+
+def g(x: float, y: float):
+    d: float = (x-y)*(x-y) + (x-y)*(x-y)
+    return d
+
+assert g(3.0, 1.0) == 8.0
+
+# small functions are inlined, guarded by their global binding
+def sq(x):
+    y = x * x
+    return y
+
+def nothing(x):
+    x = x + 1
+
+def h(n):
+    s = 0
+    for i in range(n):
+        s = s + sq(i) + abs(i - 2) + max(i, 1)
+    assert nothing(s) is None
+    return s
+
+assert h(5) == 47
+assert h(5) == 47
+
+def sq(x):
+    return 0
+
+assert h(5) == 17
+
+abs = lambda x: 100
+assert h(5) == 511
+del abs
+assert h(5) == 17
+
+def cube(x):
+    return x * x * x
+
+def sum_cubes(n):
+    s = 0
+    for i in range(n):
+        s = s + cube(i)
+    return s
+
+assert sum_cubes(4) == 36
+cube = lambda x: 1
+assert sum_cubes(4) == 4
@@ -0,0 +1,88 @@
+class Point:
+    def __init__(self, x, y):
+        self.x = x
+        self.y = y
+
+    def norm2(self):
+        return self.x * self.x + self.y * self.y
+
+points = [Point(i, i + 1) for i in range(100)]
+assert sum([p.norm2() for p in points]) == sum([i * i + (i + 1) * (i + 1) for i in range(100)])
+
+# the same attributes in another order give another shape
+a = Point(1, 2)
+b = Point(3, 4)
+b.z = 5
+a.z = 6
+assert a.x == 1 and a.y == 2 and a.z == 6
+assert b.x == 3 and b.y == 4 and b.z == 5
+
+def getx(p):
+    return p.x
+
+# one load site sees instances of different shapes and classes
+class Other:
+    def __init__(self):
+        self.w = 0
+        self.x = 'other'
+
+objs = [a, Other(), b, Point(7, 8), Other()]
+assert [getx(o) for o in objs] == [1, 'other', 3, 7, 'other']
+
+def setx(p, v):
+    p.x = v
+
+for o in objs:
+    setx(o, 0)
+assert [getx(o) for o in objs] == [0, 0, 0, 0, 0]
+
+# instance attributes shadow the class, methods still come from the class
+class Counter:
+    def __init__(self):
+        self.n = 0
+    def step(self):
+        return 1
+    def inc(self):
+        self.n += self.step()
+
+c = Counter()
+c.inc()
+c.inc()
+assert c.n == 2
+d = Counter()
+d.step = 42
+assert d.step == 42
+c.inc()
+assert c.n == 3
+
+# many attributes, and instances that never agree, fall back to a dict
+class Bag:
+    pass
+
+big = Bag()
+for i in range(100):
+    setattr(big, 'a' + str(i), i)
+assert getattr(big, 'a0') == 0 and getattr(big, 'a99') == 99
+big.a50 = 'x'
+assert big.a50 == 'x'
+
+bags = []
+for i in range(300):
+    o = Bag()
+    setattr(o, 'k' + str(i), i)
+    o.common = i
+    bags.append(o)
+assert sum([o.common for o in bags]) == sum(range(300))
+assert getattr(bags[299], 'k299') == 299
+
+assert 'x' in dir(Point(0, 0))
+assert 'norm2' in dir(Point(0, 0))
+
+# subclasses have their own shapes
+class Point3(Point):
+    def __init__(self, x, y, z):
+        super().__init__(x, y)
+        self.z = z
+p3 = Point3(1, 2, 3)
+assert p3.x + p3.y + p3.z == 6
+assert p3.norm2() == 5
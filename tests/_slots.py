@@ -0,0 +1,33 @@
+# dunders are dispatched through per-type slot tables, which follow rebinding and inheritance
+class V:
+    def __init__(self, x):
+        self.x = x
+    def __add__(self, other):
+        return V(self.x + other.x)
+    def __eq__(self, other):
+        return self.x == other.x
+    def __len__(self):
+        return self.x
+class W(V):
+    pass
+assert (W(1) + W(2)).x == 3
+assert W(1) == V(1)
+assert W(1) != V(2)
+assert not W(0)
+assert len(W(3)) == 3
+def sub_add(self, other):
+    return V(self.x - other.x)
+V.__add__ = sub_add
+assert (W(1) + W(2)).x == -1
+V.__bool__ = lambda self: True
+assert W(0)
+V.__hash__ = lambda self: self.x * 7
+assert hash(W(3)) == 21
+V.__contains__ = lambda self, v: v == self.x
+assert 3 in W(3)
+V.__getitem__ = lambda self, i: self.x + i
+assert W(3)[1] == 4
+V.__repr__ = lambda self: 'V(' + str(self.x) + ')'
+assert repr(W(5)) == 'V(5)'
+V.__iter__ = lambda self: range(self.x).__iter__()
+assert [i for i in W(3)] == [0, 1, 2]
@@ -0,0 +1,40 @@
+# len and indexing need no index for ASCII text, and have no size limit otherwise
+s = 'abc' * 30000
+assert len(s) == 90000
+assert s[0] == 'a' and s[89999] == 'c' and s[-2] == 'b'
+assert s[45000:45003] == 'abc'
+assert len(s[1:80001]) == 80000
+
+t = 'héllo wörld ' * 10000
+assert len(t) == 120000
+assert t[1] == 'é'
+assert t[12 * 5000 + 7] == 'ö'
+assert t[-1] == ' '
+v = t[5:100005]
+assert len(v) == 100000
+assert v[2] == 'ö'
+assert v[99999] == 'r'
+assert v[-4:] == ' wör'
+
+u = 'a€😀' * 50
+assert len(u) == 150
+assert u[148] == '€'
+assert u[61:64] == '€😀a'
+
+# iteration yields 1-char strs, the ASCII ones are shared
+n = 0
+for c in t:
+    n += 1
+assert n == 120000
+assert list('aé€x') == ['a', 'é', '€', 'x']
+chars = [c for c in 'hello']
+assert chars[2] is chars[3]
+assert 'abc'[1] is 'xbz'[1]
+
+# appending keeps track of the flag
+w = 'abc'
+w += 'dé'
+assert len(w) == 5 and w[4] == 'é'
+w = 'x' * 40
+w += '€'
+assert len(w) == 41 and w[40] == '€'
@@ -0,0 +1,64 @@
+# a str only its name holds is appended in place, the other holders never see it change
+s = ''
+for i in range(1000):
+    s += str(i % 10)
+assert len(s) == 1000
+assert s[:12] == '012345678901'
+
+a = 'x' * 20
+b = a
+a += 'y'
+assert b == 'x' * 20
+assert a == 'x' * 20 + 'y'
+l = [a]
+a += 'z'
+assert l[0] == 'x' * 20 + 'y'
+assert a == 'x' * 20 + 'yz'
+c = 'lit'
+c += 'eral'
+assert c == 'literal'
+c = 'lit'
+c = c + 'eral'
+assert c == 'literal'
+assert 'lit' + 'eral' == 'literal'
+
+g = 'glob' * 10
+def local_copy():
+    h = g
+    h += '!'
+    return h
+assert local_copy() == 'glob' * 10 + '!'
+assert g == 'glob' * 10
+def rebind_global():
+    global g
+    g += '?'
+rebind_global()
+assert g == 'glob' * 10 + '?'
+
+d = {'k': 'v' * 30}
+key = 'k' * 40
+d[key] = 1
+key += 'k'
+assert d['k' * 40] == 1
+d['k'] += 'w'
+assert d['k'] == 'v' * 30 + 'w'
+
+assert 'ab' * 3 == 'ababab'
+assert 'ab' * 0 == ''
+assert 'ab' * -1 == ''
+assert '-'.join(('a', 1, None)) == 'a-1-None'
+n = 5
+assert f'{n} and {s[:3]}' == '5 and 012'
+
+import io
+f = io.StringIO()
+assert f.write('héllo') == 5
+f.write(' world')
+assert f.getvalue() == 'héllo world'
+f = io.StringIO('abc')
+f.write('d')
+v = f.getvalue()
+f.write('e')
+assert v == 'abcd'
+assert f.getvalue() == 'abcde'
+f.close()
@@ -0,0 +1,48 @@
+# slices of long strings share the parent's bytes, they must behave like copies
+text = 'the quick brown fox jumps over the lazy dog, ' * 40
+line = text[4:80]
+assert len(line) == 76
+assert line == text[4:80]
+assert line.startswith('quick brown')
+assert line[6:11] == 'brown'
+assert line + '!' == text[4:80] + '!'
+assert text[:45] * 2 == text[:90]
+
+d = {line: 1}
+assert d[text[4:80]] == 1
+assert d[text[49:125]] == 1
+
+words = text.split(' ')
+assert words[1] == 'quick'
+assert len(words) == 361
+chunks = text.split(', ')
+assert chunks[0] == 'the quick brown fox jumps over the lazy dog'
+assert chunks[39] == chunks[0]
+
+# a view used where a terminated string is needed
+num = ('0' * 38 + '12' + '3' * 40)[0:40]
+assert int(num) == 12
+assert float(('0.25' + '0' * 40)[0:40]) == 0.25
+
+s = 'abcabc'
+assert s.replace('b', 'xx') == 'axxcaxxc'
+assert s.replace('z', 'y') == s
+assert s.replace('abc', '') == ''
+
+r = text[45:]
+assert r == text[:len(text) - 45]
+assert r is not text
+
+# views into text with multi-byte characters count characters, not bytes
+u = 'héllo wörld, ' * 10 + 'ünïcode' * 10
+v = u[3:100]
+assert len(v) == 97
+assert v[0] == 'l'
+assert v[2] == ' '
+assert v[4:9] == 'örld,'
+assert v[-1] == u[99]
+assert v[90:] == u[93:100]
+n = 0
+for c in v:
+    n += 1
+assert n == 97
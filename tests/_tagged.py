@@ -0,0 +1,42 @@
+# ints and floats out of the tagged range are boxed, both behave the same
+a = 2 ** 61
+assert a - 1 == 2305843009213693951
+assert a + 0 == a
+assert -a - 1 == -2305843009213693953
+assert type(a) is int and type(a - 1) is int
+assert 1 - 2 ** 62 == -4611686018427387903
+assert (a + 1) // 2 == 2 ** 60
+
+big = 10.0 ** 300
+tiny = 0.5 ** 1070
+assert type(big) is float and type(tiny) is float
+assert big == 10.0 ** 300
+assert big / 10.0 ** 299 > 9.99
+assert tiny * 2.0 ** 1000 * 2.0 ** 70 == 1.0
+assert big * big > big
+assert -(big * big) < -big
+assert 0.5 ** 250 * 2.0 ** 250 == 1.0
+
+assert str(-0.0) == '-0.0'
+assert str(0.0) == '0.0'
+assert 3.14 * 2 == 6.28
+assert 1.0 / 4 == 0.25
+assert int(2.5 * 4) == 10
+
+# types of tagged values
+assert type(None).__name__ == 'NoneType'
+assert type(True) is bool
+assert type(1) is int
+assert type(1.5) is float
+assert isinstance(1, int)
+assert not isinstance(True, int)
+assert isinstance(1.0, float)
+assert 1 is 1
+assert None is None
+
+d = {1: 'a', 1.5: 'b', True: 'c', big: 'd'}
+assert d[1] == 'a'
+assert d[1.5] == 'b'
+assert d[True] == 'c'
+assert d[10.0 ** 300] == 'd'
+assert hash(1.5) == hash(3.0 / 2)
@@ -0,0 +1,51 @@
+# tuples keep their items inline, they behave the same as before
+t = (1, 'a', 2.5, None)
+assert len(t) == 4
+assert t[1] == 'a' and t[-1] is None
+assert t == (1, 'a', 2.5, None)
+assert t != (1, 'a', 2.5)
+assert 2.5 in t
+assert t.count(1) == 1
+assert repr(t) == "(1, 'a', 2.5, None)"
+assert list(t) == [1, 'a', 2.5, None]
+assert tuple([3, 4]) == (3, 4)
+assert len(tuple([])) == 0
+assert hash((1, 2)) == hash((1, 2))
+assert ', '.join(('x', 'y')) == 'x, y'
+
+a, b = (1, 2)
+assert a == 1 and b == 2
+x, y = [3, 4]
+assert x == 3 and y == 4
+
+d = {(1, 2): 'p'}
+assert d[(1, 2)] == 'p'
+
+def f(*args):
+    return args
+assert f(1, 2, 3) == (1, 2, 3)
+assert type(f()) is tuple
+
+pairs = []
+for k, v in zip([1, 2, 3], ['a', 'b', 'c']):
+    pairs.append((k, v))
+assert pairs == [(1, 'a'), (2, 'b'), (3, 'c')]
+
+s = 0
+for i in t:
+    if type(i) is int:
+        s += i
+assert s == 1
+
+# a big tuple and a cycle through a tuple are released like any other
+big = tuple([str(i) for i in range(5000)])
+assert len(big) == 5000 and big[4999] == '4999'
+big = None
+
+import gc
+class Node:
+    pass
+n = Node()
+n.t = (n, 1)
+n = None
+assert gc.collect() >= 2
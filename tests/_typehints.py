@@ -41,4 +41,70 @@ def i(x, y: int, *args):
     return x + y + len(args)
 
 def j(x, y: int, *args: str) -> int:
-    return x + y + len(args)
\ No newline at end of file
+    return x + y + len(args)
+
+# test typed locals
+
+def f(n: int) -> int:
+    s: int = 0
+    i: int = 0
+    while i < n:
+        s += i * i
+        i += 1
+    return s
+
+assert f(10) == 285
+assert f(0) == 0
+
+def f(x: float, y: float) -> float:
+    d: float = x - y
+    return d * d
+
+assert f(4, 1.5) == 6.25
+assert type(f(3, 1)) is int
+
+def f(a: int, b: int):
+    return a // b, a % b, a / b, -a
+
+assert f(7, 2) == (3, 1, 3.5, -7)
+
+def f(n: int):
+    k: int = 0
+    for i in range(n):
+        k = k + i
+    a = [k, k+1]
+    b: float = k
+    b /= 2
+    return a, b, f'{k}-{n}'
+
+assert f(5) == ([10, 11], 5.0, '10-5')
+
+def f(x: int, y: int = 3):
+    t: int = x
+    x, y = y, t
+    return x * 10 + y
+
+assert f(1) == 31
+assert f(1, 2) == 21
+
+# a value of another type is kept as it is
+def k(x: int):
+    return x
+
+def h(x: float):
+    y: int = x
+    return y
+
+assert k(2.5) == 2.5
+assert type(h(3)) is int
+assert h(1.5) == 1.5
+assert k('a') + 'b' == 'ab'
+
+def f(n: int):
+    t: float = n
+    t = t + 1
+    t = t / 2
+    return t
+
+assert f(3) == 2.0
+assert f(3.0) == 2.0
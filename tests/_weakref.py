@@ -0,0 +1,81 @@
+import weakref
+import gc
+
+class Node:
+    pass
+
+def tick():
+    return 1
+
+# a reference follows its object until it is released, and then calls back
+n = Node()
+r = weakref.ref(n)
+assert r() is n
+assert weakref.getweakrefcount(n) == 1
+log = []
+def on_release(ref):
+    log.append(ref)
+r2 = weakref.ref(n, on_release)
+assert r == r2 and hash(r) == hash(r2)
+assert weakref.getweakrefcount(n) == 2
+n = None
+tick()
+assert r() is None and r2() is None
+assert len(log) == 1 and log[0] is r2
+assert r == r2
+
+# a reference released first never calls back
+n = Node()
+r3 = weakref.ref(n, on_release)
+r3 = None
+n = None
+tick()
+assert len(log) == 1
+
+# so does an object of a collected cycle
+n = Node()
+n.self = n
+r = weakref.ref(n, on_release)
+n = None
+gc.collect()
+tick()
+assert r() is None
+assert len(log) == 2
+
+# any object with a __call__ is callable
+class Adder:
+    def __init__(self, n):
+        self.n = n
+    def __call__(self, x):
+        return self.n + x
+assert Adder(2)(3) == 5
+
+# caches which let go of their entries
+cache = weakref.WeakValueDictionary()
+a = Node()
+cache['a'] = a
+cache['b'] = Node()
+tick()
+assert len(cache) == 1
+assert 'a' in cache and 'b' not in cache
+assert cache['a'] is a
+assert cache.get('b') is None
+assert cache.keys() == ['a']
+cache['a'] = a
+assert len(cache) == 1
+
+attrs = weakref.WeakKeyDictionary()
+attrs[a] = 1
+b = Node()
+attrs[b] = 2
+assert attrs[a] == 1 and attrs[b] == 2
+assert a in attrs and len(attrs) == 2
+attrs[a] = 3
+assert attrs[a] == 3 and len(attrs) == 2
+a = None
+tick()
+assert len(cache) == 0
+assert len(attrs) == 1
+assert attrs.values() == [2]
+del attrs[b]
+assert len(attrs) == 0
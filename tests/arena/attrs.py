@@ -0,0 +1,6 @@
+# and the attributes of an instance, kept in a dict
+class A:
+    pass
+a = A()
+for i in range(200000):
+    setattr(a, 'a' + str(i), None)
@@ -0,0 +1,4 @@
+# so do the buckets of a dict, however its values are made
+d = {}
+for i in range(200000):
+    d[i] = None
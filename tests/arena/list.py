@@ -0,0 +1,2 @@
+# the items of a list count against the quota
+a = list(range(3000000))
@@ -0,0 +1,2 @@
+# the bytes of a str count against the quota
+s = 'x' * 50000000